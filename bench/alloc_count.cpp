@@ -0,0 +1,71 @@
+#include "bench.h"
+
+#include <atomic>
+#include <malloc.h>
+#include <stdlib.h>
+
+/* Counts heap allocations and live bytes in the C allocator by interposing on glibc. */
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *p, size_t size);
+extern "C" void __libc_free(void *p);
+
+static std::atomic<uint64_t> allocations(0);
+static std::atomic<int64_t> allocated_bytes(0);
+
+static void *Allocated(void *p)
+{
+  if (p)
+  {
+    allocated_bytes.fetch_add(malloc_usable_size(p), std::memory_order_relaxed);
+  }
+  return p;
+}
+
+static void Freed(void *p)
+{
+  if (p)
+  {
+    allocated_bytes.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+  }
+}
+
+extern "C" void *malloc(size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return Allocated(__libc_malloc(size));
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return Allocated(__libc_calloc(n, size));
+}
+
+extern "C" void *realloc(void *p, size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  size_t old_size = p ? malloc_usable_size(p) : 0;
+  void *q = __libc_realloc(p, size);
+  if (q || !size)
+  {
+    allocated_bytes.fetch_sub(old_size, std::memory_order_relaxed);
+  }
+  return Allocated(q);
+}
+
+extern "C" void free(void *p)
+{
+  Freed(p);
+  __libc_free(p);
+}
+
+uint64_t Allocations()
+{
+  return allocations.load(std::memory_order_relaxed);
+}
+
+int64_t AllocatedBytes()
+{
+  return allocated_bytes.load(std::memory_order_relaxed);
+}
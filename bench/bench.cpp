@@ -0,0 +1,242 @@
+#include "bench.h"
+
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t Now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+Benchmark::Benchmark(const char *name, Function function)
+  : ns_per_op(0), name_(name), function_(function), iterations_(0), running_(false),
+    start_ns_(0), elapsed_ns_(0)
+{
+  All().push_back(this);
+}
+
+std::vector<Benchmark *> &Benchmark::All()
+{
+  static std::vector<Benchmark *> all;
+  return all;
+}
+
+void Benchmark::StartTimer()
+{
+  if (!running_)
+  {
+    start_ns_ = Now();
+    running_ = true;
+  }
+}
+
+void Benchmark::StopTimer()
+{
+  if (running_)
+  {
+    elapsed_ns_ += Now() - start_ns_;
+    running_ = false;
+  }
+}
+
+void Benchmark::Report(const char *name, double value, bool per_op)
+{
+  for (Counter &counter : counters)
+  {
+    if (counter.name == name)
+    {
+      counter.value = value;
+      counter.per_op = per_op;
+      return;
+    }
+  }
+  Counter counter = { name, value, per_op };
+  counters.push_back(counter);
+}
+
+bool Benchmark::Run(double min_secs)
+{
+  const uint64_t min_ns = (uint64_t) (min_secs * 1e9);
+  iterations_ = 1;
+  for (;;)
+  {
+    counters.clear();
+    elapsed_ns_ = 0;
+    running_ = false;
+    StartTimer();
+    function_(*this);
+    StopTimer();
+    if ((elapsed_ns_ >= min_ns) || (iterations_ >= 1000000000))
+    {
+      break;
+    }
+    /* Aim past the minimum so the final run is not cut short. */
+    size_t next = elapsed_ns_ ? (size_t) (iterations_ * 1.5 * min_ns / elapsed_ns_) : iterations_ * 100;
+    if (next > iterations_ * 100)
+    {
+      next = iterations_ * 100;
+    }
+    iterations_ = (next > iterations_) ? next : iterations_ + 1;
+  }
+  ns_per_op = (double) elapsed_ns_ / iterations_;
+  for (Counter &counter : counters)
+  {
+    if (counter.per_op)
+    {
+      counter.value /= iterations_;
+      counter.per_op = false;
+    }
+  }
+  return true;
+}
+
+/* Reads ns_per_op by name from a file written by WriteJson(). */
+static bool ReadBaseline(const char *path, std::map<std::string, double> &baseline)
+{
+  FILE *fp = fopen(path, "r");
+  if (!fp)
+  {
+    perror(path);
+    return false;
+  }
+  std::string text;
+  char chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+  {
+    text.append(chunk, n);
+  }
+  fclose(fp);
+  static const std::string name_key = "\"name\": \"";
+  static const std::string ns_key = "\"ns_per_op\": ";
+  for (size_t pos = text.find(name_key); pos != std::string::npos; pos = text.find(name_key, pos))
+  {
+    pos += name_key.size();
+    size_t end = text.find('"', pos);
+    size_t ns = text.find(ns_key, end);
+    if ((end == std::string::npos) || (ns == std::string::npos))
+    {
+      break;
+    }
+    baseline[text.substr(pos, end - pos)] = strtod(text.c_str() + ns + ns_key.size(), NULL);
+  }
+  return true;
+}
+
+static bool WriteJson(const char *path, const std::vector<Benchmark *> &benchmarks)
+{
+  FILE *fp = fopen(path, "w");
+  if (!fp)
+  {
+    perror(path);
+    return false;
+  }
+  fprintf(fp, "{\n  \"benchmarks\": [");
+  for (size_t i = 0; i < benchmarks.size(); ++i)
+  {
+    Benchmark *benchmark = benchmarks[i];
+    fprintf(fp, "%s\n    { \"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.3f", i ? "," : "",
+            benchmark->Name(), benchmark->Iterations(), benchmark->ns_per_op);
+    for (const Benchmark::Counter &counter : benchmark->counters)
+    {
+      fprintf(fp, ", \"%s\": %.3f", counter.name.c_str(), counter.value);
+    }
+    fprintf(fp, " }");
+  }
+  fprintf(fp, "\n  ]\n}\n");
+  return (fclose(fp) == 0);
+}
+
+static void Usage(const char *argv0)
+{
+  printf("Usage: %s [--min-time=SECS] [--json=FILE] [--baseline=FILE [--threshold=PCT]] [FILTER]\n", argv0);
+  printf("  --min-time=SECS  Minimum measured time of each benchmark (default 0.5)\n");
+  printf("  --json=FILE      Also write the results to FILE as JSON\n");
+  printf("  --baseline=FILE  Compare with results written earlier by --json\n");
+  printf("  --threshold=PCT  Fail when a benchmark is more than PCT%% slower than the baseline (default 10)\n");
+  printf("  FILTER           Only run benchmarks whose name contains FILTER\n");
+}
+
+int main(int argc, char **argv)
+{
+  double min_secs = 0.5;
+  const char *filter = NULL;
+  const char *json_path = NULL;
+  const char *baseline_path = NULL;
+  double threshold = 10;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strncmp(argv[i], "--min-time=", 11))
+    {
+      min_secs = atof(argv[i] + 11);
+    }
+    else if (!strncmp(argv[i], "--json=", 7))
+    {
+      json_path = argv[i] + 7;
+    }
+    else if (!strncmp(argv[i], "--baseline=", 11))
+    {
+      baseline_path = argv[i] + 11;
+    }
+    else if (!strncmp(argv[i], "--threshold=", 12))
+    {
+      threshold = atof(argv[i] + 12);
+    }
+    else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+    {
+      Usage(argv[0]);
+      return EXIT_SUCCESS;
+    }
+    else
+    {
+      filter = argv[i];
+    }
+  }
+
+  std::map<std::string, double> baseline;
+  if (baseline_path && !ReadBaseline(baseline_path, baseline))
+  {
+    return EXIT_FAILURE;
+  }
+
+  int regressions = 0;
+  std::vector<Benchmark *> ran;
+  for (Benchmark *benchmark : Benchmark::All())
+  {
+    if (filter && !strstr(benchmark->Name(), filter))
+    {
+      continue;
+    }
+    benchmark->Run(min_secs);
+    ran.push_back(benchmark);
+    printf("%-40s %12zu %12.1f ns/op", benchmark->Name(), benchmark->Iterations(), benchmark->ns_per_op);
+    for (const Benchmark::Counter &counter : benchmark->counters)
+    {
+      printf(" %12.1f %s", counter.value, counter.name.c_str());
+    }
+    std::map<std::string, double>::iterator it = baseline.find(benchmark->Name());
+    if ((it != baseline.end()) && (it->second > 0))
+    {
+      double change = 100 * (benchmark->ns_per_op - it->second) / it->second;
+      bool regressed = (change > threshold);
+      printf(" %+7.1f%%%s", change, regressed ? " REGRESSION" : "");
+      regressions += regressed;
+    }
+    printf("\n");
+  }
+  if (json_path && !WriteJson(json_path, ran))
+  {
+    return EXIT_FAILURE;
+  }
+  if (regressions)
+  {
+    printf("%d benchmark(s) more than %.1f%% slower than %s\n", regressions, threshold, baseline_path);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,68 @@
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+ * A minimal microbenchmark harness.  Each benchmark body runs its operation
+ * Iterations() times; the runner grows the iteration count until a run is long
+ * enough to time and reports the cost per operation.
+ */
+class Benchmark
+{
+  public:
+    typedef void (*Function)(Benchmark &b);
+
+    Benchmark(const char *name, Function function);
+
+    const char *Name() const { return name_; }
+    size_t Iterations() const { return iterations_; }
+
+    /* Excludes setup from the measured time. */
+    void StartTimer();
+    void StopTimer();
+    /* Attaches a value to the report, divided by the iteration count when per_op. */
+    void Report(const char *name, double value, bool per_op = true);
+
+    static std::vector<Benchmark *> &All();
+    bool Run(double min_secs);
+
+    struct Counter
+    {
+      std::string name;
+      double value;
+      bool per_op;
+    };
+    double ns_per_op;
+    std::vector<Counter> counters;
+
+  private:
+    const char *name_;
+    Function function_;
+    size_t iterations_;
+    bool running_;
+    uint64_t start_ns_;
+    uint64_t elapsed_ns_;
+};
+
+#define BENCHMARK(name)                                                 \
+  static void name##_Bench(Benchmark &b);                               \
+  static Benchmark name##_Registration(#name, name##_Bench);            \
+  static void name##_Bench(Benchmark &b)
+
+/* Returns the number of heap allocations made so far by the process. */
+uint64_t Allocations();
+/* Returns the number of heap bytes currently allocated by the process. */
+int64_t AllocatedBytes();
+
+/* Keeps the compiler from discarding a computed value. */
+template <typename T>
+inline void DoNotOptimize(const T &value)
+{
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif
@@ -0,0 +1,189 @@
+#include "bench.h"
+#include "bridge.h"
+#include "ocpayload.h"
+#include "ocstack.h"
+#include "oic_malloc.h"
+#include "oic_string.h"
+#include "payload_arena.h"
+#include "resource.h"
+#include "secure_mode_resource.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+
+/*
+ * Answers GET /securemode the way its entity handler does while another
+ * thread feeds discovery responses to the bridge back to back, and reports the
+ * 99th percentile latency.
+ */
+
+static const size_t DISCOVERY_DEVICES = 32;
+static const uint64_t DISCOVERY_GAP_NS = 10000;
+
+static uint64_t Now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void Spin(uint64_t ns)
+{
+  uint64_t end = Now() + ns;
+  while (Now() < end)
+  {
+  }
+}
+
+static void AddResource(OCDiscoveryPayload *payload, const char *uri, const char *rt)
+{
+  OCResourcePayload *resource = (OCResourcePayload *) OICCalloc(1, sizeof(OCResourcePayload));
+  resource->uri = OICStrdup(uri);
+  OCResourcePayloadAddStringLL(&resource->types, rt);
+  OCResourcePayloadAddStringLL(&resource->interfaces, OC_RSRVD_INTERFACE_DEFAULT);
+  resource->bitmap = OC_DISCOVERABLE | OC_OBSERVABLE;
+  OCDiscoveryPayloadAddNewResource(payload, resource);
+}
+
+/* One discovery response with a payload for each device, in one of two versions. */
+static OCDiscoveryPayload *CreateDiscoveryPayload(int version)
+{
+  OCDiscoveryPayload *head = NULL;
+  for (size_t i = DISCOVERY_DEVICES; i > 0; --i)
+  {
+    OCDiscoveryPayload *payload = OCDiscoveryPayloadCreate();
+    char sid[40];
+    snprintf(sid, sizeof(sid), "00000000-0000-4000-8000-%012zx", i);
+    payload->sid = OICStrdup(sid);
+    AddResource(payload, OC_RSRVD_DEVICE_URI, OC_RSRVD_RESOURCE_TYPE_DEVICE);
+    AddResource(payload, OC_RSRVD_PLATFORM_URI, OC_RSRVD_RESOURCE_TYPE_PLATFORM);
+    AddResource(payload, version ? "/sensor/1" : "/sensor/0", "x.org.example.sensor");
+    payload->next = head;
+    head = payload;
+  }
+  return head;
+}
+
+/*
+ * Runs Bridge::DiscoverCB back to back.  The responses alternate between two
+ * versions of the devices, so each one is analysed again under the bridge
+ * mutex.
+ */
+class BridgeBench
+{
+  public:
+    BridgeBench() : bridge_("/bench", Bridge::OC), done_(false)
+    {
+      payloads_[0] = CreateDiscoveryPayload(0);
+      payloads_[1] = CreateDiscoveryPayload(1);
+      thread_ = std::thread(&BridgeBench::Run, this);
+    }
+    ~BridgeBench()
+    {
+      done_ = true;
+      thread_.join();
+      OCDiscoveryPayloadDestroy(payloads_[0]);
+      OCDiscoveryPayloadDestroy(payloads_[1]);
+    }
+    std::mutex &GetMutex() { return bridge_.mutex_; }
+
+  private:
+    Bridge bridge_;
+    OCDiscoveryPayload *payloads_[2];
+    std::atomic<bool> done_;
+    std::thread thread_;
+
+    void Run()
+    {
+      OCClientResponse response;
+      memset(&response, 0, sizeof(response));
+      response.result = OC_STACK_OK;
+      for (size_t round = 0; !done_; ++round)
+      {
+        response.payload = (OCPayload *) payloads_[round % 2];
+        Bridge::DiscoverCB(&bridge_, bridge_.discover_handle_, &response);
+        Spin(DISCOVERY_GAP_NS);
+      }
+    }
+};
+
+static SecureModeResource *SecureMode(OCResourceHandle *handle)
+{
+  static SecureModeResource *secure_mode = NULL;
+  static OCResourceHandle secure_mode_handle = NULL;
+  if (!secure_mode)
+  {
+    OCInit1(OC_SERVER, OC_DEFAULT_FLAGS, OC_DEFAULT_FLAGS);
+    secure_mode = new SecureModeResource(false);
+    secure_mode->Create();
+    secure_mode_handle = OCGetResourceHandleAtUri(OC_RSRVD_SECURE_MODE_URI);
+  }
+  *handle = secure_mode_handle;
+  return secure_mode;
+}
+
+/* The GET path of SecureModeResource::EntityHandlerCB, up to the response. */
+static void Get(SecureModeResource *secure_mode, OCResourceHandle handle)
+{
+  OCEntityHandlerRequest request;
+  memset(&request, 0, sizeof(request));
+  request.resource = handle;
+  request.method = OC_REST_GET;
+  request.query = (char *) "if=" OC_RSRVD_INTERFACE_DEFAULT;
+  QueryView query(request.query);
+  if (!IsValidRequest(&request, query))
+  {
+    return;
+  }
+  PayloadArena arena;
+  OCRepPayload *payload = CreatePayload(handle, query, arena);
+  OCRepPayloadSetPropBool(payload, "secureMode", secure_mode->GetSecureMode());
+  DoNotOptimize(payload);
+  arena.Destroy(payload);
+}
+
+static void ReportP99(Benchmark &b, std::vector<uint64_t> &latencies)
+{
+  std::sort(latencies.begin(), latencies.end());
+  b.Report("p99_ns", (double) latencies[latencies.size() * 99 / 100], false);
+}
+
+/* The entity handler as it was, taking the bridge mutex. */
+BENCHMARK(ContendedGetLegacy)
+{
+  OCResourceHandle handle;
+  SecureModeResource *secure_mode = SecureMode(&handle);
+  std::vector<uint64_t> latencies(b.Iterations());
+  BridgeBench discovery;
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    uint64_t start = Now();
+    {
+      std::lock_guard<std::mutex> lock(discovery.GetMutex());
+      Get(secure_mode, handle);
+    }
+    latencies[i] = Now() - start;
+  }
+  b.StopTimer();
+  ReportP99(b, latencies);
+}
+
+BENCHMARK(ContendedGet)
+{
+  OCResourceHandle handle;
+  SecureModeResource *secure_mode = SecureMode(&handle);
+  std::vector<uint64_t> latencies(b.Iterations());
+  BridgeBench discovery;
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    uint64_t start = Now();
+    Get(secure_mode, handle);
+    latencies[i] = Now() - start;
+  }
+  b.StopTimer();
+  ReportP99(b, latencies);
+}
@@ -0,0 +1,71 @@
+#include "bench.h"
+#include "han_message.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/* A reply page as CMBS sends it: five devices per GET_DEV_TABLE. */
+static std::string DeviceTable(uint16_t index, uint8_t n)
+{
+  char line[128];
+  std::string text;
+  snprintf(line, sizeof(line), " DEV_INDEX: %u\r\n NO_OF_DEVICES: %u\r\n", index, n);
+  text += line;
+  for (uint8_t i = 0; i < n; ++i)
+  {
+    snprintf(line, sizeof(line), " DEV_ID: %u\r\n DEV_IPUI: 2 0 %u 1 %u\r\n DEV_EMC: 18 52\r\n",
+             index + i + 1, i, index + i);
+    text += line;
+  }
+  return text;
+}
+
+BENCHMARK(HanMessagePack)
+{
+  char parameters[] = " DEV_INDEX: 0\r\n HOW_MANY: 5\r\n";
+  uint64_t allocations = Allocations();
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    HanMessage msg(NULL, (char *) "GET_DEV_TABLE");
+    msg.parameters = parameters;
+    char *buffer;
+    size_t size = msg.pack(buffer);
+    DoNotOptimize(size);
+    free(buffer);
+  }
+  b.Report("allocs/op", Allocations() - allocations);
+}
+
+/* unpack() tokenizes in place, so each iteration also copies the datagram back. */
+BENCHMARK(HanMessageUnpack)
+{
+  std::string text = "DEV_TABLE\r\n" + DeviceTable(0, 5);
+  std::vector<char> buffer(text.size() + 1);
+  uint64_t allocations = Allocations();
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    memcpy(buffer.data(), text.c_str(), text.size() + 1);
+    HanMessage msg;
+    msg.unpack(buffer.data(), buffer.size());
+    DoNotOptimize(msg.parameters);
+    free(msg.command);
+    free(msg.parameters);
+  }
+  b.Report("allocs/op", Allocations() - allocations);
+}
+
+BENCHMARK(DeviceTableUnpack)
+{
+  std::string text = DeviceTable(0, 5);
+  std::vector<char> buffer(text.size() + 1);
+  uint64_t allocations = Allocations();
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    memcpy(buffer.data(), text.c_str(), text.size() + 1);
+    DeviceTableMessage dtm;
+    dtm.unpack(buffer.data());
+    DoNotOptimize(dtm.dev_ids);
+  }
+  b.Report("allocs/op", Allocations() - allocations);
+}
@@ -0,0 +1,74 @@
+#include "bench.h"
+#include "device_information.h"
+#include "hash.h"
+
+static void Ipui(uint32_t n, uint8_t ipui[5], uint8_t emc[2])
+{
+  ipui[0] = 0x01;
+  ipui[1] = n >> 24;
+  ipui[2] = n >> 16;
+  ipui[3] = n >> 8;
+  ipui[4] = n;
+  emc[0] = 0x12;
+  emc[1] = 0x34;
+}
+
+BENCHMARK(HashIpuiEmc)
+{
+  uint8_t ipui[5], emc[2];
+  OCUUIdentity id;
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    Ipui(i, ipui, emc);
+    Hash(&id, ipui, emc);
+    DoNotOptimize(id);
+  }
+}
+
+BENCHMARK(HashIpuiEmcBatch)
+{
+  static const size_t BATCH = 64;
+  uint8_t ipui[BATCH][5], emc[BATCH][2];
+  uint8_t *ipuis[BATCH], *emcs[BATCH];
+  OCUUIdentity ids[BATCH];
+  for (size_t j = 0; j < BATCH; ++j)
+  {
+    ipuis[j] = ipui[j];
+    emcs[j] = emc[j];
+  }
+  for (size_t i = 0; i < b.Iterations(); i += BATCH)
+  {
+    size_t n = (b.Iterations() - i < BATCH) ? b.Iterations() - i : BATCH;
+    for (size_t j = 0; j < n; ++j)
+    {
+      Ipui(i + j, ipui[j], emc[j]);
+    }
+    Hash(ids, ipuis, emcs, n);
+    DoNotOptimize(ids);
+  }
+}
+
+BENCHMARK(GetProtocolIndependentIdHit)
+{
+  uint8_t ipui[5], emc[2];
+  char piid[UUID_STRING_SIZE];
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    /* A working set that fits in the cache, as on repeated device table syncs. */
+    Ipui(i % 64, ipui, emc);
+    GetProtocolIndependentId(ipui, emc, piid);
+    DoNotOptimize(piid);
+  }
+}
+
+BENCHMARK(GetProtocolIndependentIdMiss)
+{
+  uint8_t ipui[5], emc[2];
+  char piid[UUID_STRING_SIZE];
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    Ipui(0x80000000 + i, ipui, emc);
+    GetProtocolIndependentId(ipui, emc, piid);
+    DoNotOptimize(piid);
+  }
+}
@@ -0,0 +1,95 @@
+#include "bench.h"
+#include "device_configuration_resource.h"
+#include "interfaces.h"
+#include "octypes.h"
+#include "platform_configuration_resource.h"
+#include <string.h>
+
+/* Resource types seen in discovery responses of OCF devices and bridges. */
+static const char *corpus[] = {
+  "oic.wk.d", "oic.wk.p", "oic.wk.res", "oic.wk.introspection", "oic.wk.con", "oic.wk.con.p",
+  "oic.wk.mnt", "oic.wk.col", "oic.wk.rd", "oic.wk.rdpub", "oic.d.bridge", "oic.d.virtual",
+  "oic.d.light", "oic.d.switch", "oic.d.thermostat", "oic.d.airconditioner", "oic.d.smartlock",
+  "oic.d.sensor", "oic.d.smartplug", "oic.d.fan", "oic.d.blind", "oic.d.camera",
+  "oic.r.acl2", "oic.r.cred", "oic.r.csr", "oic.r.crl", "oic.r.doxm", "oic.r.pstat",
+  "oic.r.roles", "oic.r.amacl", "oic.r.securemode", "oic.r.hanfunobject",
+  "oic.r.switch.binary", "oic.r.light.brightness", "oic.r.light.dimming", "oic.r.colour.rgb",
+  "oic.r.colour.chroma", "oic.r.colour.colourtemperature", "oic.r.temperature",
+  "oic.r.humidity", "oic.r.sensor", "oic.r.sensor.motion", "oic.r.sensor.contact",
+  "oic.r.sensor.water", "oic.r.sensor.smoke", "oic.r.sensor.carbonmonoxide",
+  "oic.r.sensor.illuminance", "oic.r.sensor.presence", "oic.r.sensor.glassbreak",
+  "oic.r.energy.battery", "oic.r.energy.consumption", "oic.r.energy.electrical",
+  "oic.r.energy.usage", "oic.r.operational.state", "oic.r.mode", "oic.r.lock.status",
+  "oic.r.lock.code", "oic.r.door", "oic.r.openlevel", "oic.r.airflow", "oic.r.airqualitycollection",
+  "oic.r.airquality", "oic.r.audio", "oic.r.media", "oic.r.media.input", "oic.r.speech.tts",
+  "oic.r.time.period", "oic.r.time.stopwatch", "oic.r.timer", "oic.r.alarm", "oic.r.icemaker",
+  "oic.r.refrigeration", "oic.r.signalstrength", "oic.r.userinfo", "oic.r.weight",
+  "oic.r.height", "oic.r.heartrate", "oic.r.bloodpressure", "oic.r.glucose", "oic.r.pm2.5",
+  "oic.r.pm10", "oic.r.pressure", "oic.r.registration", "x.com.example.custom",
+  "x.org.hanfun.alert", "x.org.hanfun.levelcontrol", "x.org.hanfun.onoff"
+};
+static const size_t CORPUS_SIZE = sizeof(corpus) / sizeof(corpus[0]);
+
+/* The linear classifier used before ClassifyResourceType, for comparison. */
+static bool LegacyTranslateResourceType(const char *name)
+{
+  const char *do_not_translate[] = {
+    "oic.d.bridge",
+    OC_RSRVD_RESOURCE_TYPE_COLLECTION, OC_RSRVD_RESOURCE_TYPE_INTROSPECTION,
+    OC_RSRVD_RESOURCE_TYPE_RD, OC_RSRVD_RESOURCE_TYPE_RDPUBLISH, OC_RSRVD_RESOURCE_TYPE_RES,
+    "oic.r.hanfunobject", "oic.r.acl", "oic.r.acl2", "oic.r.amacl", "oic.r.cred", "oic.r.crl",
+    "oic.r.csr", "oic.r.doxm", "oic.r.pstat", "oic.r.roles", "oic.r.securemode"
+  };
+  for (size_t i = 0; i < sizeof(do_not_translate)/sizeof(do_not_translate[0]); ++i)
+  {
+    if (!strcmp(do_not_translate[i], name))
+    {
+      return false;
+    }
+  }
+  const char *do_deep_translation[] = {
+    OC_RSRVD_RESOURCE_TYPE_DEVICE, OC_RSRVD_RESOURCE_TYPE_DEVICE_CONFIGURATION,
+    OC_RSRVD_RESOURCE_TYPE_MAINTENANCE, OC_RSRVD_RESOURCE_TYPE_PLATFORM,
+    OC_RSRVD_RESOURCE_TYPE_PLATFORM_CONFIGURATION
+  };
+  for (size_t i = 0; i < sizeof(do_deep_translation)/sizeof(do_deep_translation[0]); ++i)
+  {
+    if (!strcmp(do_deep_translation[i], name))
+    {
+      return true;
+    }
+  }
+  return true;
+}
+
+BENCHMARK(TranslateResourceTypeLegacy)
+{
+  size_t translated = 0;
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    translated += LegacyTranslateResourceType(corpus[i % CORPUS_SIZE]);
+  }
+  DoNotOptimize(translated);
+}
+
+BENCHMARK(TranslateResourceType)
+{
+  size_t translated = 0;
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    translated += TranslateResourceType(corpus[i % CORPUS_SIZE]);
+  }
+  DoNotOptimize(translated);
+}
+
+BENCHMARK(TranslateResourceTypeRegistered)
+{
+  RegisterResourceType("x.org.hanfun.onoff", RT_TRANSLATE);
+  size_t translated = 0;
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    translated += TranslateResourceType(corpus[i % CORPUS_SIZE]);
+  }
+  DoNotOptimize(translated);
+  UnregisterResourceType("x.org.hanfun.onoff");
+}
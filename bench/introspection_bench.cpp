@@ -0,0 +1,49 @@
+#include "bench.h"
+#include "introspection.h"
+#include "ocpayload.h"
+#include "ocstack.h"
+
+static void Init()
+{
+  static bool initialized = false;
+  if (!initialized)
+  {
+    OCInit1(OC_SERVER, OC_DEFAULT_FLAGS, OC_DEFAULT_FLAGS);
+    initialized = true;
+  }
+}
+
+BENCHMARK(Introspect)
+{
+  Init();
+  uint8_t out[4096];
+  uint64_t allocations = Allocations();
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    size_t size = sizeof(out);
+    CborError err = Introspect("TITLE", "VERSION", out, &size);
+    DoNotOptimize(err);
+  }
+  b.Report("allocs/op", Allocations() - allocations);
+}
+
+BENCHMARK(IntrospectDefinition)
+{
+  OCRepPayload *payload = OCRepPayloadCreate();
+  OCRepPayloadAddResourceType(payload, "oic.r.light.brightness");
+  OCRepPayloadSetPropInt(payload, "brightness", 50);
+  OCRepPayloadSetPropString(payload, "name", "bench");
+  OCRepPayloadSetPropBool(payload, "dimmable", true);
+  std::vector<std::string> interfaces;
+  interfaces.push_back(OC_RSRVD_INTERFACE_DEFAULT);
+  interfaces.push_back(OC_RSRVD_INTERFACE_READ_WRITE);
+  uint64_t allocations = Allocations();
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    OCRepPayload *definition = IntrospectDefinition(payload, "oic.r.light.brightness", interfaces);
+    DoNotOptimize(definition);
+    OCRepPayloadDestroy(definition);
+  }
+  b.Report("allocs/op", Allocations() - allocations);
+  OCRepPayloadDestroy(payload);
+}
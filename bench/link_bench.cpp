@@ -0,0 +1,130 @@
+#include "bench.h"
+#include "ocpayload.h"
+#include "oic_malloc.h"
+#include "oic_string.h"
+#include "resource.h"
+#include <stdio.h>
+
+static const size_t LINKS = 10000;
+
+static const char *endpoints[] = {
+  "coaps://[fe80::b82e:3bff:fe56:9a6c%25eth0]:50364",
+  "coap://192.168.1.100:5683",
+  "coaps+tcp://[2001:db8::42]:38221",
+  "coap+tcp://10.0.0.7:43210"
+};
+static const size_t ENDPOINTS = sizeof(endpoints) / sizeof(endpoints[0]);
+
+static OCRepPayload *CreateLink(size_t i)
+{
+  OCRepPayload *link = OCRepPayloadCreate();
+  char href[32];
+  snprintf(href, sizeof(href), "/hf/%zu/binaryswitch", i);
+  OCRepPayloadSetPropString(link, OC_RSRVD_HREF, href);
+  OCRepPayloadSetPropString(link, OC_RSRVD_REL, "item");
+  size_t dim[MAX_REP_ARRAY_DEPTH] = { 2, 0, 0 };
+  const char *rts[] = { "oic.r.switch.binary", "oic.r.light.brightness" };
+  OCRepPayloadSetStringArray(link, OC_RSRVD_RESOURCE_TYPE, rts, dim);
+  const char *ifs[] = { OC_RSRVD_INTERFACE_DEFAULT, OC_RSRVD_INTERFACE_ACTUATOR };
+  OCRepPayloadSetStringArray(link, OC_RSRVD_INTERFACE, ifs, dim);
+  OCRepPayload *policy = OCRepPayloadCreate();
+  OCRepPayloadSetPropInt(policy, OC_RSRVD_BITMAP, OC_DISCOVERABLE | OC_OBSERVABLE);
+  OCRepPayloadSetPropObjectAsOwner(link, OC_RSRVD_POLICY, policy);
+  const OCRepPayload *eps[2];
+  for (size_t j = 0; j < 2; ++j)
+  {
+    OCRepPayload *ep = OCRepPayloadCreate();
+    OCRepPayloadSetPropString(ep, OC_RSRVD_ENDPOINT, endpoints[(i + j) % ENDPOINTS]);
+    OCRepPayloadSetPropInt(ep, OC_RSRVD_PRIORITY, 1);
+    eps[j] = ep;
+  }
+  OCRepPayloadSetPropObjectArray(link, OC_RSRVD_ENDPOINTS, eps, dim);
+  for (size_t j = 0; j < 2; ++j)
+  {
+    OCRepPayloadDestroy((OCRepPayload *) eps[j]);
+  }
+  return link;
+}
+
+static std::vector<OCRepPayload *> &Links()
+{
+  static std::vector<OCRepPayload *> links;
+  if (links.empty())
+  {
+    for (size_t i = 0; i < LINKS; ++i)
+    {
+      links.push_back(CreateLink(i));
+    }
+  }
+  return links;
+}
+
+/* sscanf into heap buffers followed by the %25 copy of GetDevAddrs(), as before ParseEndpoint(). */
+static bool LegacyParseEndpoint(const char *s, OCDevAddr *addr)
+{
+  char *tps = (char *) OICMalloc(11);
+  char *host = (char *) OICMalloc(49);
+  int port;
+  bool success = tps && host && (sscanf(s, "%10[^:]://%48[^]]", tps, host) == 2);
+  if (success)
+  {
+    const char *colon = strrchr(s, ':');
+    port = colon ? atoi(colon + 1) : 0;
+    addr->adapter = strstr(tps, "tcp") ? OC_ADAPTER_TCP : OC_ADAPTER_IP;
+    addr->flags = (host[0] == '[') ? OC_IP_USE_V6 : OC_IP_USE_V4;
+    addr->port = (uint16_t) port;
+    memset(addr->addr, 0, MAX_ADDR_STR_SIZE);
+    for (size_t i = (host[0] == '[') ? 1 : 0, j = 0; (i < MAX_ADDR_STR_SIZE) && host[i]; ++i, ++j)
+    {
+      addr->addr[j] = host[i];
+      if (addr->flags & OC_IP_USE_V6 && !strncmp(&host[i], "%25", 3))
+      {
+        i += 2;
+      }
+    }
+  }
+  OICFree(host);
+  OICFree(tps);
+  return success;
+}
+
+BENCHMARK(ParseEndpointLegacy)
+{
+  OCDevAddr addr;
+  uint64_t allocations = Allocations();
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    bool success = LegacyParseEndpoint(endpoints[i % ENDPOINTS], &addr);
+    DoNotOptimize(success);
+  }
+  b.Report("allocs/op", Allocations() - allocations);
+}
+
+BENCHMARK(ParseEndpoint)
+{
+  OCDevAddr addr;
+  uint64_t allocations = Allocations();
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    bool success = ParseEndpoint(endpoints[i % ENDPOINTS], &addr);
+    DoNotOptimize(success);
+  }
+  b.Report("allocs/op", Allocations() - allocations);
+}
+
+/* Each operation parses all LINKS links. */
+BENCHMARK(ParseLink10k)
+{
+  std::vector<OCRepPayload *> &links = Links();
+  uint64_t allocations = Allocations();
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    for (OCRepPayload *link : links)
+    {
+      OCResourcePayload *resource = ParseLink(link);
+      DoNotOptimize(resource);
+      OCDiscoveryResourceDestroy(resource);
+    }
+  }
+  b.Report("allocs/link", (double) (Allocations() - allocations) / LINKS);
+}
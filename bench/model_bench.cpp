@@ -0,0 +1,118 @@
+#include "bench.h"
+#include "ocpayload.h"
+#include "oic_malloc.h"
+#include "oic_string.h"
+#include "resource.h"
+#include <stdio.h>
+
+/*
+ * Measures the heap held by the discovered Device/Resource graph.  Each simulated
+ * device advertises the same ten resources over two endpoints, as a HAN-FUN bridge
+ * or a farm of identical devices would.
+ */
+static const size_t RESOURCES_PER_DEVICE = 10;
+
+static const struct
+{
+  const char *uri;
+  const char *rt;
+} resources[RESOURCES_PER_DEVICE] =
+{
+  { "/oic/d", "oic.wk.d" },
+  { "/oic/p", "oic.wk.p" },
+  { "/oic/res", "oic.wk.res" },
+  { "/introspection", "oic.wk.introspection" },
+  { "/binaryswitch", "oic.r.switch.binary" },
+  { "/brightness", "oic.r.light.brightness" },
+  { "/temperature", "oic.r.temperature" },
+  { "/humidity", "oic.r.humidity" },
+  { "/battery", "oic.r.energy.battery" },
+  { "/motion", "oic.r.sensor.motion" }
+};
+
+static OCEndpointPayload *CreateEndpoint(const char *tps, const char *addr, uint16_t port,
+  OCEndpointPayload *next)
+{
+  OCEndpointPayload *ep = (OCEndpointPayload *) OICCalloc(1, sizeof(OCEndpointPayload));
+  ep->tps = OICStrdup(tps);
+  ep->addr = OICStrdup(addr);
+  ep->family = OC_IP_USE_V4;
+  ep->port = port;
+  ep->pri = 1;
+  ep->next = next;
+  return ep;
+}
+
+static OCDiscoveryPayload *CreateDiscoveryPayload(size_t device)
+{
+  OCDiscoveryPayload *payload = OCDiscoveryPayloadCreate();
+  char str[64];
+  snprintf(str, sizeof(str), "a0b1c2d3-e4f5-4000-8000-%012zx", device);
+  payload->sid = OICStrdup(str);
+  snprintf(str, sizeof(str), "10.%zu.%zu.%zu", (device >> 16) & 0xff, (device >> 8) & 0xff,
+    device & 0xff);
+  for (size_t i = 0; i < RESOURCES_PER_DEVICE; ++i)
+  {
+    OCResourcePayload *resource = (OCResourcePayload *) OICCalloc(1, sizeof(OCResourcePayload));
+    resource->uri = OICStrdup(resources[i].uri);
+    OCResourcePayloadAddStringLL(&resource->types, resources[i].rt);
+    OCResourcePayloadAddStringLL(&resource->interfaces, OC_RSRVD_INTERFACE_DEFAULT);
+    OCResourcePayloadAddStringLL(&resource->interfaces, OC_RSRVD_INTERFACE_READ);
+    resource->bitmap = OC_DISCOVERABLE | OC_OBSERVABLE;
+    resource->eps = CreateEndpoint("coaps", str, 5684, CreateEndpoint("coap", str, 5683, NULL));
+    OCDiscoveryPayloadAddNewResource(payload, resource);
+  }
+  return payload;
+}
+
+static void DeviceGraph(Benchmark &b, size_t n)
+{
+  b.StopTimer();
+  OCDevAddr origin;
+  memset(&origin, 0, sizeof(origin));
+  origin.adapter = OC_ADAPTER_IP;
+  std::vector<OCDiscoveryPayload *> payloads;
+  for (size_t i = 0; i < n / RESOURCES_PER_DEVICE; ++i)
+  {
+    payloads.push_back(CreateDiscoveryPayload(i));
+  }
+  int64_t bytes = 0;
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    std::vector<Device *> devices;
+    devices.reserve(payloads.size());
+    int64_t before = AllocatedBytes();
+    b.StartTimer();
+    for (OCDiscoveryPayload *payload : payloads)
+    {
+      devices.push_back(new Device(origin, payload));
+    }
+    b.StopTimer();
+    bytes = AllocatedBytes() - before;
+    for (Device *device : devices)
+    {
+      delete device;
+    }
+  }
+  for (OCDiscoveryPayload *payload : payloads)
+  {
+    OCDiscoveryPayloadDestroy(payload);
+  }
+  b.Report("bytes/resource", (double) bytes / n, false);
+  b.StartTimer();
+}
+
+BENCHMARK(DeviceGraph1k)
+{
+  DeviceGraph(b, 1000);
+}
+
+BENCHMARK(DeviceGraph10k)
+{
+  DeviceGraph(b, 10000);
+}
+
+BENCHMARK(DeviceGraph100k)
+{
+  DeviceGraph(b, 100000);
+}
@@ -0,0 +1,245 @@
+#include "bench.h"
+#include "ocpayload.h"
+#include "ocstack.h"
+#include "oic_malloc.h"
+#include "oic_string.h"
+#include "payload_arena.h"
+#include "resource.h"
+#include <map>
+#include <string>
+
+static OCEntityHandlerResult EntityHandlerCB(OCEntityHandlerFlag flag, OCEntityHandlerRequest *request,
+  void *ctx)
+{
+  (void) flag;
+  (void) request;
+  (void) ctx;
+  return OC_EH_OK;
+}
+
+static OCResourceHandle Resource()
+{
+  static OCResourceHandle handle = NULL;
+  if (!handle)
+  {
+    OCInit1(OC_SERVER, OC_DEFAULT_FLAGS, OC_DEFAULT_FLAGS);
+    CreateResource(&handle, "/bench", "oic.r.switch.binary", OC_RSRVD_INTERFACE_ACTUATOR,
+      EntityHandlerCB, NULL, OC_DISCOVERABLE | OC_OBSERVABLE);
+    OCBindResourceTypeToResource(handle, "oic.r.light.brightness");
+    OCBindResourceInterfaceToResource(handle, OC_RSRVD_INTERFACE_READ_WRITE);
+  }
+  return handle;
+}
+
+/* The response construction used before PayloadArena, for comparison. */
+static bool LegacySetStringArray(OCRepPayload *payload, const char *name, uint8_t n,
+  const char *(*get)(OCResourceHandle, uint8_t), OCResourceHandle resource)
+{
+  size_t dim[MAX_REP_ARRAY_DEPTH] = { n, 0, 0 };
+  char **array = (char **)OICCalloc(n, sizeof(char *));
+  if (!array)
+  {
+    return false;
+  }
+  for (uint8_t i = 0; i < n; ++i)
+  {
+    array[i] = OICStrdup(get(resource, i));
+  }
+  return OCRepPayloadSetStringArrayAsOwner(payload, name, array, dim);
+}
+
+static OCRepPayload *LegacyGet(OCResourceHandle resource)
+{
+  OCRepPayload *payload = OCRepPayloadCreate();
+  uint8_t n;
+  OCGetNumberOfResourceTypes(resource, &n);
+  LegacySetStringArray(payload, OC_RSRVD_RESOURCE_TYPE, n, OCGetResourceTypeName, resource);
+  OCGetNumberOfResourceInterfaces(resource, &n);
+  LegacySetStringArray(payload, OC_RSRVD_INTERFACE, n, OCGetResourceInterfaceName, resource);
+  OCRepPayloadSetPropBool(payload, "value", true);
+  OCRepPayloadSetPropString(payload, "name", "bench");
+  return payload;
+}
+
+BENCHMARK(GetBaselineLegacy)
+{
+  OCResourceHandle resource = Resource();
+  uint64_t allocations = Allocations();
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    OCRepPayload *payload = LegacyGet(resource);
+    DoNotOptimize(payload);
+    OCRepPayloadDestroy(payload);
+  }
+  b.Report("allocs/op", Allocations() - allocations);
+}
+
+BENCHMARK(GetBaselineArena)
+{
+  OCResourceHandle resource = Resource();
+  uint64_t allocations = Allocations();
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    PayloadArena arena;
+    OCRepPayload *payload = CreatePayload(resource, QueryView("if=" OC_RSRVD_INTERFACE_DEFAULT), arena);
+    OCRepPayloadSetPropBool(payload, "value", true);
+    OCRepPayloadSetPropStringAsOwner(payload, "name", arena.Strdup("bench"));
+    DoNotOptimize(payload);
+    arena.Destroy(payload);
+  }
+  b.Report("allocs/op", Allocations() - allocations);
+}
+
+BENCHMARK(GetBaselineArenaUncached)
+{
+  OCResourceHandle resource = Resource();
+  uint64_t allocations = Allocations();
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    InvalidateFragments(resource);
+    PayloadArena arena;
+    OCRepPayload *payload = CreatePayload(resource, QueryView("if=" OC_RSRVD_INTERFACE_DEFAULT), arena);
+    OCRepPayloadSetPropBool(payload, "value", true);
+    OCRepPayloadSetPropStringAsOwner(payload, "name", arena.Strdup("bench"));
+    DoNotOptimize(payload);
+    arena.Destroy(payload);
+  }
+  b.Report("allocs/op", Allocations() - allocations);
+}
+
+static const char *QUERY = "if=" OC_RSRVD_INTERFACE_ACTUATOR "&rt=oic.r.switch.binary";
+
+/* The query parsing used before QueryView, for comparison. */
+static std::map<std::string, std::string> LegacyParseQuery(OCResourceHandle resource, const char *query)
+{
+  std::map<std::string, std::string> queryMap;
+
+  if (query)
+  {
+    std::string queryStr = query;
+    std::string::size_type beg, end = 0;
+    beg = 0;
+    while (end != std::string::npos)
+    {
+      std::string key, value;
+      end = queryStr.find('=', beg);
+      if (end == std::string::npos)
+      {
+        key = queryStr.substr(beg);
+      }
+      else
+      {
+        key = queryStr.substr(beg, end - beg);
+        beg = end + 1;
+        end = queryStr.find_first_of("&;", beg);
+        if (end == std::string::npos)
+        {
+          value = queryStr.substr(beg);
+        }
+        else
+        {
+          value = queryStr.substr(beg, end - beg);
+          beg = end + 1;
+        }
+      }
+      queryMap[key] = value;
+    }
+  }
+  /* Default interface for multi-value rt resources is the baseline interface. */
+  if (queryMap.find(OC_RSRVD_INTERFACE) == queryMap.end())
+  {
+    uint8_t n = 0;
+    if ((OCGetNumberOfResourceTypes(resource, &n) == OC_STACK_OK) && n)
+    {
+      queryMap[OC_RSRVD_INTERFACE] = OC_RSRVD_INTERFACE_DEFAULT;
+    }
+  }
+  return queryMap;
+}
+
+/* The request validation used before QueryView, for comparison. */
+static bool LegacyIsValidRequest(OCEntityHandlerRequest *request)
+{
+  uint8_t n;
+  auto queryMap = LegacyParseQuery(request->resource, request->query);
+  auto itf = queryMap.find("if");
+  bool hasItf = false;
+  OCGetNumberOfResourceInterfaces(request->resource, &n);
+  for (uint8_t i = 0; i < n; ++i)
+  {
+    if (itf->second == OCGetResourceInterfaceName(request->resource, i))
+    {
+      hasItf = true;
+      break;
+    }
+  }
+  bool hasRt = false;
+  auto rt = queryMap.find("rt");
+  if (rt != queryMap.end())
+  {
+    OCGetNumberOfResourceTypes(request->resource, &n);
+    for (uint8_t i = 0; i < n; ++i)
+    {
+      if (rt->second == OCGetResourceTypeName(request->resource, i))
+      {
+        hasRt = true;
+        break;
+      }
+    }
+  }
+  return hasItf && hasRt;
+}
+
+BENCHMARK(ParseQueryMap)
+{
+  OCResourceHandle resource = Resource();
+  uint64_t allocations = Allocations();
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    std::map<std::string, std::string> query = LegacyParseQuery(resource, QUERY);
+    DoNotOptimize(query);
+  }
+  b.Report("allocs/op", Allocations() - allocations);
+}
+
+BENCHMARK(ParseQueryView)
+{
+  uint64_t allocations = Allocations();
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    QueryView query(QUERY);
+    DoNotOptimize(query);
+  }
+  b.Report("allocs/op", Allocations() - allocations);
+}
+
+BENCHMARK(IsValidRequestMap)
+{
+  OCEntityHandlerRequest request;
+  memset(&request, 0, sizeof(request));
+  request.resource = Resource();
+  request.query = (char *) QUERY;
+  uint64_t allocations = Allocations();
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    bool valid = LegacyIsValidRequest(&request);
+    DoNotOptimize(valid);
+  }
+  b.Report("allocs/op", Allocations() - allocations);
+}
+
+BENCHMARK(IsValidRequestView)
+{
+  OCEntityHandlerRequest request;
+  memset(&request, 0, sizeof(request));
+  request.resource = Resource();
+  request.query = (char *) QUERY;
+  uint64_t allocations = Allocations();
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    QueryView query(request.query);
+    bool valid = IsValidRequest(&request, query);
+    DoNotOptimize(valid);
+  }
+  b.Report("allocs/op", Allocations() - allocations);
+}
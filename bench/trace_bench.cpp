@@ -0,0 +1,23 @@
+#include "bench.h"
+#include "trace.h"
+
+static const char *kDi = "a8a6c9a5-0d2d-4bd1-9f2c-2b7d6bfde1c4";
+
+BENCHMARK(TraceDisabled)
+{
+  Trace::Enable(false);
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    TRACE_INSTANT("callback", kDi, "/oic/d");
+  }
+}
+
+BENCHMARK(TraceEnabled)
+{
+  Trace::Enable(true);
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    TRACE_INSTANT("callback", kDi, "/oic/d");
+  }
+  Trace::Enable(false);
+}
@@ -0,0 +1,42 @@
+#include "bench.h"
+#include "transport_message.h"
+
+/* The packed HAN-FUN packet of an On-Off toggle, as carried in a DATA_MSG. */
+static const uint8_t PACKET[] =
+{
+  0x00, 0x00, 0x00,             // source
+  0x00, 0x01, 0x01,             // destination
+  0x00, 0x00,                   // transport
+  0x01, 0x02, 0x82, 0x00, 0x03, // reference, type, interface, member
+  0x00, 0x00                    // payload length
+};
+
+BENCHMARK(TransportMessagePack)
+{
+  Message msg(DATA_MSG);
+  msg.data = HF::Common::ByteArray(PACKET, sizeof(PACKET));
+  uint64_t allocations = Allocations();
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    HF::Common::ByteArray payload(msg.size());
+    msg.pack(payload);
+    DoNotOptimize(payload);
+  }
+  b.Report("allocs/op", Allocations() - allocations);
+}
+
+BENCHMARK(TransportMessageUnpack)
+{
+  Message msg(DATA_MSG);
+  msg.data = HF::Common::ByteArray(PACKET, sizeof(PACKET));
+  HF::Common::ByteArray frame(msg.size());
+  msg.pack(frame);
+  uint64_t allocations = Allocations();
+  for (size_t i = 0; i < b.Iterations(); ++i)
+  {
+    Message received;
+    received.unpack(frame);
+    DoNotOptimize(received.data);
+  }
+  b.Report("allocs/op", Allocations() - allocations);
+}
@@ -12,14 +12,21 @@
 #include <mutex>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+class DiscoverySchedule;
+class HanEventQueue;
+class MetricsResource;
 class OCSecurity;
 class Presence;
+class PresenceTable;
 class SecureModeResource;
+class Transport;
 class RegistrationResource;
 class VirtualOcfDevice;
 class VirtualResource;
+struct HanEvent;
 
 class Bridge
 {
@@ -50,6 +57,8 @@ class Bridge
     {
       disconnected_cb_ = cb;
     }
+    /* Counts the frames the transport receives as sightings of their source devices. */
+    void SetTransport(Transport *transport);
     void SetDeviceName(const char *device_name)
     {
       device_name_ = device_name;
@@ -59,13 +68,35 @@ class Bridge
       manufacturer_name_ = manufacturer_name;
     }
     void SetSecureMode(bool secure_mode);
+    /*
+     * Takes writing the introspection data off the startup path.  The main
+     * bridge's Start() leaves it to the first Process(), and the publication of
+     * virtual resources to the Resource Directory writes it after publishing
+     * rather than before.
+     */
+    void SetFastStart(bool fast_start)
+    {
+      fast_start_ = fast_start;
+    }
     
     bool Start();
     bool Stop();
     void ResetSecurity();
     bool Process();
+    /*
+     * Sends the notifications held back by the notify windows once the windows
+     * have closed, and acts on what the HAN-FUN client has reported, which moves
+     * a device table sync on to its next page.  Process() does this too, but its
+     * tick is too slow for either, so this should be called every FLUSH_PERIOD_MS
+     * in between.
+     */
+    void Flush();
+    
+    static const uint32_t FLUSH_PERIOD_MS = 50;
     
   private:
+    friend class BridgeBench;
+    friend class BridgeTest;
   
     struct DiscoverContext;
     struct Task
@@ -73,25 +104,31 @@ class Bridge
       time_t tick;
       Task(time_t tick) : tick(tick) {}
       virtual ~Task() {}
+      /* Tasks that only touch the OCF stack or files run without mutex_. */
+      virtual bool NeedsLock() const { return true; }
       virtual void Run(Bridge *thiz) = 0;
     };
     struct DiscoverTask : public Task {
       std::string piid;
-      OCRepPayload *payload;
       DiscoverContext *context;
-      DiscoverTask(time_t tick, const char *piid, OCRepPayload *payload,
-        DiscoverContext *context) : Task(tick), piid(piid),
-        payload(OCRepPayloadClone(payload)), context(context) {}
-      virtual ~DiscoverTask() { OCRepPayloadDestroy(payload); }
+      DiscoverTask(time_t tick, const char *piid, DiscoverContext *context)
+        : Task(tick), piid(piid), context(context) {}
+      virtual ~DiscoverTask() {}
       virtual void Run(Bridge *thiz);
     };
     struct RDPublishTask : public Task {
       RDPublishTask(time_t tick) : Task(tick) {}
       virtual ~RDPublishTask() {}
+      virtual bool NeedsLock() const { return false; }
+      virtual void Run(Bridge *thiz);
+    };
+    struct IntrospectionTask : public Task {
+      IntrospectionTask(time_t tick) : Task(tick) {}
+      virtual ~IntrospectionTask() {}
+      virtual bool NeedsLock() const { return false; }
       virtual void Run(Bridge *thiz);
     };
   
-    static const time_t OCF_DISCOVER_PERIOD_SECS = 5;
     static const time_t HF_DISCOVER_PERIOD_SECS = 30;
   
     ExecCB exec_cb_;
@@ -99,32 +136,50 @@ class Bridge
     GetSeenStateCB seen_state_cb_;
     DisconnectedCB disconnected_cb_;
     
+    /*
+     * Lock order: mutex_, then hf_mutex_.  mutex_ guards the discovery and
+     * presence tables, the observations and the task list; hf_mutex_
+     * serialises requests to han_client_.  The bridge resources keep their
+     * state in atomics and take neither lock to answer a request, and the
+     * libuv thread hands its results over through han_events_ without locking.
+     */
     std::mutex mutex_;
+    std::mutex hf_mutex_;
     std::condition_variable cond_;
     Protocol protocols_;
     enum { CREATED, STARTED, RUNNING } han_state_;
     uint16_t sender_;
     HanClient *han_client_;
+    HanEventQueue *han_events_;
     OCSecurity *oc_security_;
     OCDoHandle discover_handle_;
-    time_t discover_next_tick_;
-    std::vector<Presence *> presence_;
+    DiscoverySchedule *discovery_schedule_;
+    std::map<std::string, OCDoHandle> observe_handles_;
+    PresenceTable *presence_;
+    PresenceTable *hf_presence_;
     std::vector<VirtualOcfDevice *> virtual_ocf_devices_;
     std::vector<VirtualResource *> virtual_resources_;
     std::map<OCDoHandle, DiscoverContext *> discovered_;
+    std::unordered_map<std::string, uint64_t> digests_;
     SecureModeResource *secure_mode_;
     RegistrationResource *registration_;
+    MetricsResource *metrics_;
     std::list<Task *> tasks_;
     RDPublishTask *rd_publish_task_;
     size_t pending_;
     std::string device_name_;
     std::string manufacturer_name_;
     time_t get_devices_next_tick_;
+    uint64_t device_table_started_ms_;
+    uint16_t next_page_index_; /* The device table page to ask for next, or 0 for none */
+    bool fast_start_;
     
     static void RDPublish(void *context);
+    void ScheduleRDPublish();
     void SetIntrospectionData(/* HF Data */const char *title, const char *version);
     void Destroy(const char *id);
     void Destroy(uint16_t id);
+    void Disconnected(uint16_t address);
     VirtualResource *CreateVirtualResource(uint16_t address, const char *path);
     
     static OCStackApplicationResult DiscoverCB(void *context, OCDoHandle handle, OCClientResponse *response);
@@ -137,8 +192,12 @@ class Bridge
     static OCStackApplicationResult GetIntrospectionCB(void *ctx, OCDoHandle handle, OCClientResponse *response);
     static OCStackApplicationResult GetIntrospectionDataCB(void *ctx, OCDoHandle handle, OCClientResponse *response);
     
+    void ProcessHanEvents(std::unique_lock<std::mutex> &lock);
+    void DeviceTable(HanEvent &event, std::unique_lock<std::mutex> &lock);
+    void Activity(const HanEvent &event);
+    static void ActivityCB(uint16_t address, void *context);
     static void GetDeviceTableCB(void* ctx,
-                                 uint8_t dev_index,
+                                 uint16_t dev_index,
                                  uint8_t no_of_devices,
                                  uint16_t *dev_ids,
                                  uint8_t **dev_ipuis,
@@ -147,6 +206,7 @@ class Bridge
     SeenState GetSeenState(const char *piid);
     void DestroyPiid(const char *piid);
     
+    uint64_t Digest(const OCDiscoveryPayload *payload);
     bool IsSelf(const OCDiscoveryPayload *payload);
     bool HasSeenBefore(const OCDiscoveryPayload *payload);
     bool IsSecure(const OCResourcePayload *resource);
@@ -155,6 +215,9 @@ class Bridge
     void UpdatePresenceStatus(const OCDiscoveryPayload *payload);
     void GetContextAndRepPayload(OCDoHandle handle, OCClientResponse *response, DiscoverContext **context, OCRepPayload **payload);
     bool ParseIntrospectionPayload(DiscoverContext *context, OCRepPayload *payload);
+    void ObserveDiscovery(DiscoverContext *context);
+    void CancelObserveDiscovery(const char *id);
+    void FlushNotifications();
     OCStackResult GetIntrospection(DiscoverContext *context);
     OCStackResult GetCollection(DiscoverContext *context);
     OCStackResult GetPlatformConfiguration(DiscoverContext *context);
@@ -2,6 +2,7 @@
 #define _HANCLIENT_H
 
 #include "uv.h"
+#include <atomic>
 
 #ifndef HAN_UNUSED
 #define HAN_UNUSED(x) (void)x;
@@ -9,7 +10,7 @@
 
 typedef void (*han_cb)(void* context);
 typedef void (*han_device_table_cb)(void *context,
-                                    uint8_t dev_index,
+                                    uint16_t dev_index,
                                     uint8_t no_of_devices,
                                     uint16_t *dev_ids,
                                     uint8_t **dev_ipuis,
@@ -32,7 +33,7 @@ class HanClient
     int start();
     int open_registration();
     int close_registration();
-    int get_device_table(uint8_t start_index, uint8_t no_of_devices, void *ctx);
+    int get_device_table(uint16_t start_index, uint8_t no_of_devices, void *ctx);
     void stop();
 
     bool is_initialized()
@@ -60,7 +61,7 @@ class HanClient
     const char* ip_;
     uint16_t port_;
     uv_loop_t* loop_;
-    bool initialized_;
+    std::atomic<bool> initialized_;
 
     uv_udp_send_t request_;
     struct sockaddr_in addr_;
@@ -0,0 +1,131 @@
+#ifndef _METRICS_H
+#define _METRICS_H
+
+#include <atomic>
+#include <inttypes.h>
+#include <stddef.h>
+#include <string>
+
+/*
+ * Metrics of the bridge process.  An update is one relaxed atomic operation,
+ * so metrics may be updated from any thread, including the OCF and libuv
+ * callbacks, without taking a lock.  Readers see each value individually;
+ * there is no snapshot across metrics.
+ */
+class Counter
+{
+  public:
+    Counter() : value_(0) {}
+    void Add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t Get() const { return value_.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<uint64_t> value_;
+};
+
+class Gauge
+{
+  public:
+    Gauge() : value_(0) {}
+    void Set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+    void Add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+    int64_t Get() const { return value_.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<int64_t> value_;
+};
+
+/*
+ * Log-linear histogram of integer values.  Each power of two is split into
+ * SUB_BUCKETS linear buckets, so a quantile is reported with a relative error
+ * below 1 / SUB_BUCKETS.  Values of 2^MAX_BITS and above are counted in the
+ * last bucket.
+ */
+class Histogram
+{
+  public:
+    static const unsigned SUB_BITS = 2;
+    static const unsigned SUB_BUCKETS = 1 << SUB_BITS;
+    static const unsigned MAX_BITS = 32;
+    static const size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+    Histogram();
+    void Observe(uint64_t value);
+    uint64_t GetCount() const;
+    uint64_t GetSum() const { return sum_.load(std::memory_order_relaxed); }
+    uint64_t GetBucket(size_t i) const { return buckets_[i].load(std::memory_order_relaxed); }
+    /* Returns the upper bound of the bucket holding the q quantile, 0 when empty. */
+    uint64_t GetQuantile(double q) const;
+
+    static size_t Index(uint64_t value);
+    /* The largest value counted in bucket i. */
+    static uint64_t UpperBound(size_t i);
+
+  private:
+    std::atomic<uint64_t> buckets_[BUCKETS];
+    std::atomic<uint64_t> sum_;
+
+    Histogram(const Histogram &);
+    Histogram &operator=(const Histogram &);
+};
+
+namespace Metrics
+{
+  enum Type
+  {
+    COUNTER,
+    GAUGE,
+    HISTOGRAM,
+  };
+
+  struct Entry
+  {
+    const char *name;
+    const char *help;
+    Type type;
+    const void *metric;
+  };
+
+  /* OCF discovery */
+  extern Gauge discovery_sessions;
+  extern Histogram onboarding_ms;
+  extern Counter do_resource_retries;
+  extern Counter endpoint_failovers;
+  extern Counter rd_publish;
+  extern Counter rd_publish_errors;
+  extern Counter rd_publish_resources;
+  extern Counter rd_publish_bytes;
+
+  /* HAN-FUN */
+  extern Counter han_messages_in;
+  extern Counter han_messages_out;
+  extern Histogram device_table_sync_ms;
+
+  /* Process */
+  extern Gauge task_queue_depth;
+  extern Gauge plugin_processes;
+  extern Counter plugin_execs;
+
+  /* Startup, the time taken by each phase of main() */
+  extern Gauge startup_storage_us;
+  extern Gauge startup_rd_database_us;
+  extern Gauge startup_stack_us;
+  extern Gauge startup_stop_multicast_us;
+  extern Gauge startup_rd_us;
+  extern Gauge startup_bridge_us;
+  extern Gauge startup_threads_us;
+  extern Gauge startup_total_us;
+  /* Time from the start of a plugin to its first publication to the Resource Directory */
+  extern Gauge startup_reachable_us;
+
+  /* Every metric above, in the order they are reported. */
+  const Entry *Begin();
+  const Entry *End();
+
+  /* Appends every metric in the Prometheus text exposition format. */
+  void WritePrometheus(std::string &out);
+  /* Replaces path with the current metrics, so a reader never sees a partial file. */
+  bool WritePrometheusFile(const char *path);
+}
+
+#endif
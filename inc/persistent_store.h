@@ -0,0 +1,84 @@
+#ifndef _PERSISTENT_STORE_H
+#define _PERSISTENT_STORE_H
+
+#include <inttypes.h>
+#include <mutex>
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+
+/*
+ * Key-value store kept in a single log-structured file, for the OCF
+ * persistent storage of the bridge and its plugins.  Each Put() appends one
+ * record holding the whole value, which only counts once its checksum
+ * matches, so a crash leaves either the old or the new value.  The file is
+ * memory-mapped and indexed on open, so a Get() is a lookup and a copy.
+ *
+ * Several processes may share a store: every operation takes an flock() on
+ * the file and first reads the records appended by the others.  Compact()
+ * writes the live records to a new file and renames it over the old one; the
+ * other processes notice the rename and reopen.
+ */
+class PersistentStore
+{
+  public:
+    PersistentStore();
+    ~PersistentStore();
+
+    /* With sync, each record is flushed to the disk before Put() returns. */
+    bool Open(const char *path, bool sync = false);
+    void Close();
+    bool IsOpen() const { return fd_ >= 0; }
+
+    bool Get(const std::string &key, std::string &value);
+    bool Put(const std::string &key, const void *data, size_t size);
+    bool Remove(const std::string &key);
+    /* Drops the records that were replaced or removed. */
+    bool Compact();
+
+    /*
+     * Opens a stdio stream on the value of key, with the modes of fopen().  A
+     * stream reads the value as it was when the stream was opened; what is
+     * written is put in the store when the stream is closed.
+     */
+    FILE *OpenStream(const std::string &key, const char *mode);
+
+    /* Bytes of the records that hold the current values, and of the file. */
+    size_t GetLiveBytes();
+    size_t GetFileBytes();
+
+  private:
+    struct Entry
+    {
+      size_t offset;
+      uint32_t size;
+      size_t record_size;
+    };
+
+    std::mutex mutex_;
+    std::string path_;
+    bool sync_;
+    int fd_;
+    ino_t ino_;
+    uint8_t *map_;
+    size_t map_size_;
+    size_t end_;
+    size_t live_bytes_;
+    std::unordered_map<std::string, Entry> index_;
+
+    bool OpenFile();
+    void CloseFile();
+    bool Lock();
+    void Unlock();
+    bool Map(size_t size);
+    bool Scan();
+    bool Append(const std::string &key, const void *data, uint32_t size);
+    bool CompactLocked();
+
+    PersistentStore(const PersistentStore &);
+    PersistentStore &operator=(const PersistentStore &);
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define _PLUGIN_H
 
 #include "octypes.h"
+#include <inttypes.h>
 #include <string>
 
 #ifndef UNUSED
@@ -11,6 +12,12 @@
 // Global Resource Directory address
 extern std::string kResourceDirectory;
 
+// Steady clock time, in microseconds, at which the process started
+extern uint64_t kStartUs;
+
+// Steady clock time in microseconds.
+uint64_t NowUs();
+
 // Publish RD resources to Resource Directory.
 OCStackResult RDPublish();
 
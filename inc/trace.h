@@ -0,0 +1,64 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <atomic>
+#include <inttypes.h>
+#include <stddef.h>
+#include <string>
+
+/*
+ * Timeline of the onboarding of each device.  Events are keyed by an id, the
+ * device id for OCF devices, and are recorded with a monotonic timestamp into
+ * a ring of the recording thread, so recording takes no lock.  When a ring is
+ * full the oldest events are overwritten.
+ *
+ * While tracing is disabled, which is the default, the TRACE_ macros cost a
+ * relaxed load and a branch, so they stay in release builds.
+ */
+namespace Trace
+{
+  enum Phase
+  {
+    BEGIN = 'b',
+    END = 'e',
+    INSTANT = 'n',
+  };
+
+  static const size_t RING_SIZE = 2048;
+  static const size_t NAME_SIZE = 48;
+  static const size_t ID_SIZE = 40;
+
+  extern std::atomic<bool> enabled;
+
+  inline bool IsEnabled()
+  {
+    return enabled.load(std::memory_order_relaxed);
+  }
+  void Enable(bool enable);
+  /* Records an event of the span name on the timeline of id; arg is shown with it. */
+  void Record(Phase phase, const char *name, const char *id, const char *arg = NULL);
+  /* Discards the recorded events.  No thread may be recording. */
+  void Clear();
+
+  /* The id given to requests sent by the calling thread, see IdScope. */
+  const char *CurrentId();
+  struct IdScope
+  {
+    const char *saved;
+    IdScope(const char *id);
+    ~IdScope();
+  };
+
+  /* Appends the recorded events in the Chrome trace event format. */
+  void WriteChromeJson(std::string &out);
+  bool WriteChromeJsonFile(const char *path);
+}
+
+#define TRACE_BEGIN(name, id, arg) \
+  do { if (Trace::IsEnabled()) Trace::Record(Trace::BEGIN, (name), (id), (arg)); } while (0)
+#define TRACE_END(name, id, arg) \
+  do { if (Trace::IsEnabled()) Trace::Record(Trace::END, (name), (id), (arg)); } while (0)
+#define TRACE_INSTANT(name, id, arg) \
+  do { if (Trace::IsEnabled()) Trace::Record(Trace::INSTANT, (name), (id), (arg)); } while (0)
+
+#endif
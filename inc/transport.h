@@ -13,13 +13,42 @@ class Transport: public HF::Devices::Node::Transport
 
     uv_tcp_t socket_;
 
+    void (*activity_cb_)(uint16_t address, void *context);
+
+    void *activity_context_;
+
   public:
 
+    Transport():
+      activity_cb_(NULL), activity_context_(NULL)
+    {}
+
     virtual ~Transport() {}
 
-    void initialize();
+    /* Connects to the HAN-FUN base at address:port. */
+    void initialize(const char *address = "127.0.0.1", uint16_t port = 8000);
 
     void destroy();
+
+    /* Called for every data frame received, with the source device address. */
+    void set_activity_cb(void (*cb)(uint16_t address, void *context), void *context)
+    {
+      activity_cb_ = cb;
+      activity_context_ = context;
+    }
+
+    bool has_activity_cb() const
+    {
+      return activity_cb_ != NULL;
+    }
+
+    void activity(uint16_t address)
+    {
+      if (activity_cb_)
+      {
+        activity_cb_(address, activity_context_);
+      }
+    }
 };
 
 class Link: public HF::Transport::AbstractLink
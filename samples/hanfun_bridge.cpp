@@ -1,31 +1,73 @@
 #include "bridge.h"
 #include "log.h"
+#include "metrics.h"
+#include "persistent_store.h"
 #include "plugin.h"
+#include "trace.h"
+#include "transport.h"
 
 #include "ocstack.h"
 #include "rd_client.h"
 #include "rd_server.h"
 #include "uv.h"
+#include <algorithm>
 #include <chrono>
+#include <poll.h>
 #include <signal.h>
 #include <sstream>
 #include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <thread>
 #include <unistd.h>
 
 static volatile sig_atomic_t kQuitFlag = false;
 static volatile sig_atomic_t kResetSecurityFlag = false;
+static volatile sig_atomic_t kTraceFlag = false;
 static const char *kPersistentStoragePrefix = "HanFunBridge_";
 static const char *kUidPrefix = "hf://node.bridge.com/";
 static const char *kUuid = NULL;
 static uint16_t kSenderAddress = 0;
 static const char *kResourceDirectoryDi = NULL;
+static const char *kMetricsPath = NULL;
+static const char *kMetricsSocketPath = NULL;
+static const char *kTracePath = NULL;
+static bool kFastStart = false;
+static const char *kStorePath = NULL;
+static const char *kTransportAddress = NULL;
+static PersistentStore kStore;
+// How long a fast start keeps the processing loops at their startup period
+static const uint64_t kFastStartUs = 10 * 1000 * 1000;
 #if __WITH_DTLS__
 static bool kSecureMode = true;
 #else
 static bool kSecureMode = false;
 #endif
 
+// Period of the processing loops. It is short for the first seconds of a fast
+// start, so the first requests and HAN-FUN responses are not left waiting.
+static std::chrono::milliseconds GetProcessPeriod()
+{
+  bool starting = kFastStart && (NowUs() - kStartUs < kFastStartUs);
+  return std::chrono::milliseconds(starting ? 10 : 1000);
+}
+
+// Logs and records the time taken by each phase of the startup
+class StartupTimer
+{
+  public:
+    StartupTimer() : last_(NowUs()) {}
+    void Phase(const char *name, Gauge &gauge)
+    {
+      uint64_t now = NowUs();
+      gauge.Set(now - last_);
+      LOG(LOG_INFO, "startup %s=%" PRIu64 "us", name, now - last_);
+      last_ = now;
+    }
+  private:
+    uint64_t last_;
+};
+
 class OC
 {
   public:
@@ -80,7 +122,7 @@ class OC
           break;
         }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        std::this_thread::sleep_for(GetProcessPeriod());
       }
     }
     static OCStackApplicationResult RDDeleteCB(void *context, OCDoHandle handle, OCClientResponse *response)
@@ -118,6 +160,79 @@ class HanFun
     }
 };
 
+// Answers each connection to a local socket with the metrics in Prometheus text format
+class MetricsSocket
+{
+  public:
+    MetricsSocket() : fd_(-1) {}
+    bool Start(const char *path)
+    {
+      struct sockaddr_un addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sun_family = AF_UNIX;
+      if (strlen(path) >= sizeof(addr.sun_path))
+      {
+        fprintf(stderr, "%s - path too long\n", path);
+        return false;
+      }
+      strcpy(addr.sun_path, path);
+      unlink(path);
+      fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (fd_ < 0 || bind(fd_, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd_, 4) < 0)
+      {
+        perror(path);
+        return false;
+      }
+      path_ = path;
+      thread_ = std::thread(MetricsSocket::Process, fd_);
+      return true;
+    }
+    void Stop()
+    {
+      if (thread_.joinable())
+      {
+        thread_.join();
+      }
+      if (fd_ >= 0)
+      {
+        close(fd_);
+        unlink(path_.c_str());
+      }
+    }
+  private:
+    int fd_;
+    std::string path_;
+    std::thread thread_;
+    static void Process(int fd)
+    {
+      while (!kQuitFlag)
+      {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 1000) <= 0)
+        {
+          continue;
+        }
+        int client = accept(fd, NULL, NULL);
+        if (client < 0)
+        {
+          continue;
+        }
+        std::string out;
+        Metrics::WritePrometheus(out);
+        for (size_t n = 0; n < out.size(); )
+        {
+          ssize_t ret = send(client, out.data() + n, out.size() - n, MSG_NOSIGNAL);
+          if (ret <= 0)
+          {
+            break;
+          }
+          n += ret;
+        }
+        close(client);
+      }
+    }
+};
+
 // Callback for Ctrl+C (interrupt) signal
 //
 // @param sig
@@ -138,6 +253,16 @@ static void SigUsr1CB(int sig)
   kResetSecurityFlag = true;
 }
 
+// Callback for user defined signal. It is used to write the trace.
+//
+// @param sig
+//
+static void SigUsr2CB(int sig)
+{
+  UNUSED(sig);
+  kTraceFlag = true;
+}
+
 static std::string GetFilename(const char *uuid, const char *suffix)
 {
   std::string path = kPersistentStoragePrefix;
@@ -160,7 +285,47 @@ static std::string GetFilename(const char *uuid, const char *suffix)
 static FILE *PSOpenCB(const char *suffix, const char *mode)
 {
   std::string path = GetFilename(kUuid, suffix);
-  return fopen(path.c_str(), mode);
+  if (!kStore.IsOpen())
+  {
+    return fopen(path.c_str(), mode);
+  }
+  FILE *file = kStore.OpenStream(path, mode);
+  if (!file && (mode[0] == 'r'))
+  {
+    // Moves the file written before the store was used into it
+    std::string value;
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (!fp)
+    {
+      return NULL;
+    }
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+    {
+      value.append(buf, n);
+    }
+    fclose(fp);
+    if (kStore.Put(path, value.data(), value.size()))
+    {
+      remove(path.c_str());
+      file = kStore.OpenStream(path, mode);
+    }
+  }
+  return file;
+}
+
+// Callback for OCF persistent storage removal
+//
+// @param suffix
+//
+static int PSUnlinkCB(const char *suffix)
+{
+  if (!kStore.IsOpen())
+  {
+    return unlink(suffix);
+  }
+  return kStore.Remove(GetFilename(kUuid, suffix)) ? 0 : -1;
 }
 
 // Callback for Resource Directory discovery by Plugins
@@ -225,9 +390,11 @@ static OCStackApplicationResult DiscoverResourceDirectoryCB(void *context, OCDoH
 //
 static void ExecCB(const char *uuid, uint16_t sender, bool secure_mode, bool is_virtual)
 {
-  printf("exec --ps %s --uuid %s --sender %u --rd %s --secureMode %s %s\n", kPersistentStoragePrefix, uuid,
-          sender, OCGetServerInstanceIDString(), secure_mode ? "true" : "false",
-          is_virtual ? "--virtual" : "");
+  printf("exec --ps %s --uuid %s --sender %u --rd %s --secureMode %s %s %s %s %s %s %s\n", kPersistentStoragePrefix,
+          uuid, sender, OCGetServerInstanceIDString(), secure_mode ? "true" : "false",
+          is_virtual ? "--virtual" : "", kFastStart ? "--fast-start" : "", kStorePath ? "--store" : "",
+          kStorePath ? kStorePath : "", kTransportAddress ? "--transport" : "",
+          kTransportAddress ? kTransportAddress : "");
   fflush(stdout);
 }
 
@@ -274,13 +441,19 @@ static void DisconnectedCB()
 
 int main(int argc, char **argv)
 {
+  kStartUs = NowUs();
+  StartupTimer timer;
+  bool rd_database_pending = false;
+  time_t metrics_tick = 0;
   int ret = EXIT_FAILURE;
   Bridge *bridge = NULL;
   OC *oc = NULL;
   HanFun *hf = NULL;
+  Transport *transport = NULL;
+  MetricsSocket *metrics_socket = NULL;
   std::string db_filename;
   OCStackResult result;
-  OCPersistentStorage ps_handler = { PSOpenCB, fread, fwrite, fclose, unlink };
+  OCPersistentStorage ps_handler = { PSOpenCB, fread, fwrite, fclose, PSUnlinkCB };
   
   int protocols = 0;
   bool is_virtual = false;
@@ -314,6 +487,30 @@ int main(int argc, char **argv)
       {
         kResourceDirectoryDi = argv[++i];
       }
+      else if (!strcmp(argv[i], "--metrics") && (i < (argc - 1)))
+      {
+        kMetricsPath = argv[++i];
+      }
+      else if (!strcmp(argv[i], "--metrics-socket") && (i < (argc - 1)))
+      {
+        kMetricsSocketPath = argv[++i];
+      }
+      else if (!strcmp(argv[i], "--trace") && (i < (argc - 1)))
+      {
+        kTracePath = argv[++i];
+      }
+      else if (!strcmp(argv[i], "--store") && (i < (argc - 1)))
+      {
+        kStorePath = argv[++i];
+      }
+      else if (!strcmp(argv[i], "--transport") && (i < (argc - 1)))
+      {
+        kTransportAddress = argv[++i];
+      }
+      else if (!strcmp(argv[i], "--fast-start"))
+      {
+        kFastStart = true;
+      }
       else if (!strcmp(argv[i], "--virtual"))
       {
         is_virtual = true;
@@ -351,19 +548,39 @@ int main(int argc, char **argv)
 #ifdef SIGUSR1
   signal(SIGUSR1, SigUsr1CB);
 #endif
+  if (kTracePath)
+  {
+    Trace::Enable(true);
+#ifdef SIGUSR2
+    signal(SIGUSR2, SigUsr2CB);
+#endif
+  }
   
+  if (kStorePath && !kStore.Open(kStorePath))
+  {
+    fprintf(stderr, "PersistentStore::Open(%s) failed\n", kStorePath);
+    goto exit;
+  }
   result = OCRegisterPersistentStorageHandler(&ps_handler);
   if (result != OC_STACK_OK)
   {
     fprintf(stderr, "OCRegisterPersistentStorageHandler - %d\n", result);
     goto exit;
   }
+  timer.Phase("storage", Metrics::startup_storage_us);
   db_filename = GetFilename(NULL, "RD.db");
-  result = OCRDDatabaseSetStorageFilename(db_filename.c_str());
-  if (result != OC_STACK_OK)
+  // A plugin publishes to the Resource Directory of the main bridge, so a fast
+  // start leaves its database until the plugin is reachable
+  rd_database_pending = kFastStart && (kSenderAddress != 0);
+  if (!rd_database_pending)
   {
-    fprintf(stderr, "OCRDDatabaseSetStorageFilename - %d\n", result);
-    goto exit;
+    result = OCRDDatabaseSetStorageFilename(db_filename.c_str());
+    if (result != OC_STACK_OK)
+    {
+      fprintf(stderr, "OCRDDatabaseSetStorageFilename - %d\n", result);
+      goto exit;
+    }
+    timer.Phase("rd_database", Metrics::startup_rd_database_us);
   }
   result = OCInit1(OC_CLIENT_SERVER, OC_DEFAULT_FLAGS, OC_DEFAULT_FLAGS);
   if (result != OC_STACK_OK)
@@ -371,6 +588,7 @@ int main(int argc, char **argv)
     fprintf(stderr, "OCInit1 - %d\n", result);
     goto exit;
   }
+  timer.Phase("stack", Metrics::startup_stack_us);
   if (kSenderAddress != 0)
   {
     result = OCStopMulticastServer();
@@ -379,6 +597,7 @@ int main(int argc, char **argv)
       fprintf(stderr, "OCStopMulticastServer - %d\n", result);
       goto exit;
     }
+    timer.Phase("stop_multicast", Metrics::startup_stop_multicast_us);
     OCDoHandle handle;
     OCCallbackData callback_data;
     callback_data.cb = DiscoverResourceDirectoryCB;
@@ -409,6 +628,7 @@ int main(int argc, char **argv)
       goto exit;
     }
   }
+  timer.Phase("rd", Metrics::startup_rd_us);
   
   if (kUuid && (kSenderAddress != 0))
   {
@@ -423,10 +643,20 @@ int main(int argc, char **argv)
   bridge->SetDeviceName("HAN-FUN Bridge");
   bridge->SetManufacturerName("DEKRA Testing and Certification, S.A.U.");
   bridge->SetSecureMode(kSecureMode);
+  bridge->SetFastStart(kFastStart);
   if (!bridge->Start())
   {
     goto exit;
   }
+  if (kTransportAddress)
+  {
+    // The frames of the HAN-FUN devices keep them present between device table syncs
+    transport = new Transport();
+    transport->uid(new HF::UID::URI(std::string(kUidPrefix) + (kUuid ? kUuid : "bridge")));
+    bridge->SetTransport(transport);
+    transport->initialize(kTransportAddress);
+  }
+  timer.Phase("bridge", Metrics::startup_bridge_us);
   // Start OCF thread for processing
   oc = new OC();
   if (!oc->Start())
@@ -439,25 +669,80 @@ int main(int argc, char **argv)
   {
     goto exit;
   }
+  if (kMetricsSocketPath)
+  {
+    metrics_socket = new MetricsSocket();
+    if (!metrics_socket->Start(kMetricsSocketPath))
+    {
+      goto exit;
+    }
+  }
+  timer.Phase("threads", Metrics::startup_threads_us);
+  Metrics::startup_total_us.Set(NowUs() - kStartUs);
+  LOG(LOG_INFO, "startup total=%" PRId64 "us", Metrics::startup_total_us.Get());
   while (!kQuitFlag)
   {
+    if (rd_database_pending && (Metrics::startup_reachable_us.Get() != 0))
+    {
+      rd_database_pending = false;
+      StartupTimer rd_database_timer;
+      result = OCRDDatabaseSetStorageFilename(db_filename.c_str());
+      if (result != OC_STACK_OK)
+      {
+        fprintf(stderr, "OCRDDatabaseSetStorageFilename - %d\n", result);
+        goto exit;
+      }
+      rd_database_timer.Phase("rd_database", Metrics::startup_rd_database_us);
+    }
     if (kResetSecurityFlag)
     {
       kResetSecurityFlag = false;
       bridge->ResetSecurity();
     }
+    if (kTraceFlag)
+    {
+      kTraceFlag = false;
+      Trace::WriteChromeJsonFile(kTracePath);
+    }
     if (!bridge->Process())
     {
       goto exit;
     }
+    if (kMetricsPath && (time(NULL) != metrics_tick))
+    {
+      metrics_tick = time(NULL);
+      Metrics::WritePrometheusFile(kMetricsPath);
+    }
     
-    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    // Held notifications go out when their window closes, not on the next tick
+    std::chrono::steady_clock::time_point tick = std::chrono::steady_clock::now() + GetProcessPeriod();
+    while (!kQuitFlag && (std::chrono::steady_clock::now() < tick))
+    {
+      std::this_thread::sleep_for(std::min(GetProcessPeriod(),
+        std::chrono::milliseconds(Bridge::FLUSH_PERIOD_MS)));
+      bridge->Flush();
+    }
   }
     
   ret = EXIT_SUCCESS;
   
 exit:
   
+  if (kTracePath)
+  {
+    Trace::WriteChromeJsonFile(kTracePath);
+  }
+  if (metrics_socket)
+  {
+    kQuitFlag = true;
+    metrics_socket->Stop();
+    delete metrics_socket;
+  }
+  if (transport)
+  {
+    transport->destroy();
+    delete transport;
+  }
   if (bridge)
   {
     bridge->Stop();
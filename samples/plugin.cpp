@@ -21,15 +21,25 @@
 #include "plugin.h"
 
 #include "log.h"
+#include "metrics.h"
 
 #include "ocpayload.h"
 #include "experimental/ocrandom.h"
 #include "ocstack.h"
 #include "rd_client.h"
+#include <chrono>
 #include <map>
+#include <string.h>
 #include <vector>
 
 std::string kResourceDirectory;
+uint64_t kStartUs = 0;
+
+uint64_t NowUs()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 static OCStackApplicationResult RDPublishCB(void *context,
                                             OCDoHandle handle,
@@ -39,10 +49,44 @@ static OCStackApplicationResult RDPublishCB(void *context,
   UNUSED(handle);
 
   int severity = (response && (response->result <= OC_STACK_RESOURCE_CHANGED)) ? LOG_DEBUG : LOG_ERR;
+  if (severity == LOG_ERR)
+  {
+    Metrics::rd_publish_errors.Add();
+  }
+  else if (kStartUs && (Metrics::startup_reachable_us.Get() == 0))
+  {
+    Metrics::startup_reachable_us.Set(NowUs() - kStartUs);
+    LOG(LOG_INFO, "startup reachable=%" PRId64 "us", Metrics::startup_reachable_us.Get());
+  }
   LOG(severity, "response=%p,response->result=%d", response, response ? response->result : 0);
   return OC_STACK_DELETE_TRANSACTION;
 }
 
+// The bytes of the strings that make up the link of a resource in the publication.
+static size_t GetLinkSize(OCResourceHandle handle)
+{
+  const char *uri = OCGetResourceUri(handle);
+  size_t size = uri ? strlen(uri) : 0;
+  uint8_t n;
+  if (OCGetNumberOfResourceTypes(handle, &n) == OC_STACK_OK)
+  {
+    for (uint8_t i = 0; i < n; ++i)
+    {
+      const char *name = OCGetResourceTypeName(handle, i);
+      size += name ? strlen(name) : 0;
+    }
+  }
+  if (OCGetNumberOfResourceInterfaces(handle, &n) == OC_STACK_OK)
+  {
+    for (uint8_t i = 0; i < n; ++i)
+    {
+      const char *name = OCGetResourceInterfaceName(handle, i);
+      size += name ? strlen(name) : 0;
+    }
+  }
+  return size;
+}
+
 OCStackResult RDPublish()
 {
   uint8_t number_of_resources;
@@ -53,12 +97,14 @@ OCStackResult RDPublish()
   }
 
   std::vector<OCResourceHandle> handles;
+  size_t bytes = 0;
   for (uint8_t i = 0; i < number_of_resources; ++i)
   {
     OCResourceHandle handle = OCGetResourceHandle(i);
     if (OCGetResourceProperties(handle) & OC_DISCOVERABLE)
     {
       handles.push_back(handle);
+      bytes += GetLinkSize(handle);
     }
   }
 
@@ -66,7 +112,10 @@ OCStackResult RDPublish()
   callback_data.cb = RDPublishCB;
   callback_data.context = NULL;
   callback_data.cd = NULL;
-  return OCRDPublish(NULL,
+  Metrics::rd_publish.Add();
+  Metrics::rd_publish_resources.Add(handles.size());
+  Metrics::rd_publish_bytes.Add(bytes);
+  result = OCRDPublish(NULL,
                      kResourceDirectory.c_str(),
                      CT_DEFAULT, // default connectivity type
                      &handles[0],
@@ -74,4 +123,9 @@ OCStackResult RDPublish()
                      OIC_RD_PUBLISH_TTL, // publish TTL
                      &callback_data,
                      OC_HIGH_QOS); // High QoS
+  if (result != OC_STACK_OK)
+  {
+    Metrics::rd_publish_errors.Add();
+  }
+  return result;
 }
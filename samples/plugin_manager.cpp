@@ -22,16 +22,40 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#include <chrono>
+#include <dirent.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <map>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <string>
 #include <sys/wait.h>
 #include <unistd.h>
 #include "experimental/ocrandom.h"
 
 static volatile sig_atomic_t sQuitFlag = false;
+static const char *sStatsPath = NULL;
+static unsigned sStatsSecs = 5;
+
+struct ProcStats
+{
+    long rssKb;
+    long threads;
+    long fds;
+    long sockets;
+    uint64_t cpuTicks;
+    double cpuPct;
+};
+
+struct Plugin
+{
+    pid_t pid;
+    ProcStats stats;
+    bool sampled;
+};
 
 static void SigIntCB(int sig)
 {
@@ -46,14 +70,196 @@ static void SigChldCB(int sig)
         ;
 }
 
+static uint64_t NowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Reads the resources used by a process from /proc; returns false once it has exited
+static bool ReadProcStats(pid_t pid, ProcStats &stats)
+{
+    char path[64];
+    char line[256];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int) pid);
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+    {
+        return false;
+    }
+    unsigned long utime = 0, stime = 0;
+    char state = 0;
+    if (fgets(line, sizeof(line), fp))
+    {
+        // The command name may hold spaces, so the fields are counted from its closing ')'
+        char *p = strrchr(line, ')');
+        if (p)
+        {
+            sscanf(p + 2, "%c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &state, &utime,
+                    &stime);
+        }
+    }
+    fclose(fp);
+    if (state == 0 || state == 'Z')
+    {
+        return false;
+    }
+    stats.cpuTicks = utime + stime;
+
+    stats.rssKb = 0;
+    stats.threads = 0;
+    snprintf(path, sizeof(path), "/proc/%d/status", (int) pid);
+    fp = fopen(path, "r");
+    if (!fp)
+    {
+        return false;
+    }
+    while (fgets(line, sizeof(line), fp))
+    {
+        sscanf(line, "VmRSS: %ld", &stats.rssKb);
+        sscanf(line, "Threads: %ld", &stats.threads);
+    }
+    fclose(fp);
+
+    stats.fds = 0;
+    stats.sockets = 0;
+    snprintf(path, sizeof(path), "/proc/%d/fd", (int) pid);
+    DIR *dir = opendir(path);
+    if (!dir)
+    {
+        return false;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (entry->d_name[0] == '.')
+        {
+            continue;
+        }
+        ++stats.fds;
+        std::string fdPath = std::string(path) + "/" + entry->d_name;
+        ssize_t n = readlink(fdPath.c_str(), line, sizeof(line) - 1);
+        if ((n > 0) && !strncmp(line, "socket:", strlen("socket:")))
+        {
+            ++stats.sockets;
+        }
+    }
+    closedir(dir);
+    return true;
+}
+
+static void Sample(Plugin &plugin, double secs)
+{
+    static const long hz = sysconf(_SC_CLK_TCK);
+    ProcStats stats;
+    if (!ReadProcStats(plugin.pid, stats))
+    {
+        plugin.pid = 0;
+        return;
+    }
+    stats.cpuPct = plugin.sampled ? 100.0 * (stats.cpuTicks - plugin.stats.cpuTicks) / (hz * secs) : 0;
+    plugin.stats = stats;
+    plugin.sampled = true;
+}
+
+static void WriteProcStats(FILE *fp, const ProcStats &stats)
+{
+    fprintf(fp, " rss_kb=%ld threads=%ld fds=%ld sockets=%ld cpu_pct=%.1f\n", stats.rssKb,
+            stats.threads, stats.fds, stats.sockets, stats.cpuPct);
+}
+
+// Samples the bridge and every plugin, then replaces the stats file with
+//   total plugins=N rss_kb=... threads=... fds=... sockets=... cpu_pct=...
+//   bridge pid=PID rss_kb=... ...
+//   plugin uuid=UUID pid=PID rss_kb=... ...
+// where the total is the sum over the plugins.
+static void WriteStats(Plugin &bridge, std::map<std::string, Plugin> &plugins, double secs)
+{
+    Sample(bridge, secs);
+    ProcStats total = { 0, 0, 0, 0, 0, 0 };
+    size_t n = 0;
+    std::map<std::string, Plugin>::iterator it = plugins.begin();
+    while (it != plugins.end())
+    {
+        Sample(it->second, secs);
+        if (it->second.pid == 0)
+        {
+            it = plugins.erase(it);
+            continue;
+        }
+        const ProcStats &stats = it->second.stats;
+        total.rssKb += stats.rssKb;
+        total.threads += stats.threads;
+        total.fds += stats.fds;
+        total.sockets += stats.sockets;
+        total.cpuPct += stats.cpuPct;
+        ++n;
+        ++it;
+    }
+
+    std::string tmp = std::string(sStatsPath) + ".tmp";
+    FILE *fp = fopen(tmp.c_str(), "w");
+    if (!fp)
+    {
+        perror(tmp.c_str());
+        return;
+    }
+    fprintf(fp, "total plugins=%zu", n);
+    WriteProcStats(fp, total);
+    if (bridge.pid)
+    {
+        fprintf(fp, "bridge pid=%d", (int) bridge.pid);
+        WriteProcStats(fp, bridge.stats);
+    }
+    for (it = plugins.begin(); it != plugins.end(); ++it)
+    {
+        fprintf(fp, "plugin uuid=%s pid=%d", it->first.c_str(), (int) it->second.pid);
+        WriteProcStats(fp, it->second.stats);
+    }
+    fclose(fp);
+    if (rename(tmp.c_str(), sStatsPath) < 0)
+    {
+        perror(sStatsPath);
+    }
+}
+
+static void Usage(const char *name)
+{
+    printf("Usage: %s [--stats FILE] [--interval SECS] BRIDGE [ARGS]...\n", name);
+    printf("  --stats FILE       write the resources used by the bridge and its plugins to FILE\n");
+    printf("  --interval SECS    seconds between samples of the stats (default %u)\n", sStatsSecs);
+}
+
 int main(int argc, char **argv)
 {
-    if (argc < 2)
+    int first = 1;
+    for (; (first < argc) && !strncmp(argv[first], "--", 2); ++first)
     {
+        if (!strcmp(argv[first], "--stats") && (first < (argc - 1)))
+        {
+            sStatsPath = argv[++first];
+        }
+        else if (!strcmp(argv[first], "--interval") && (first < (argc - 1)))
+        {
+            sStatsSecs = strtoul(argv[++first], NULL, 10);
+            if (sStatsSecs == 0)
+            {
+                sStatsSecs = 1;
+            }
+        }
+        else
+        {
+            Usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (first >= argc)
+    {
+        Usage(argv[0]);
         return EXIT_FAILURE;
     }
-    char *path = argv[1];
-    char *name = basename(strdup(argv[1]));
+    char *path = argv[first];
+    char *name = basename(strdup(argv[first]));
 
     signal(SIGINT, SigIntCB);
     signal(SIGCHLD, SigChldCB);
@@ -80,26 +286,44 @@ int main(int argc, char **argv)
         }
         close(pipefd[1]);
         close(pipefd[0]);
-        char *args[argc + 1];
+        char *args[argc - first + 2];
         args[0] = path;
         args[1] = name;
-        for (int i = 2; i < argc; ++i)
+        for (int i = first + 1; i < argc; ++i)
         {
-            args[i] = argv[i];
+            args[i - first + 1] = argv[i];
         }
-        args[argc] = NULL;
+        args[argc - first + 1] = NULL;
         execv(path, args);
         perror("execl");
         return EXIT_FAILURE;
     }
     close(pipefd[1]);
 
-    std::map<std::string, pid_t> pids;
+    Plugin bridge = { pid, ProcStats(), false };
+    std::map<std::string, Plugin> pids;
+    uint64_t sampledMs = NowMs();
+    uint64_t nextSampleMs = sampledMs;
     char line[512];
     char *lp = line;
     char c;
     while (!sQuitFlag)
     {
+        if (sStatsPath)
+        {
+            uint64_t nowMs = NowMs();
+            if (nowMs >= nextSampleMs)
+            {
+                WriteStats(bridge, pids, (nowMs - sampledMs) / 1000.0);
+                sampledMs = nowMs;
+                nextSampleMs = nowMs + sStatsSecs * 1000;
+            }
+            struct pollfd pfd = { pipefd[0], POLLIN, 0 };
+            if (poll(&pfd, 1, nextSampleMs - nowMs) <= 0)
+            {
+                continue;
+            }
+        }
         ssize_t n = read(pipefd[0], &c, 1);
         if (n < 0)
         {
@@ -119,13 +343,13 @@ int main(int argc, char **argv)
 
             if (!strncmp(line, "exec", strlen("exec")))
             {
-                char *args[13] = { 0 };
+                char *args[17] = { 0 };
                 args[0] = path;
                 args[1] = name;
-                sscanf(line, "exec %ms %ms %ms %ms %ms %ms %ms %ms %ms %ms", &args[2], &args[3],
-                        &args[4], &args[5], &args[6], &args[7], &args[8], &args[9], &args[10],
-                        &args[11]);
-                args[12] = NULL;
+                sscanf(line, "exec %ms %ms %ms %ms %ms %ms %ms %ms %ms %ms %ms %ms %ms %ms", &args[2],
+                        &args[3], &args[4], &args[5], &args[6], &args[7], &args[8], &args[9], &args[10],
+                        &args[11], &args[12], &args[13], &args[14], &args[15]);
+                args[16] = NULL;
                 pid_t pid = fork();
                 if (pid < 0)
                 {
@@ -141,9 +365,10 @@ int main(int argc, char **argv)
                 else
                 {
                     char *uuid = args[5];
-                    pids[uuid] = pid;
+                    Plugin plugin = { pid, ProcStats(), false };
+                    pids[uuid] = plugin;
                 }
-                for (int i = 2; i < 11; ++i)
+                for (int i = 2; i < 16; ++i)
                 {
                     if (args[i])
                     {
@@ -155,10 +380,10 @@ int main(int argc, char **argv)
             {
                 char uuid[UUID_STRING_SIZE];
                 sscanf(line, "kill --uuid %s", uuid);
-                std::map<std::string, pid_t>::iterator it = pids.find(uuid);
+                std::map<std::string, Plugin>::iterator it = pids.find(uuid);
                 if (it != pids.end())
                 {
-                    if (kill(it->second, SIGINT) < 0)
+                    if (kill(it->second.pid, SIGINT) < 0)
                     {
                         perror("kill");
                     }
@@ -0,0 +1,110 @@
+#!/bin/bash
+#
+# Measures how fast the bridge onboards OCF devices. A farm of N devices is
+# started on this host next to a bridge running with --oc, for each N in
+# COUNTS. Each run reports the devices onboarded per second, the p50 and p99
+# time from a device starting to the bridge onboarding it, and the CPU time
+# and peak RSS of the bridge.
+#
+# Usage: scripts/bench/discovery_throughput.sh [BIN_DIR]
+#
+#   BIN_DIR    directory holding HanFunBridge and OCFFarm
+#              (default out/linux/x86_64/release/bin)
+#   COUNTS     device counts to run (default "10 100 1000")
+#   TIMEOUT    seconds to wait for a run to onboard every device (default 120)
+#   FARM_ARGS  extra OCFFarm options, e.g. "--resources 8 --collection --latency 20"
+#
+# Each device prints "started di=<di> t=<ms>" and the bridge logs
+# "onboarded di=<di> t=<ms>" at INFO level; both are steady clock times, so
+# they can be compared across the processes.
+
+BIN_DIR=$(readlink -f "${1:-out/linux/x86_64/release/bin}")
+COUNTS=${COUNTS:-"10 100 1000"}
+TIMEOUT=${TIMEOUT:-120}
+HZ=$(getconf CLK_TCK)
+
+for bin in HanFunBridge OCFFarm; do
+  if [ ! -x "$BIN_DIR/$bin" ]; then
+    echo "$BIN_DIR/$bin not found" >&2
+    exit 1
+  fi
+done
+
+# utime + stime, in clock ticks
+cpu_ticks() {
+  awk '{ print $14 + $15 }' /proc/$1/stat
+}
+
+# peak resident set size, in kB
+peak_rss() {
+  awk '$1 == "VmHWM:" { print $2 }' /proc/$1/status
+}
+
+onboarded() {
+  grep -c " onboarded di=" bridge.log
+}
+
+report() {
+  awk -v devices=$1 -v cpu=$2 -v wall=$3 -v rss=$4 '
+    {
+      di = ""; t = ""
+      for (i = 1; i <= NF; ++i)
+      {
+        if ($i ~ /^di=/) di = substr($i, 4)
+        else if ($i ~ /^t=/) t = substr($i, 3) + 0
+      }
+      if (di == "" || t == "") next
+      if ($1 == "started")
+      {
+        started[di] = t
+        if (first == "" || t < first) first = t
+      }
+      else if ($0 ~ / onboarded di=/)
+      {
+        onboarded[di] = t
+      }
+    }
+    END {
+      m = 0; last = first
+      for (di in onboarded)
+      {
+        if (!(di in started)) continue
+        d[++m] = onboarded[di] - started[di]
+        if (onboarded[di] > last) last = onboarded[di]
+      }
+      for (i = 2; i <= m; ++i)
+      {
+        v = d[i]
+        for (j = i - 1; j >= 1 && d[j] > v; --j) d[j + 1] = d[j]
+        d[j + 1] = v
+      }
+      p50 = m ? d[int((m - 1) * 0.50) + 1] : 0
+      p99 = m ? d[int((m - 1) * 0.99) + 1] : 0
+      rate = (last > first) ? m * 1000 / (last - first) : 0
+      printf "%8d %10d %10.1f %10d %10d %8.2f %6.1f%% %10d\n", devices, m, rate, p50, p99, cpu, 100 * cpu / wall, rss
+    }' farm.log bridge.log
+}
+
+printf "%8s %10s %10s %10s %10s %8s %7s %10s\n" devices onboarded devices/s p50_ms p99_ms cpu_s cpu rss_kb
+for n in $COUNTS; do
+  dir=$(mktemp -d)
+  pushd "$dir" > /dev/null
+  "$BIN_DIR/HanFunBridge" --oc > bridge.log 2>&1 &
+  bridge=$!
+  sleep 1
+  ticks=$(cpu_ticks $bridge)
+  begin=$SECONDS
+  "$BIN_DIR/OCFFarm" --devices $n $FARM_ARGS > farm.log 2> farm.err &
+  farm=$!
+  while [ $((SECONDS - begin)) -lt $TIMEOUT ] && [ $(onboarded) -lt $n ]; do
+    sleep 1
+  done
+  ticks=$(($(cpu_ticks $bridge) - ticks))
+  wall=$((SECONDS - begin))
+  rss=$(peak_rss $bridge)
+  kill -INT $farm $bridge
+  wait
+  report $n $(awk -v t=$ticks -v hz=$HZ 'BEGIN { print t / hz }') $((wall > 0 ? wall : 1)) $rss
+  popd > /dev/null
+  rm -rf "$dir"
+done
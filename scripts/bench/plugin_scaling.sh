@@ -0,0 +1,85 @@
+#!/bin/bash
+#
+# Measures what the plugin processes of the bridge cost as the HAN-FUN network
+# grows. A HanSimulator base with N devices is started next to PluginManager
+# running the bridge with --hf, for each N in COUNTS. Each run waits for a
+# plugin per device, lets them settle, and reports the plugins started, the
+# seconds it took, and the total and per-plugin RSS, threads, file
+# descriptors, sockets and CPU of the plugins, along with the RSS of the main
+# bridge. The result is the capacity curve of the host.
+#
+# Usage: scripts/bench/plugin_scaling.sh [BIN_DIR]
+#
+#   BIN_DIR    directory holding HanFunBridge, PluginManager and HanSimulator
+#              (default out/linux/x86_64/release/bin)
+#   COUNTS     device counts to run (default "1 10 50 100")
+#   TIMEOUT    seconds to wait for a run to start every plugin (default 120)
+#   SETTLE     seconds to sample the plugins after they all started (default 10)
+#
+# PluginManager --stats writes lines of the form
+#   total plugins=N rss_kb=... threads=... fds=... sockets=... cpu_pct=...
+#   bridge pid=PID rss_kb=... ...
+
+BIN_DIR=$(readlink -f "${1:-out/linux/x86_64/release/bin}")
+COUNTS=${COUNTS:-"1 10 50 100"}
+TIMEOUT=${TIMEOUT:-120}
+SETTLE=${SETTLE:-10}
+
+for bin in HanFunBridge PluginManager HanSimulator; do
+  if [ ! -x "$BIN_DIR/$bin" ]; then
+    echo "$BIN_DIR/$bin not found" >&2
+    exit 1
+  fi
+done
+
+# value of key on the line starting with kind in stats.txt
+field() {
+  awk -v kind=$1 -v key=$2 '
+    $1 == kind {
+      for (i = 2; i <= NF; ++i)
+      {
+        if (index($i, key "=") == 1) print substr($i, length(key) + 2)
+      }
+    }' stats.txt 2> /dev/null
+}
+
+plugins() {
+  local n=$(field total plugins)
+  echo ${n:-0}
+}
+
+printf "%8s %8s %8s %10s %10s %8s %8s %8s %8s %10s\n" devices plugins spawn_s rss_mb \
+  rss_kb/plg threads fds sockets cpu bridge_kb
+for n in $COUNTS; do
+  dir=$(mktemp -d)
+  pushd "$dir" > /dev/null
+  "$BIN_DIR/HanSimulator" --devices $n > simulator.log 2>&1 &
+  simulator=$!
+  sleep 1
+  begin=$SECONDS
+  # PluginManager does not stop the plugins when it is interrupted, so it is
+  # given a process group of its own to be stopped with them
+  setsid "$BIN_DIR/PluginManager" --stats stats.txt --interval 1 "$BIN_DIR/HanFunBridge" --hf \
+    > manager.log 2>&1 &
+  manager=$!
+  while [ $((SECONDS - begin)) -lt $TIMEOUT ] && [ $(plugins) -lt $n ]; do
+    sleep 1
+  done
+  spawn=$((SECONDS - begin))
+  sleep $SETTLE
+  m=$(plugins)
+  rss=$(field total rss_kb)
+  sockets=$(field total sockets)
+  awk -v devices=$n -v plugins=$m -v spawn=$spawn -v rss=${rss:-0} -v threads=$(field total threads) \
+    -v fds=$(field total fds) -v sockets=${sockets:-0} -v cpu=$(field total cpu_pct) \
+    -v bridge=$(field bridge rss_kb) 'BEGIN {
+      per = plugins ? rss / plugins : 0
+      printf "%8d %8d %8d %10.1f %10.0f %8d %8d %8d %7.1f%% %10d\n", devices, plugins, spawn,
+        rss / 1024, per, threads, fds, sockets, cpu, bridge
+    }'
+  kill -INT -- -$manager
+  kill -INT $simulator
+  wait
+  popd > /dev/null
+  rm -rf "$dir"
+done
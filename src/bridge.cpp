@@ -2,9 +2,13 @@
 
 #include "device_configuration_resource.h"
 #include "device_information.h"
+#include "discovery_schedule.h"
+#include "han_event.h"
 #include "interfaces.h"
 #include "introspection.h"
 #include "log.h"
+#include "metrics.h"
+#include "metrics_resource.h"
 #include "platform_configuration_resource.h"
 #include "plugin.h"
 #include "presence.h"
@@ -12,6 +16,8 @@
 #include "resource.h"
 #include "secure_mode_resource.h"
 #include "security.h"
+#include "trace.h"
+#include "transport.h"
 #include "virtual_ocf_device.h"
 #include "virtual_resource.h"
 
@@ -28,28 +34,47 @@
 #define SECURE_MODE_DEFAULT false
 #endif
 
+const uint32_t Bridge::FLUSH_PERIOD_MS;
+
+static uint64_t NowMs()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 struct Bridge::DiscoverContext
 {
   Bridge *bridge;
+  OCDevAddr origin;
   Device device;
   OCRepPayload *paths;
   OCRepPayload *definitions;
   std::vector<Resource>::iterator rit;
-  DiscoverContext(Bridge *bridge, OCDevAddr origin, OCDiscoveryPayload *payload)
-    : bridge(bridge), device(origin, payload), paths(NULL), definitions(NULL) {}
+  uint64_t started_ms;
+  uint64_t digest;
+  DiscoverContext(Bridge *bridge, OCDevAddr origin, OCDiscoveryPayload *payload, uint64_t digest)
+    : bridge(bridge), origin(origin), device(origin, payload), paths(NULL), definitions(NULL),
+      started_ms(NowMs()), digest(digest)
+  {
+    Metrics::discovery_sessions.Add(1);
+    TRACE_BEGIN("onboard", device.di_.c_str(), origin.addr);
+  }
   ~DiscoverContext()
   {
+    TRACE_END("onboard", device.di_.c_str(), NULL);
+    Metrics::discovery_sessions.Add(-1);
     OCRepPayloadDestroy(paths);
     OCRepPayloadDestroy(definitions);
   }
-  std::vector<OCDevAddr> GetDevAddrs(const char *uri)
+  const std::vector<OCDevAddr> &GetDevAddrs(const char *uri)
   {
+    static const std::vector<OCDevAddr> none;
     Resource *resource = device.GetResourceUri(uri);
     if (resource)
     {
-      return resource->addrs_;
+      return resource->addrs();
     }
-    return std::vector<OCDevAddr>();
+    return none;
   }
   
   // Each iteration returns a translatable resource and resource type pair.
@@ -57,7 +82,7 @@ struct Bridge::DiscoverContext
   {
     DiscoverContext *context;
     std::vector<Resource>::iterator resource_it;
-    std::vector<std::string>::iterator resource_type_it;
+    std::vector<Symbol>::iterator resource_type_it;
     
     Iterator() {}
     Iterator(DiscoverContext *context, bool is_begin = true) : context(context)
@@ -86,7 +111,7 @@ struct Bridge::DiscoverContext
           resource_type_it = resource_it->rts_.begin();
           while (resource_type_it != resource_it->rts_.end())
           {
-            if (TranslateResourceType(resource_type_it->c_str()))
+            if (TranslateResourceType(Symbols::Name(*resource_type_it)))
             {
               return;
             }
@@ -102,13 +127,14 @@ struct Bridge::DiscoverContext
       std::string uri = resource_it->uri_;
       if (resource_it->rts_.size() > 1)
       {
-        uri += "?rt=" + *resource_type_it;
+        uri += "?rt=";
+        uri += Symbols::Name(*resource_type_it);
       }
       return uri;
     }
-    std::vector<OCDevAddr> GetDevAddrs()
+    const std::vector<OCDevAddr> &GetDevAddrs()
     {
-      return resource_it->addrs_;
+      return resource_it->addrs();
     }
     Resource& GetResource()
     {
@@ -116,7 +142,7 @@ struct Bridge::DiscoverContext
     }
     std::string GetResourceType()
     {
-      return *resource_type_it;
+      return Symbols::Name(*resource_type_it);
     }
     Iterator& operator++()
     {
@@ -135,25 +161,36 @@ struct Bridge::DiscoverContext
 
 Bridge::Bridge(const std::string &base_uri, Protocol protocols)
   : exec_cb_(NULL), disconnected_cb_(NULL), protocols_(protocols), sender_(0),
-    discover_handle_(NULL), discover_next_tick_(0), secure_mode_(NULL),
-    rd_publish_task_(NULL), pending_(0), get_devices_next_tick_(0)
+    discover_handle_(NULL), secure_mode_(NULL),
+    rd_publish_task_(NULL), pending_(0), get_devices_next_tick_(0), device_table_started_ms_(0),
+    next_page_index_(0), fast_start_(false)
 {
   han_client_ = new HanClient("127.0.0.1", 3490, uv_default_loop());
+  han_events_ = new HanEventQueue();
   han_state_ = CREATED;
   oc_security_ = new OCSecurity();
-  secure_mode_ = new SecureModeResource(mutex_, SECURE_MODE_DEFAULT);
-  registration_ = new RegistrationResource(mutex_, *han_client_);
+  discovery_schedule_ = new DiscoverySchedule();
+  presence_ = new PresenceTable();
+  hf_presence_ = new PresenceTable();
+  secure_mode_ = new SecureModeResource(SECURE_MODE_DEFAULT);
+  registration_ = new RegistrationResource(hf_mutex_, *han_client_);
+  metrics_ = new MetricsResource();
 }
 
 Bridge::Bridge(const std::string &base_uri, uint16_t sender)
   : exec_cb_(NULL), disconnected_cb_(NULL), protocols_(HF), sender_(sender),
-    discover_handle_(NULL), discover_next_tick_(0), secure_mode_(NULL),
-    rd_publish_task_(NULL), pending_(0), get_devices_next_tick_(0)
+    discover_handle_(NULL), secure_mode_(NULL), registration_(NULL), metrics_(NULL),
+    rd_publish_task_(NULL), pending_(0), get_devices_next_tick_(0), device_table_started_ms_(0),
+    next_page_index_(0), fast_start_(false)
 {
   han_client_ = new HanClient("127.0.0.1", 3490, uv_default_loop());
+  han_events_ = new HanEventQueue();
   han_state_ = CREATED;
   oc_security_ = new OCSecurity();
-  secure_mode_ = new SecureModeResource(mutex_, SECURE_MODE_DEFAULT);
+  discovery_schedule_ = new DiscoverySchedule();
+  presence_ = new PresenceTable();
+  hf_presence_ = new PresenceTable();
+  secure_mode_ = new SecureModeResource(SECURE_MODE_DEFAULT);
 }
 
 Bridge::~Bridge()
@@ -165,11 +202,14 @@ Bridge::~Bridge()
   {
     cond_.wait(lock);
   }
-  for (Presence *presence : presence_)
+  for (auto &observe : observe_handles_)
   {
-    delete presence;
+    Cancel(observe.second, OC_LOW_QOS, NULL, 0);
   }
-  presence_.clear();
+  observe_handles_.clear();
+  delete discovery_schedule_;
+  delete presence_;
+  delete hf_presence_;
   for (auto &dc : discovered_)
   {
     DiscoverContext *discoverContext = dc.second;
@@ -188,9 +228,11 @@ Bridge::~Bridge()
   virtual_ocf_devices_.clear();
   
   delete oc_security_;
+  delete metrics_;
 
   han_client_->stop();
   delete han_client_;
+  delete han_events_;
 }
 
 void Bridge::SetSecureMode(bool secure_mode)
@@ -215,20 +257,9 @@ void Bridge::Destroy(const char *id)
       ++dc;
     }
   }
-  std::vector<Presence *>::iterator p = presence_.begin();
-  while (p != presence_.end())
-  {
-    Presence *presence = *p;
-    if (presence->GetId() == id)
-    {
-      delete presence;
-      p = presence_.erase(p);
-    }
-    else
-    {
-      ++p;
-    }
-  }
+  presence_->Remove(id);
+  digests_.erase(id);
+  CancelObserveDiscovery(id);
 }
 
 /* Called with mutex_ held. */
@@ -264,6 +295,46 @@ void Bridge::Destroy(uint16_t id)
   }
 }
 
+void Bridge::SetTransport(Transport *transport)
+{
+  transport->set_activity_cb(Bridge::ActivityCB, this);
+}
+
+// Runs on the libuv thread, like GetDeviceTableCB(), so it is the same single
+// producer for han_events_
+void Bridge::ActivityCB(uint16_t address, void *context)
+{
+  Bridge *thiz = reinterpret_cast<Bridge *>(context);
+  HanEvent event;
+  memset(&event, 0, sizeof(event));
+  event.type = HanEvent::ACTIVITY;
+  event.dev_index = address;
+  if (!thiz->han_events_->Push(event))
+  {
+    LOG(LOG_DEBUG, "[%p] HAN-FUN event queue full, activity of %d dropped", thiz, address);
+  }
+}
+
+// Called with mutex_ held.
+void Bridge::Activity(const HanEvent &event)
+{
+  static_assert(HFPresence::MIN_TIMEOUT_SECS > HF_DISCOVER_PERIOD_SECS,
+    "a device seen only by the device table syncs must outlive a sync period");
+  hf_presence_->Seen(std::to_string(event.dev_index), time(NULL));
+}
+
+/* Called with mutex_ held. */
+void Bridge::Disconnected(uint16_t address)
+{
+  hf_presence_->Remove(std::to_string(address));
+  Destroy(address);
+  ScheduleRDPublish();
+  if (disconnected_cb_)
+  {
+    disconnected_cb_();
+  }
+}
+
 bool Bridge::Start()
 {
   std::lock_guard<std::mutex> lock(mutex_);
@@ -312,7 +383,7 @@ bool Bridge::Start()
       LOG(LOG_ERR, "OCGetResourceHandleAtUri(" OC_RSRVD_DEVICE_URI ") failed");
       return false;
     }
-    result = OCBindResourceTypeToResource(handle, "oic.d.bridge");
+    result = BindResourceType(handle, "oic.d.bridge");
     if (result != OC_STACK_OK)
     {
       LOG(LOG_ERR, "OCBindResourceTypeToResource() - %d", result);
@@ -336,7 +407,21 @@ bool Bridge::Start()
       LOG(LOG_ERR, "RegistrationResource::Create() - %d", result);
       return false;
     }
-    SetIntrospectionData(/* HF Info */"TITLE", "VERSION");
+    result = metrics_->Create();
+    if (result != OC_STACK_OK)
+    {
+      LOG(LOG_ERR, "MetricsResource::Create() - %d", result);
+      return false;
+    }
+    if (fast_start_)
+    {
+      // Written by the first Process(), once the main loop is running
+      tasks_.push_back(new IntrospectionTask(time(NULL)));
+    }
+    else
+    {
+      SetIntrospectionData(/* HF Info */"TITLE", "VERSION");
+    }
   }
   LOG(LOG_INFO, "di=%s", OCGetServerInstanceIDString());
   
@@ -369,6 +454,15 @@ bool Bridge::Stop()
     }
     discover_handle_ = NULL;
   }
+  for (auto &observe : observe_handles_)
+  {
+    OCStackResult result = Cancel(observe.second, OC_LOW_QOS, NULL, 0);
+    if (result != OC_STACK_OK)
+    {
+      LOG(LOG_ERR, "Cancel() - %d", result);
+    }
+  }
+  observe_handles_.clear();
   return true;
 }
 
@@ -384,9 +478,11 @@ void Bridge::ResetSecurity()
 
 bool Bridge::Process()
 {
-  std::lock_guard<std::mutex> lock(mutex_);
+  std::unique_lock<std::mutex> lock(mutex_);
   if (protocols_ & HF)
   {
+    ProcessHanEvents(lock);
+    std::unique_lock<std::mutex> hf_lock(hf_mutex_);
     switch (han_state_)
     {
       case CREATED:
@@ -402,6 +498,7 @@ bool Bridge::Process()
           if (sender_ == 0)
           {
             han_client_->get_device_table(0, 5, this);
+            device_table_started_ms_ = NowMs();
           }
           else
           {
@@ -412,14 +509,37 @@ bool Bridge::Process()
         }
         break;
       case RUNNING:
-        /* Do nothing */
+        if ((sender_ != 0) && (time(NULL) >= get_devices_next_tick_))
+        {
+          // Check that the device is still registered
+          han_client_->get_device_table(sender_ - 1, 1, this);
+          get_devices_next_tick_ = time(NULL) + HF_DISCOVER_PERIOD_SECS;
+        }
         break;
     }
+    hf_lock.unlock();
+    std::vector<std::string> lapsed;
+    hf_presence_->Expire(time(NULL), lapsed);
+    for (std::string &id : lapsed)
+    {
+      LOG(LOG_DEBUG, "[%p] %s absent", this, id.c_str());
+      Disconnected(std::stoi(id));
+    }
   }
   if (protocols_ & OC)
   {
-    if (time(NULL) >= discover_next_tick_)
+    if (discovery_schedule_->IsDue(time(NULL)))
     {
+      // Presence of OCF devices is counted in discovery rounds
+      time_t round = discovery_schedule_->Start(time(NULL));
+      std::vector<std::string> absent;
+      presence_->Expire(round, absent);
+      for (std::string &id : absent)
+      {
+        LOG(LOG_DEBUG, "[%p] %s absent", this, id.c_str());
+        Destroy(id.c_str());
+        discovery_schedule_->Changed(time(NULL));
+      }
       if (discover_handle_)
       {
         OCStackResult result = Cancel(discover_handle_, OC_LOW_QOS, NULL, 0);
@@ -438,29 +558,28 @@ bool Bridge::Process()
       uint16_t format = COAP_MEDIATYPE_APPLICATION_VND_OCF_CBOR; // TODO retry with CBOR
       OCSetHeaderOption(options, &numOptions, CA_OPTION_ACCEPT, &format, sizeof(format));
       ::DoResource(&discover_handle_, OC_REST_DISCOVER, OC_RSRVD_WELL_KNOWN_URI, NULL, 0, &cbData, options, numOptions);
-      discover_next_tick_ = time(NULL) + OCF_DISCOVER_PERIOD_SECS;
     }
   }
-  std::vector<std::string> absent;
-  for (Presence *presence : presence_)
-  {
-    if (!presence->IsPresent())
-    {
-      absent.push_back(presence->GetId());
-    }
-  }
-  for (std::string &id : absent)
-  {
-    LOG(LOG_DEBUG, "[%p] %s absent", this, id.c_str());
-    Destroy(id.c_str());
-  }
+  FlushNotifications();
+  std::vector<Task *> unlocked;
   std::list<Task *>::iterator task = tasks_.begin();
   while (task != tasks_.end())
   {
     if (time(NULL) >= (*task)->tick)
     {
-      (*task)->Run(this);
-      delete (*task);
+      if ((*task)->NeedsLock())
+      {
+        (*task)->Run(this);
+        delete (*task);
+      }
+      else
+      {
+        if (*task == rd_publish_task_)
+        {
+          rd_publish_task_ = NULL;
+        }
+        unlocked.push_back(*task);
+      }
       task = tasks_.erase(task);
     }
     else
@@ -468,6 +587,14 @@ bool Bridge::Process()
       ++task;
     }
   }
+  Metrics::task_queue_depth.Set(tasks_.size());
+  // Keep the OCF callbacks going while the task writes files or publishes
+  lock.unlock();
+  for (Task *t : unlocked)
+  {
+    t->Run(this);
+    delete t;
+  }
   return true;
 }
 
@@ -510,13 +637,58 @@ bool Bridge::IsVirtual(HF::Attributes::List *attributes)
 
 void Bridge::UpdatePresenceStatus(const OCDiscoveryPayload *payload)
 {
-  for (Presence *p : presence_)
+  presence_->Seen(payload->sid, discovery_schedule_->GetRound());
+}
+
+static uint64_t Fnv1a(uint64_t h, const void *data, size_t size)
+{
+  const uint8_t *p = (const uint8_t *) data;
+  for (size_t i = 0; i < size; ++i)
   {
-    if (p->GetId() == payload->sid)
+    h = (h ^ p[i]) * 1099511628211ull;
+  }
+  return h;
+}
+
+static uint64_t Fnv1a(uint64_t h, const char *str)
+{
+  /* Include the terminator so that adjacent strings cannot run together. */
+  return str ? Fnv1a(h, str, strlen(str) + 1) : Fnv1a(h, "", 1);
+}
+
+/*
+ * A digest of everything in a discovery payload that the decision to translate a
+ * device depends on.  The address the response came from is left out, as a
+ * dual-stack device answers from each of its addresses.  Called with mutex_ held.
+ */
+uint64_t Bridge::Digest(const OCDiscoveryPayload *payload)
+{
+  uint64_t h = 14695981039346656037ull;
+  bool secure_mode = secure_mode_->GetSecureMode();
+  h = Fnv1a(h, &secure_mode, sizeof(secure_mode));
+  for (OCResourcePayload *resource = payload->resources; resource; resource = resource->next)
+  {
+    h = Fnv1a(h, resource->uri);
+    for (OCStringLL *type = resource->types; type; type = type->next)
     {
-      p->Seen();
+      h = Fnv1a(h, type->value);
+    }
+    for (OCStringLL *ifc = resource->interfaces; ifc; ifc = ifc->next)
+    {
+      h = Fnv1a(h, ifc->value);
+    }
+    h = Fnv1a(h, &resource->bitmap, sizeof(resource->bitmap));
+    h = Fnv1a(h, &resource->secure, sizeof(resource->secure));
+    h = Fnv1a(h, &resource->port, sizeof(resource->port));
+    for (OCEndpointPayload *ep = resource->eps; ep; ep = ep->next)
+    {
+      h = Fnv1a(h, ep->tps);
+      h = Fnv1a(h, ep->addr);
+      h = Fnv1a(h, &ep->family, sizeof(ep->family));
+      h = Fnv1a(h, &ep->port, sizeof(ep->port));
     }
   }
+  return h;
 }
 
 bool Bridge::IsSelf(const OCDiscoveryPayload *payload)
@@ -595,6 +767,7 @@ void Bridge::GetContextAndRepPayload(OCDoHandle handle, OCClientResponse *respon
   if (it != discovered_.end())
   {
     *context = it->second;
+    TRACE_INSTANT("callback", (*context)->device.di_.c_str(), response ? response->resourceUri : NULL);
   }
   
   if (response && response->result == OC_STACK_OK &&
@@ -620,6 +793,7 @@ OCStackResult Bridge::ContinueDiscovery(DiscoverContext *context,
                                         OCClientResponseHandler cb)
 {
   OCDoHandle cbHandle;
+  Trace::IdScope scope(context->device.di_.c_str());
   OCStackResult result = DoResource(&cbHandle, OC_REST_GET, uri, addrs, cb);
   if (result == OC_STACK_OK)
   {
@@ -634,6 +808,7 @@ OCStackResult Bridge::ContinueDiscovery(DiscoverContext *context,
                                         OCClientResponseHandler cb)
 {
   OCDoHandle cbHandle;
+  Trace::IdScope scope(context->device.di_.c_str());
   OCStackResult result = DoResource(&cbHandle, OC_REST_GET, uri, addr, cb);
   if (result == OC_STACK_OK)
   {
@@ -658,17 +833,45 @@ OCStackApplicationResult Bridge::DiscoverCB(void *ctx,
   for (payload = (OCDiscoveryPayload *) response->payload; payload; payload = payload->next)
   {
     DiscoverContext *context = NULL;
-    std::vector<OCDevAddr> addrs;
     OCStackResult result;
+    uint64_t digest;
+    bool is_self, has_seen_before, has_translatable_resource;
+    if (!payload->sid)
+    {
+      goto next;
+    }
     thiz->UpdatePresenceStatus(payload);
-    LOG(LOG_DEBUG, "isSelf=%d, hasSeenBefore=%d, hasTranslatableResource=%d", thiz->IsSelf(payload),
-      thiz->HasSeenBefore(payload), thiz->HasTranslatableResource(payload));
-    if (thiz->IsSelf(payload) || thiz->HasSeenBefore(payload) ||
-        !thiz->HasTranslatableResource(payload))
+    thiz->discovery_schedule_->Count((handle == thiz->discover_handle_) ?
+      DiscoverySchedule::RESPONSE : DiscoverySchedule::NOTIFICATION, time(NULL));
+    // Known devices whose payload has not changed need no further analysis
+    digest = thiz->Digest(payload);
+    {
+      auto it = thiz->digests_.find(payload->sid);
+      if (it != thiz->digests_.end() && it->second == digest)
+      {
+        goto next;
+      }
+    }
+    is_self = thiz->IsSelf(payload);
+    has_seen_before = !is_self && thiz->HasSeenBefore(payload);
+    has_translatable_resource = !is_self && !has_seen_before && thiz->HasTranslatableResource(payload);
+    LOG(LOG_DEBUG, "isSelf=%d, hasSeenBefore=%d, hasTranslatableResource=%d", is_self,
+      has_seen_before, has_translatable_resource);
+    if (has_seen_before)
     {
+      // The digest is recorded once the discovery in progress succeeds
       goto next;
     }
-    context = new DiscoverContext(thiz, response->devAddr, payload);
+    // The device is new or has changed, so discovery is not left to back off
+    thiz->discovery_schedule_->Count(DiscoverySchedule::ANALYSED, time(NULL));
+    thiz->discovery_schedule_->Changed(time(NULL));
+    if (is_self || !has_translatable_resource)
+    {
+      // Only final decisions are recorded, so a device whose discovery fails is tried again
+      thiz->digests_[payload->sid] = digest;
+      goto next;
+    }
+    context = new DiscoverContext(thiz, response->devAddr, payload, digest);
     if (!context)
     {
       goto next;
@@ -712,7 +915,8 @@ OCStackApplicationResult Bridge::GetDeviceCB(void *ctx, OCDoHandle handle, OCCli
       {
         // Delay creating virtual objects from a virtual device
         LOG(LOG_DEBUG, "[%p] Delaying creation of virtual objects from a virtual device", thiz);
-        thiz->tasks_.push_back(new DiscoverTask(time(NULL) + 10, piid, payload, context));
+        TRACE_INSTANT("deferred", context->device.di_.c_str(), piid);
+        thiz->tasks_.push_back(new DiscoverTask(time(NULL) + 10, piid, context));
         context = NULL;
         goto exit;
       }
@@ -722,7 +926,8 @@ OCStackApplicationResult Bridge::GetDeviceCB(void *ctx, OCDoHandle handle, OCCli
       }
       break;
     case SEEN_NATIVE:
-      // Do nothing
+      // A final decision, so this payload need not be analysed again
+      thiz->digests_[context->device.di_] = context->digest;
       goto exit;
     case SEEN_VIRTUAL:
       if (is_virtual)
@@ -767,7 +972,7 @@ OCStackApplicationResult Bridge::GetPlatformCB(void *ctx, OCDoHandle handle, OCC
   resource = context->device.GetResourceType(OC_RSRVD_RESOURCE_TYPE_DEVICE_CONFIGURATION);
   if (resource)
   {
-    result = thiz->ContinueDiscovery(context, resource->uri_.c_str(), resource->addrs_, Bridge::GetDeviceConfigurationCB);
+    result = thiz->ContinueDiscovery(context, resource->uri_.c_str(), resource->addrs(), Bridge::GetDeviceConfigurationCB);
   }
   else
   {
@@ -818,7 +1023,7 @@ OCStackResult Bridge::GetPlatformConfiguration(DiscoverContext *context)
   resource = context->device.GetResourceType(OC_RSRVD_RESOURCE_TYPE_PLATFORM_CONFIGURATION);
   if (resource)
   {
-    result = ContinueDiscovery(context, resource->uri_.c_str(), resource->addrs_,
+    result = ContinueDiscovery(context, resource->uri_.c_str(), resource->addrs(),
       Bridge::GetPlatformConfigurationCB);
   }
   else
@@ -865,7 +1070,7 @@ OCStackResult Bridge::GetCollection(DiscoverContext *context)
     Resource &r = *context->rit;
     if (HasResourceType(r.rts_, "oic.r.hanfunobject"))
     {
-      result = ContinueDiscovery(context, r.uri_.c_str(), r.addrs_, Bridge::GetCollectionCB);
+      result = ContinueDiscovery(context, r.uri_.c_str(), r.addrs(), Bridge::GetCollectionCB);
       if (result == OC_STACK_OK)
       {
         context = NULL;
@@ -897,16 +1102,21 @@ OCStackApplicationResult Bridge::GetCollectionCB(void *ctx, OCDoHandle handle, O
   {
     goto exit;
   }
-  if (!context->device.SetCollectionLinks(context->rit->uri_, payload))
   {
-    goto exit;
+    // Linking moves resources, so find the collection again afterwards
+    std::string uri = context->rit->uri_;
+    if (!context->device.SetCollectionLinks(uri, payload))
+    {
+      goto exit;
+    }
+    context->rit = FindResourceFromUri(context->device.resources_, uri);
   }
   for (++context->rit; context->rit != context->device.resources_.end(); ++context->rit)
   {
     Resource &r = *context->rit;
     if (HasResourceType(r.rts_, "oic.r.hanfunobject"))
     {
-      result = thiz->ContinueDiscovery(context, r.uri_.c_str(), r.addrs_, Bridge::GetCollectionCB);
+      result = thiz->ContinueDiscovery(context, r.uri_.c_str(), r.addrs(), Bridge::GetCollectionCB);
       if (result == OC_STACK_OK)
       {
         context = NULL;
@@ -933,7 +1143,7 @@ OCStackResult Bridge::GetIntrospection(DiscoverContext *context)
   resource = context->device.GetResourceType(OC_RSRVD_RESOURCE_TYPE_INTROSPECTION);
   if (resource)
   {
-    result = ContinueDiscovery(context, resource->uri_.c_str(), resource->addrs_, Bridge::GetIntrospectionCB);
+    result = ContinueDiscovery(context, resource->uri_.c_str(), resource->addrs(), Bridge::GetIntrospectionCB);
   }
   else
   {
@@ -1115,7 +1325,10 @@ OCStackApplicationResult Bridge::GetCB(void *ctx, OCDoHandle handle, OCClientRes
       Resource &r = it.GetResource();
       if (HasResourceType(r.rts_, resource_type))
       {
-        ifSet.insert(r.ifs_.begin(), r.ifs_.end());
+        for (Symbol ifc : r.ifs_)
+        {
+          ifSet.insert(Symbols::Name(ifc));
+        }
       }
     }
     std::vector<std::string> interfaces(ifSet.begin(), ifSet.end());
@@ -1138,7 +1351,9 @@ OCStackApplicationResult Bridge::GetCB(void *ctx, OCDoHandle handle, OCClientRes
   }
   if (!found)
   {
-    path = IntrospectPath(context->it.GetResource().rts_, context->it.GetResource().ifs_);
+    std::vector<std::string> rts = Names(context->it.GetResource().rts_);
+    std::vector<std::string> ifs = Names(context->it.GetResource().ifs_);
+    path = IntrospectPath(rts, ifs);
     if (!OCRepPayloadSetPropObjectAsOwner(context->paths, context->it.GetResource().uri_.c_str(), path))
     {
       goto exit;
@@ -1184,6 +1399,70 @@ exit:
   return OC_STACK_DELETE_TRANSACTION;
 }
 
+// Called with mutex_ held.
+void Bridge::ObserveDiscovery(DiscoverContext *context)
+{
+  if (observe_handles_.find(context->device.di_) != observe_handles_.end())
+  {
+    return;
+  }
+  // Changes to a known device are then seen without waiting for the next round
+  OCCallbackData cbData;
+  cbData.cb = Bridge::DiscoverCB;
+  cbData.context = this;
+  cbData.cd = NULL;
+  OCHeaderOption options[1];
+  size_t numOptions = 0;
+  uint16_t format = COAP_MEDIATYPE_APPLICATION_VND_OCF_CBOR;
+  OCSetHeaderOption(options, &numOptions, CA_OPTION_ACCEPT, &format, sizeof(format));
+  OCDoHandle handle = NULL;
+  OCStackResult result = ::DoResource(&handle, OC_REST_OBSERVE, OC_RSRVD_WELL_KNOWN_URI,
+    &context->origin, NULL, &cbData, options, numOptions);
+  if (result == OC_STACK_OK)
+  {
+    observe_handles_[context->device.di_] = handle;
+  }
+  else
+  {
+    LOG(LOG_ERR, "DoResource() - %d", result);
+  }
+}
+
+// Called with mutex_ held.
+void Bridge::CancelObserveDiscovery(const char *id)
+{
+  auto it = observe_handles_.find(id);
+  if (it != observe_handles_.end())
+  {
+    OCStackResult result = Cancel(it->second, OC_LOW_QOS, NULL, 0);
+    if (result != OC_STACK_OK)
+    {
+      LOG(LOG_ERR, "Cancel() - %d", result);
+    }
+    observe_handles_.erase(it);
+  }
+}
+
+void Bridge::Flush()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (protocols_ & HF)
+  {
+    ProcessHanEvents(lock);
+  }
+  FlushNotifications();
+}
+
+// Called with mutex_ held.
+void Bridge::FlushNotifications()
+{
+  if (sender_ == 0)
+  {
+    secure_mode_->Flush();
+    registration_->Flush();
+  }
+}
+
 bool Bridge::ParseIntrospectionPayload(DiscoverContext *context, OCRepPayload *payload)
 {
   OCPresence *presence = NULL;
@@ -1191,14 +1470,27 @@ bool Bridge::ParseIntrospectionPayload(DiscoverContext *context, OCRepPayload *p
   if (success)
   {
     //QStatus status;
-    presence = new OCPresence(context->device.di_.c_str(), OCF_DISCOVER_PERIOD_SECS);
+    presence = new OCPresence(context->device.di_.c_str(), 1);
     if (!presence)
     {
       LOG(LOG_ERR, "new OCPresence() failed");
       goto exit;
     }
-    presence_.push_back(presence);
+    if (!presence_->Add(presence, discovery_schedule_->GetRound()))
+    {
+      // Already translated, so the changed payload is settled too
+      LOG(LOG_ERR, "%s already present", context->device.di_.c_str());
+      digests_[context->device.di_] = context->digest;
+      goto exit;
+    }
     presence = NULL; // presence now belongs to this 
+    digests_[context->device.di_] = context->digest;
+    ObserveDiscovery(context);
+    TRACE_INSTANT("onboarded", context->device.di_.c_str(), NULL);
+    Metrics::onboarding_ms.Observe(NowMs() - context->started_ms);
+    // Marker for scripts/bench/discovery_throughput.sh; t is on the same clock as the device farm's.
+    LOG(LOG_INFO, "[%p] onboarded di=%s t=%llu", this, context->device.di_.c_str(),
+        (unsigned long long) NowMs());
     /*status = context->bus_->Announce();
     if (status != ER_OK)
     {
@@ -1288,6 +1580,7 @@ void Bridge::DestroyPiid(const char *piid)
 {
   /* Destroy virtual OC devices */
   kill_cb_(piid);
+  Metrics::plugin_processes.Add(-1);
   
   /* Destroy virtual HF devices */
 }
@@ -1296,19 +1589,25 @@ void Bridge::RDPublish(void *context)
 {
   Bridge *thiz = reinterpret_cast<Bridge *>(context);
   std::lock_guard<std::mutex> lock(thiz->mutex_);
-  if (thiz->rd_publish_task_)
+  thiz->ScheduleRDPublish();
+}
+
+// Called with mutex_ held.
+void Bridge::ScheduleRDPublish()
+{
+  if (rd_publish_task_)
   {
     // Delay the pending publication to give time for multiple resources to be created.
-    thiz->rd_publish_task_->tick = time(NULL) + 1;
+    rd_publish_task_->tick = time(NULL) + 1;
   }
   else
   {
-    thiz->rd_publish_task_ = new RDPublishTask(time(NULL) + 1);
-    thiz->tasks_.push_back(thiz->rd_publish_task_);
+    rd_publish_task_ = new RDPublishTask(time(NULL) + 1);
+    tasks_.push_back(rd_publish_task_);
   }
 }
 
-// Called with mutex_ held.
+// Does not need mutex_; only the OCF stack and the introspection file are touched.
 void Bridge::SetIntrospectionData(/* HF Data */const char *title, const char *version)
 {
   LOG(LOG_DEBUG, "[%p]", this);
@@ -1355,40 +1654,122 @@ exit:
   OICFree(out);
 }
 
-// Called with mutex_ held.
+// Called without mutex_ held.
 void Bridge::RDPublishTask::Run(Bridge *thiz)
 {
   LOG(LOG_DEBUG, "[%p] thiz=%p", this, thiz);
 
+  if (thiz->fast_start_)
+  {
+    // The resources are reachable through the Resource Directory before the
+    // introspection data they describe is written
+    ::RDPublish();
+    thiz->SetIntrospectionData(/* HF Info */"TITLE", "VERSION");
+  }
+  else
+  {
+    thiz->SetIntrospectionData(/* HF Info */"TITLE", "VERSION");
+    ::RDPublish();
+  }
+}
+
+// Called without mutex_ held.
+void Bridge::IntrospectionTask::Run(Bridge *thiz)
+{
+  LOG(LOG_DEBUG, "[%p] thiz=%p", this, thiz);
+
   thiz->SetIntrospectionData(/* HF Info */"TITLE", "VERSION");
-  ::RDPublish();
-  thiz->rd_publish_task_ = NULL;
 }
 
 void Bridge::GetDeviceTableCB(void *ctx,
-                              uint8_t dev_index,
+                              uint16_t dev_index,
                               uint8_t no_of_devices,
                               uint16_t *dev_ids,
                               uint8_t **dev_ipuis,
                               uint8_t **dev_emcs)
 {
   Bridge *thiz = reinterpret_cast<Bridge *>(ctx);
-  //std::lock_guard<std::mutex> lock(thiz->mutex_);
   LOG(LOG_TRACE, "DevIndex: %d, NoOfDevices: %d", dev_index, no_of_devices);
 
-  if (thiz->sender_ == 0)
+  // Runs on the libuv thread, so the table is copied and left for Process()
+  HanEvent event;
+  memset(&event, 0, sizeof(event));
+  event.type = HanEvent::DEVICE_TABLE;
+  event.dev_index = dev_index;
+  event.no_of_devices = (no_of_devices < HanEvent::MAX_DEVICES) ? no_of_devices : HanEvent::MAX_DEVICES;
+  for (uint8_t i = 0; i < event.no_of_devices; ++i)
+  {
+    event.dev_ids[i] = dev_ids[i];
+    if (dev_ipuis[i])
+    {
+      memcpy(event.dev_ipuis[i], dev_ipuis[i], sizeof(event.dev_ipuis[i]));
+    }
+    if (dev_emcs[i])
+    {
+      memcpy(event.dev_emcs[i], dev_emcs[i], sizeof(event.dev_emcs[i]));
+    }
+  }
+  if (!thiz->han_events_->Push(event))
+  {
+    LOG(LOG_ERR, "[%p] HAN-FUN event queue full, device table at %d dropped", thiz, dev_index);
+  }
+}
+
+// Called with mutex_ held by lock.
+void Bridge::ProcessHanEvents(std::unique_lock<std::mutex> &lock)
+{
+  HanEvent event;
+  while (han_events_->Pop(event))
   {
+    switch (event.type)
+    {
+      case HanEvent::DEVICE_TABLE:
+        DeviceTable(event, lock);
+        break;
+      case HanEvent::ACTIVITY:
+        Activity(event);
+        break;
+    }
+  }
+  // The page after a full one is asked for only once that one has been acted
+  // on, so a sync has at most one page in han_events_ however many devices there are
+  if (next_page_index_)
+  {
+    std::lock_guard<std::mutex> hf_lock(hf_mutex_);
+    han_client_->get_device_table(next_page_index_, HanEvent::MAX_DEVICES, this);
+    next_page_index_ = 0;
+  }
+}
+
+// Called with mutex_ held by lock.
+void Bridge::DeviceTable(HanEvent &event, std::unique_lock<std::mutex> &lock)
+{
+  uint16_t dev_index = event.dev_index;
+  uint8_t no_of_devices = event.no_of_devices;
+  uint16_t *dev_ids = event.dev_ids;
+  uint8_t *dev_ipuis[HanEvent::MAX_DEVICES];
+  uint8_t *dev_emcs[HanEvent::MAX_DEVICES];
+  for (uint8_t i = 0; i < no_of_devices; ++i)
+  {
+    dev_ipuis[i] = event.dev_ipuis[i];
+    dev_emcs[i] = event.dev_emcs[i];
+  }
+
+  if (sender_ == 0)
+  {
+    char (*piids)[UUID_STRING_SIZE] = new char[no_of_devices][UUID_STRING_SIZE];
+    GetProtocolIndependentIds(dev_ipuis, dev_emcs, no_of_devices, piids);
     for (int i = 0; i < no_of_devices; ++i)
     {
       LOG(LOG_TRACE, "%d", dev_ids[i]);
     
-      char piid[UUID_STRING_SIZE];
-      if (GetProtocolIndependentId(dev_ipuis[i], dev_emcs[i], piid))
+      const char *piid = piids[i];
+      if (piid[0])
       {
         // TODO: Check if virtual (phase 2)
         bool is_virtual = false;
 
-        switch (thiz->GetSeenState(piid))
+        switch (GetSeenState(piid))
         {
           case NOT_SEEN:
             if (is_virtual)
@@ -1397,7 +1778,9 @@ void Bridge::GetDeviceTableCB(void *ctx,
             }
             else
             {
-              thiz->exec_cb_(piid, /*dev_ids[i]*/dev_index + i + 1, thiz->secure_mode_->GetSecureMode(), is_virtual);
+              exec_cb_(piid, /*dev_ids[i]*/dev_index + i + 1, secure_mode_->GetSecureMode(), is_virtual);
+              Metrics::plugin_execs.Add();
+              Metrics::plugin_processes.Add(1);
             }
             break;
           case SEEN_NATIVE:
@@ -1411,8 +1794,10 @@ void Bridge::GetDeviceTableCB(void *ctx,
             else
             {
               
-              thiz->DestroyPiid(piid);
-              thiz->exec_cb_(piid, /*dev_ids[i]*/dev_index + i + 1, thiz->secure_mode_->GetSecureMode(), is_virtual);
+              DestroyPiid(piid);
+              exec_cb_(piid, /*dev_ids[i]*/dev_index + i + 1, secure_mode_->GetSecureMode(), is_virtual);
+              Metrics::plugin_execs.Add();
+              Metrics::plugin_processes.Add(1);
             }
             break;
         }
@@ -1422,29 +1807,59 @@ void Bridge::GetDeviceTableCB(void *ctx,
         LOG(LOG_ERR, "Cannot retrieve piid. ipui: %p, emc: %p", dev_ipuis[i], dev_emcs[i]);
       }
     }
+    delete[] piids;
 
-    if (no_of_devices == 5)
+    if (no_of_devices == HanEvent::MAX_DEVICES)
     {
-      thiz->han_client_->get_device_table(dev_index + 5, 5, ctx);
+      next_page_index_ = dev_index + HanEvent::MAX_DEVICES;
+    }
+    else if (device_table_started_ms_)
+    {
+      Metrics::device_table_sync_ms.Observe(NowMs() - device_table_started_ms_);
+      device_table_started_ms_ = 0;
     }
   }
   else
   {
-    VirtualOcfDevice *device = new VirtualOcfDevice(dev_ids[0]);
-    thiz->virtual_ocf_devices_.push_back(device);
-    thiz->presence_.push_back(new HFPresence(dev_ids[0]));
+    if (han_state_ == RUNNING)
+    {
+      // The device table entry at our index must still be the virtualized device
+      if (((no_of_devices == 0) || !hf_presence_->Seen(std::to_string(dev_ids[0]), time(NULL))) &&
+          !virtual_ocf_devices_.empty())
+      {
+        uint16_t address = virtual_ocf_devices_.front()->address();
+        LOG(LOG_INFO, "[%p] %d unregistered", this, address);
+        Disconnected(address);
+      }
+      return;
+    }
+    if (no_of_devices == 0)
+    {
+      return;
+    }
 
+    VirtualOcfDevice *device = new VirtualOcfDevice(dev_ids[0]);
     if (device->SetProperties(dev_ipuis[0], dev_emcs[0]) != OC_STACK_OK)
     {
       delete device;
+      return;
+    }
+    virtual_ocf_devices_.push_back(device);
+    HFPresence *presence = new HFPresence(dev_ids[0]);
+    if (!hf_presence_->Add(presence, time(NULL)))
+    {
+      delete presence;
     }
+    han_state_ = RUNNING;
+    get_devices_next_tick_ = time(NULL) + HF_DISCOVER_PERIOD_SECS;
 
-    VirtualResource *resource = thiz->CreateVirtualResource(dev_ids[0], "/example");
+    // Resource creation publishes to the RD, which takes mutex_
+    lock.unlock();
+    VirtualResource *resource = CreateVirtualResource(dev_ids[0], "/example");
+    lock.lock();
     if (resource)
     {
-      thiz->virtual_resources_.push_back(resource);
+      virtual_resources_.push_back(resource);
     }
-
-    thiz->han_state_ = RUNNING;
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,35 @@
+#include "coalescer.h"
+
+const uint32_t Coalescer::WINDOW_MS;
+
+bool Coalescer::Changed(Key key, uint64_t now_ms)
+{
+  auto it = entries_.find(key);
+  if (it == entries_.end())
+  {
+    entries_[key] = { now_ms, false };
+    return true;
+  }
+  Entry &entry = it->second;
+  if (!entry.held && (now_ms - entry.sent_ms >= window_ms_))
+  {
+    entry.sent_ms = now_ms;
+    return true;
+  }
+  entry.held = true;
+  return false;
+}
+
+void Coalescer::Due(uint64_t now_ms, std::vector<Key> &keys)
+{
+  for (auto &kv : entries_)
+  {
+    Entry &entry = kv.second;
+    if (entry.held && (now_ms - entry.sent_ms >= window_ms_))
+    {
+      entry.sent_ms = now_ms;
+      entry.held = false;
+      keys.push_back(kv.first);
+    }
+  }
+}
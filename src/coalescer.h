@@ -0,0 +1,40 @@
+#ifndef _COALESCER_H
+#define _COALESCER_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Limits how often changes to a key are passed on.  The first change after a
+ * quiet window goes through at once; later changes inside the window are held
+ * and only the latest is released when the window closes.
+ */
+class Coalescer
+{
+  public:
+    typedef const void *Key;
+
+    static const uint32_t WINDOW_MS = 250;
+
+    Coalescer(uint32_t window_ms = WINDOW_MS) : window_ms_(window_ms) {}
+
+    /* Returns true when the change may be passed on now, false when it is held. */
+    bool Changed(Key key, uint64_t now_ms);
+    /* Appends the keys with a held change whose window has closed. */
+    void Due(uint64_t now_ms, std::vector<Key> &keys);
+    void Remove(Key key) { entries_.erase(key); }
+    size_t Size() const { return entries_.size(); }
+
+  private:
+    struct Entry
+    {
+      uint64_t sent_ms;
+      bool held;
+    };
+    uint32_t window_ms_;
+    std::unordered_map<Key, Entry> entries_;
+};
+
+#endif
@@ -4,6 +4,10 @@
 #include "log.h"
 #include "ocpayload.h"
 #include "oic_malloc.h"
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 DeviceInformation::DeviceInformation()
 {
@@ -235,21 +239,146 @@ bool GetProtocolIndependentId(HF::Attributes::List *attributes, char piid[UUID_S
   return OCConvertUuidToString(id.id, piid);
 }
 
-bool GetProtocolIndependentId(uint8_t *ipui, uint8_t *emc, char piid[UUID_STRING_SIZE])
+/* Bounded LRU of IPUI and EMC to the id derived from them. */
+class IdCache
 {
-  OCUUIdentity id;
+  public:
+    IdCache(size_t capacity) : capacity_(capacity) { }
+
+    static uint64_t Key(const uint8_t *ipui, const uint8_t *emc)
+    {
+      uint64_t key = 0;
+      for (int i = 0; i < 5; ++i)
+      {
+        key = (key << 8) | ipui[i];
+      }
+      return (key << 16) | (emc[0] << 8) | emc[1];
+    }
 
-  if (ipui != NULL && emc != NULL)
+    bool Get(uint64_t key, char id[UUID_STRING_SIZE])
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = index_.find(key);
+      if (it == index_.end())
+      {
+        return false;
+      }
+      lru_.splice(lru_.begin(), lru_, it->second);
+      memcpy(id, it->second->id, UUID_STRING_SIZE);
+      return true;
+    }
+
+    void Put(uint64_t key, const char id[UUID_STRING_SIZE])
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = index_.find(key);
+      if (it != index_.end())
+      {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return;
+      }
+      if (lru_.size() >= capacity_)
+      {
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+      }
+      lru_.push_front(Entry());
+      lru_.front().key = key;
+      memcpy(lru_.front().id, id, UUID_STRING_SIZE);
+      index_[key] = lru_.begin();
+    }
+
+  private:
+    struct Entry
+    {
+      uint64_t key;
+      char id[UUID_STRING_SIZE];
+    };
+    std::mutex mutex_;
+    const size_t capacity_;
+    std::list<Entry> lru_;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+};
+
+static const size_t ID_CACHE_SIZE = 1024;
+static IdCache id_cache(ID_CACHE_SIZE);
+
+/* The piid and pi of a HAN-FUN device are both derived from its IPUI and EMC. */
+static bool GetId(uint8_t *ipui, uint8_t *emc, char id[UUID_STRING_SIZE])
+{
+  uint64_t key = IdCache::Key(ipui, emc);
+  if (id_cache.Get(key, id))
   {
-    Hash(&id, ipui, emc);
+    return true;
   }
-  else
+  OCUUIdentity uuid;
+  Hash(&uuid, ipui, emc);
+  if (!OCConvertUuidToString(uuid.id, id))
+  {
+    return false;
+  }
+  id_cache.Put(key, id);
+  return true;
+}
+
+bool GetProtocolIndependentId(uint8_t *ipui, uint8_t *emc, char piid[UUID_STRING_SIZE])
+{
+  if (ipui == NULL || emc == NULL)
   {
     LOG(LOG_WARN, "Cannot calculate piid. Aborting translation...");
     return false;
   }
 
-  return OCConvertUuidToString(id.id, piid);
+  return GetId(ipui, emc, piid);
+}
+
+size_t GetProtocolIndependentIds(uint8_t **ipuis, uint8_t **emcs, size_t count, char (*piids)[UUID_STRING_SIZE])
+{
+  size_t n = 0;
+  std::vector<size_t> misses;
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (ipuis[i] == NULL || emcs[i] == NULL)
+    {
+      LOG(LOG_WARN, "Cannot calculate piid. Aborting translation...");
+      piids[i][0] = '\0';
+    }
+    else if (id_cache.Get(IdCache::Key(ipuis[i], emcs[i]), piids[i]))
+    {
+      ++n;
+    }
+    else
+    {
+      misses.push_back(i);
+    }
+  }
+  if (misses.empty())
+  {
+    return n;
+  }
+  std::vector<OCUUIdentity> uuids(misses.size());
+  std::vector<uint8_t *> miss_ipuis(misses.size());
+  std::vector<uint8_t *> miss_emcs(misses.size());
+  for (size_t j = 0; j < misses.size(); ++j)
+  {
+    miss_ipuis[j] = ipuis[misses[j]];
+    miss_emcs[j] = emcs[misses[j]];
+  }
+  Hash(uuids.data(), miss_ipuis.data(), miss_emcs.data(), misses.size());
+  for (size_t j = 0; j < misses.size(); ++j)
+  {
+    size_t i = misses[j];
+    if (OCConvertUuidToString(uuids[j].id, piids[i]))
+    {
+      id_cache.Put(IdCache::Key(ipuis[i], emcs[i]), piids[i]);
+      ++n;
+    }
+    else
+    {
+      piids[i][0] = '\0';
+    }
+  }
+  return n;
 }
 
 void GetPlatformId(HF::Attributes::List *attributes, char pi[UUID_STRING_SIZE])
@@ -287,18 +416,10 @@ void GetPlatformId(HF::Attributes::List *attributes, char pi[UUID_STRING_SIZE])
 
 void GetPlatformId(uint8_t *ipui, uint8_t *emc, char pi[UUID_STRING_SIZE])
 {
-  OCUUIdentity id;
-
-  if (ipui != NULL && emc != NULL)
-  {
-    Hash(&id, ipui, emc);
-  }
-  else
+  if (ipui == NULL || emc == NULL || !GetId(ipui, emc, pi))
   {
     LOG(LOG_WARN, "Cannot calculate pi");
   }
-
-  OCConvertUuidToString(id.id, pi);
 }
 
 void GetModelNumber(HF::Attributes::List *attributes, std::string &model_number)
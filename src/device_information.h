@@ -49,6 +49,8 @@ class HasAttribute
 
 bool GetProtocolIndependentId(HF::Attributes::List *attributes, char piid[UUID_STRING_SIZE]);
 bool GetProtocolIndependentId(uint8_t *ipui, uint8_t *emc, char piid[UUID_STRING_SIZE]);
+/* Returns the number of piids calculated; a piid that cannot be calculated is left empty. */
+size_t GetProtocolIndependentIds(uint8_t **ipuis, uint8_t **emcs, size_t count, char (*piids)[UUID_STRING_SIZE]);
 void GetPlatformId(HF::Attributes::List *attributes, char pi[UUID_STRING_SIZE]);
 void GetPlatformId(uint8_t *ipui, uint8_t *emc, char pi[UUID_STRING_SIZE]);
 void GetModelNumber(HF::Attributes::List *attributes, std::string &model_number);
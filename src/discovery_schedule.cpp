@@ -0,0 +1,72 @@
+#include "discovery_schedule.h"
+
+#include "log.h"
+#include <string.h>
+
+const time_t DiscoverySchedule::MIN_INTERVAL_SECS;
+const time_t DiscoverySchedule::MAX_INTERVAL_SECS;
+
+DiscoverySchedule::DiscoverySchedule()
+  : round_(0), interval_secs_(MIN_INTERVAL_SECS), next_tick_(0), changed_(true), minute_(0)
+{
+  memset(this_minute_, 0, sizeof(this_minute_));
+  memset(last_minute_, 0, sizeof(last_minute_));
+}
+
+uint32_t DiscoverySchedule::Start(time_t now)
+{
+  if (changed_)
+  {
+    interval_secs_ = MIN_INTERVAL_SECS;
+  }
+  else if (interval_secs_ < MAX_INTERVAL_SECS)
+  {
+    interval_secs_ = (2 * interval_secs_ < MAX_INTERVAL_SECS) ? 2 * interval_secs_ : MAX_INTERVAL_SECS;
+  }
+  changed_ = false;
+  next_tick_ = now + interval_secs_;
+  Count(REQUEST, now);
+  return ++round_;
+}
+
+void DiscoverySchedule::Changed(time_t now)
+{
+  changed_ = true;
+  if (next_tick_ > now + MIN_INTERVAL_SECS)
+  {
+    next_tick_ = now + MIN_INTERVAL_SECS;
+  }
+}
+
+void DiscoverySchedule::Count(Message message, time_t now)
+{
+  Roll(now);
+  ++this_minute_[message];
+}
+
+void DiscoverySchedule::Roll(time_t now)
+{
+  time_t minute = now / 60;
+  if (minute == minute_)
+  {
+    return;
+  }
+  if (minute == minute_ + 1)
+  {
+    memcpy(last_minute_, this_minute_, sizeof(last_minute_));
+  }
+  else
+  {
+    memset(last_minute_, 0, sizeof(last_minute_));
+  }
+  memset(this_minute_, 0, sizeof(this_minute_));
+  bool started = (minute_ != 0);
+  minute_ = minute;
+  if (!started)
+  {
+    return;
+  }
+  LOG(LOG_INFO, "[%p] discovery/min requests=%u,responses=%u,notifications=%u,analysed=%u interval=%ld",
+    this, last_minute_[REQUEST], last_minute_[RESPONSE], last_minute_[NOTIFICATION],
+    last_minute_[ANALYSED], (long) interval_secs_);
+}
@@ -0,0 +1,55 @@
+#ifndef _DISCOVERY_SCHEDULE_H
+#define _DISCOVERY_SCHEDULE_H
+
+#include <inttypes.h>
+#include <time.h>
+
+/*
+ * Paces multicast discovery.  Rounds follow each other every MIN_INTERVAL_SECS
+ * while devices appear, change or leave, and the interval doubles after each
+ * quiet round up to MAX_INTERVAL_SECS.
+ *
+ * Also counts discovery traffic, reporting the totals of each minute.
+ */
+class DiscoverySchedule
+{
+  public:
+    static const time_t MIN_INTERVAL_SECS = 5;
+    static const time_t MAX_INTERVAL_SECS = 60;
+
+    enum Message
+    {
+      REQUEST,       // Multicast discovery sent
+      RESPONSE,      // Payload received in reply to a multicast discovery
+      NOTIFICATION,  // Payload received from an observed /oic/res
+      ANALYSED,      // Payload that was new or changed
+      MESSAGE_COUNT
+    };
+
+    DiscoverySchedule();
+
+    bool IsDue(time_t now) const { return now >= next_tick_; }
+    /* Starts a new round at now and returns its number. */
+    uint32_t Start(time_t now);
+    /* The next round follows within MIN_INTERVAL_SECS. */
+    void Changed(time_t now);
+    uint32_t GetRound() const { return round_; }
+    time_t GetInterval() const { return interval_secs_; }
+
+    void Count(Message message, time_t now);
+    /* Returns the count of the last complete minute. */
+    uint32_t PerMinute(Message message) const { return last_minute_[message]; }
+
+  private:
+    uint32_t round_;
+    time_t interval_secs_;
+    time_t next_tick_;
+    bool changed_;
+    time_t minute_;
+    uint32_t this_minute_[MESSAGE_COUNT];
+    uint32_t last_minute_[MESSAGE_COUNT];
+
+    void Roll(time_t now);
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef _HAN_EVENT_H
+#define _HAN_EVENT_H
+
+#include "spsc_queue.h"
+#include <inttypes.h>
+
+/*
+ * A copy of what the HAN-FUN client reported, posted from the libuv thread
+ * for Bridge::Process() to act on.
+ */
+struct HanEvent
+{
+  static const uint8_t MAX_DEVICES = 5;
+
+  enum Type
+  {
+    DEVICE_TABLE,
+    ACTIVITY,     /* A frame from the device at dev_index */
+  } type;
+  uint16_t dev_index;
+  uint8_t no_of_devices;
+  uint16_t dev_ids[MAX_DEVICES];
+  uint8_t dev_ipuis[MAX_DEVICES][5];
+  uint8_t dev_emcs[MAX_DEVICES][2];
+};
+
+class HanEventQueue : public SpscQueue<HanEvent, 64>
+{
+};
+
+#endif
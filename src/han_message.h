@@ -0,0 +1,236 @@
+#ifndef _HAN_MESSAGE_H
+#define _HAN_MESSAGE_H
+
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+/*
+ * Text messages exchanged with the CMBS daemon: an optional [SERVICE] line,
+ * a command line, and " NAME: value" parameter lines, all ending in \r\n.
+ */
+struct HanMessage
+{
+  char* service;
+  char* command;
+  char* parameters;
+  //std::map<char*, char*> parameters;
+  //std::list<Parameter> parameters;
+
+  HanMessage(char* service, char* command) :
+    service(service), command(command), parameters(NULL)
+  {}
+
+  HanMessage() :
+    HanMessage(NULL, NULL)
+  {}
+
+  /*void add_parameter(char* name, char* value)
+  {
+    parameters.insert(std::make_pair(name, value));
+  }*/
+
+  size_t pack(char* &buffer)
+  {
+    size_t service_size = service_pack_size();
+    size_t command_size = command_pack_size();
+    size_t parameters_size = parameters_pack_size();
+
+    buffer = (char*) calloc(1, service_size + command_size + parameters_size + 2);
+
+    pack_service(buffer);
+    pack_command(buffer, service_size);
+    pack_parameters(buffer, service_size + command_size);
+
+    buffer[service_size + command_size + parameters_size] = '\r';
+    buffer[service_size + command_size + parameters_size + 1] = '\n';
+  
+    return service_size + command_size + parameters_size + 2;
+  }
+
+  void unpack(char* buffer, size_t buffer_len)
+  {
+    uint8_t service_len = 0;
+    uint8_t command_len = 0;
+    char* lines = strtok(buffer, "\r\n");
+
+    if (lines != NULL)
+    {
+      if (lines[0] == '[')
+      {
+        service_len = strlen(lines);
+        service = (char*) calloc(1, service_len - 1);
+        memcpy(service, lines + 1, service_len - 2);
+
+        lines = strtok(NULL, "\r\n");
+      }
+      else
+      {
+        service = (char *)"HAN";
+      }
+
+      if (lines != NULL)
+      {
+        command_len = strlen(lines);
+        command = (char*) calloc(1, command_len + 1);
+        memcpy(command, lines, command_len);
+
+        lines = strtok(NULL, "\r\n");
+      }
+
+      if (lines != NULL)
+      {
+        parameters = (char *) calloc(1, buffer_len - service_len - command_len);
+        memcpy(parameters, lines, strlen(lines));
+        strcat(parameters, "\r\n");
+        lines = strtok(NULL, "\r\n");
+
+        while (lines != NULL)
+        {
+          strcat(parameters, lines);
+          strcat(parameters, "\r\n");
+          lines = strtok(NULL, "\r\n");
+        }
+      }
+    }
+  }
+
+  private:
+    size_t service_pack_size()
+    {
+      size_t size = 0;
+      if (service != NULL)
+      {
+        size += strlen(service) + 4;
+      }
+
+      return size;
+    }
+    void pack_service(char* &buffer)
+    {
+      if (service_pack_size() > 0)
+      {
+        size_t service_size = strlen(service);
+        buffer[0] = '[';
+        memcpy(buffer + 1, service, service_size);
+        buffer[service_size + 1] = ']';
+        buffer[service_size + 2] = '\r';
+        buffer[service_size + 3] = '\n';
+      }
+    }
+    size_t command_pack_size()
+    {
+      return strlen(command) + 2;
+    }
+    void pack_command(char* &buffer, size_t offset)
+    {
+      size_t command_size = strlen(command);
+      memcpy(buffer + offset, command, command_size);
+      buffer[offset + command_size] = '\r';
+      buffer[offset + command_size + 1] = '\n';
+    }
+    size_t parameters_pack_size()
+    {
+      size_t size = 0;
+      if (parameters != NULL)
+      {
+        size = strlen(parameters);
+      }
+      return size;
+    }
+    void pack_parameters(char* &buffer, size_t offset)
+    {
+      if (parameters_pack_size() > 0)
+      {
+        memcpy(buffer + offset, parameters, strlen(parameters));
+      }
+    }
+};
+
+struct DeviceTableMessage
+{
+  uint16_t dev_index;
+  uint8_t no_of_devices;
+  uint16_t *dev_ids;
+  uint8_t **dev_ipuis;
+  uint8_t **dev_emcs;
+
+  DeviceTableMessage()
+    : dev_index(0), no_of_devices(0), dev_ids(NULL), dev_ipuis(NULL), dev_emcs(NULL)
+  {}
+
+  ~DeviceTableMessage()
+  {
+    for (uint8_t i = 0; i < no_of_devices; ++i)
+    {
+      delete[] dev_ipuis[i];
+      delete[] dev_emcs[i];
+    }
+    delete[] dev_ids;
+    delete[] dev_ipuis;
+    delete[] dev_emcs;
+  }
+
+  void unpack(char* buffer)
+  {
+    char *saveptr;
+    char* lines = buffer ? strtok_r(buffer, "\r\n", &saveptr) : NULL;
+
+    if (lines == NULL || 0 != strncmp(" DEV_INDEX: ", lines, 12))
+    {
+      return;
+    }
+    dev_index = (uint16_t)atoi(lines + 12);
+
+    lines = strtok_r(NULL, "\r\n", &saveptr);
+    if (lines == NULL || 0 != strncmp(" NO_OF_DEVICES: ", lines, 16))
+    {
+      return;
+    }
+    uint8_t n = (uint8_t)atoi(lines + 16);
+    dev_ids = new uint16_t[n]();
+    dev_ipuis = new uint8_t*[n];
+    dev_emcs = new uint8_t*[n];
+    for (uint8_t i = 0; i < n; ++i)
+    {
+      dev_ipuis[i] = new uint8_t[5]();
+      dev_emcs[i] = new uint8_t[2]();
+    }
+    no_of_devices = n;
+
+    // Each device starts with its DEV_ID, followed by its DEV_IPUI and DEV_EMC
+    int i = -1;
+    for (lines = strtok_r(NULL, "\r\n", &saveptr); lines != NULL; lines = strtok_r(NULL, "\r\n", &saveptr))
+    {
+      if (0 == strncmp(" DEV_ID: ", lines, 9))
+      {
+        if (++i >= n)
+        {
+          break;
+        }
+        dev_ids[i] = (uint16_t)atoi(lines + 9);
+      }
+      else if (i >= 0 && 0 == strncmp(" DEV_IPUI: ", lines, 11))
+      {
+        unpack_bytes(lines + 11, dev_ipuis[i], 5);
+      }
+      else if (i >= 0 && 0 == strncmp(" DEV_EMC: ", lines, 10))
+      {
+        unpack_bytes(lines + 10, dev_emcs[i], 2);
+      }
+    }
+  }
+
+  private:
+    static void unpack_bytes(const char *value, uint8_t *bytes, size_t n)
+    {
+      char *end;
+      for (size_t j = 0; j < n; ++j)
+      {
+        bytes[j] = (uint8_t)strtol(value, &end, 10);
+        value = end;
+      }
+    }
+};
+
+#endif // _HAN_MESSAGE_H
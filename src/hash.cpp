@@ -5,113 +5,91 @@
 #include <openssl/sha.h>
 #endif
 
-void Hash(OCUUIdentity *id, const char *uid)
+static const OCUUIdentity ns =
 {
-  LOG(LOG_DEBUG, "uid=%s", uid);
+  0xeb, 0x82, 0x42, 0xfd,
+  0x5d, 0x95,
+  0x46, 0x92,
+  0x80, 0xf6,
+  0x79, 0x32, 0x20, 0x61, 0xb8, 0xff
+};
 
-  static const OCUUIdentity ns =
-  {
-    0xeb, 0x82, 0x42, 0xfd,
-    0x5d, 0x95,
-    0x46, 0x92,
-    0x80, 0xf6,
-    0x79, 0x32, 0x20, 0x61, 0xb8, 0xff
-  };
-  uint8_t digest[20];
 #ifdef WITH_POSIX
+/* The namespace prefix is hashed once; each call continues from a copy of this state. */
+static SHA_CTX NamespaceContext()
+{
   SHA_CTX ctx;
   int ret = SHA1_Init(&ctx);
   if (ret)
   {
     ret = SHA1_Update(&ctx, ns.id, UUID_IDENTITY_SIZE);
   }
-  if (ret && uid)
-  {
-    ret = SHA1_Update(&ctx, uid, strlen(uid));
-  }
-  if (ret)
-  {
-    ret = SHA1_Final(digest, &ctx);
-  }
   if (!ret)
   {
     LOG(LOG_ERR, "SHA1 - %d", ret);
   }
+  return ctx;
+}
 #elif _WIN32
-  BCRYPT_ALG_HANDLE hAlg = NULL;
-  BCRYPT_HASH_HANDLE hHash = NULL;
+struct NamespaceHash
+{
+  BCRYPT_ALG_HANDLE hAlg;
+  BCRYPT_HASH_HANDLE hHash;
   DWORD cbHashObject;
-  uint8_t *pbHashObject = NULL;
+  uint8_t *pbHashObject;
   NTSTATUS status;
-  status = BCryptOpenAlgorithmProvider(&hAlg, BCRYPT_SHA1_ALGORITM, NULL, 0);
-  if (BCRYPT_SUCCESS(status))
-  {
-    DWORD cbResult;
-    status = BCryptGetProperty(hAlg, BCRYPT_OBJECT_LENGTH, (PBYTE)&cbHashObject, sizeof(DWORD), &cbResult, 0);
-  }
-  if (BCRYPT_SUCCESS(status))
-  {
-    pbHashObject = new uint8_t[cbHashObject];
-    status = BCryptCreateHash(hAlg, &hHash, pbHashObject, cbHashObject, NULL, 0, 0);
-  }
-  if (BCRYPT_SUCCESS(status))
-  {
-    status = BCryptHashData(hHash, (PUCHAR)ns.id, UUID_IDENTITY_SIZE, 0);
-  }
-  if (BCRYPT_SUCCESS(status) && uid)
-  {
-    status = BCryptHashData(hHash, (PUCHAR)uid, strlen(uid), 0);
-  }
-  if (BCRYPT_SUCCESS(status))
-  {
-    status = BCryptFinishHash(hHash, digest, 20, 0);
-  }
-  if (!BCRYPT_SUCCESS(status))
-  {
-    LOG(LOG_ERR, "SHA1 - 0x%x", status);
-  }
-  if (hAlg)
-  {
-    BCryptCloseAlgorithmProvider(hAlg, 0);
-  }
-  if (hHash)
-  {
-    BCryptDestroyHash(hHash);
-  }
-  delete[] pbHashObject;
-#else
-#error Missing implementation of SHA-1 hash
+
+  NamespaceHash() : hAlg(NULL), hHash(NULL), cbHashObject(0), pbHashObject(NULL)
+  {
+    status = BCryptOpenAlgorithmProvider(&hAlg, BCRYPT_SHA1_ALGORITM, NULL, 0);
+    if (BCRYPT_SUCCESS(status))
+    {
+      DWORD cbResult;
+      status = BCryptGetProperty(hAlg, BCRYPT_OBJECT_LENGTH, (PBYTE)&cbHashObject, sizeof(DWORD), &cbResult, 0);
+    }
+    if (BCRYPT_SUCCESS(status))
+    {
+      pbHashObject = new uint8_t[cbHashObject];
+      status = BCryptCreateHash(hAlg, &hHash, pbHashObject, cbHashObject, NULL, 0, 0);
+    }
+    if (BCRYPT_SUCCESS(status))
+    {
+      status = BCryptHashData(hHash, (PUCHAR)ns.id, UUID_IDENTITY_SIZE, 0);
+    }
+    if (!BCRYPT_SUCCESS(status))
+    {
+      LOG(LOG_ERR, "SHA1 - 0x%x", status);
+    }
+  }
+  ~NamespaceHash()
+  {
+    if (hHash)
+    {
+      BCryptDestroyHash(hHash);
+    }
+    if (hAlg)
+    {
+      BCryptCloseAlgorithmProvider(hAlg, 0);
+    }
+    delete[] pbHashObject;
+  }
+};
 #endif
-  digest[7] = (digest[7] & 0x0f) | 0x50;
-  digest[8] = (digest[8] & 0x3f) | 0x80;
-  memcpy(id->id, digest, UUID_IDENTITY_SIZE);
-}
 
-void Hash(OCUUIdentity *id, uint8_t *ipui, uint8_t *emc)
+static void Hash(OCUUIdentity *id, const void *a, size_t a_size, const void *b, size_t b_size)
 {
-  static const OCUUIdentity ns =
-  {
-    0xeb, 0x82, 0x42, 0xfd,
-    0x5d, 0x95,
-    0x46, 0x92,
-    0x80, 0xf6,
-    0x79, 0x32, 0x20, 0x61, 0xb8, 0xff
-  };
   uint8_t digest[20];
 #ifdef WITH_POSIX
-  SHA_CTX ctx;
-  int ret = SHA1_Init(&ctx);
-  if (ret)
+  static const SHA_CTX ns_ctx = NamespaceContext();
+  SHA_CTX ctx = ns_ctx;
+  int ret = 1;
+  if (ret && a)
   {
-    ret = SHA1_Update(&ctx, ns.id, UUID_IDENTITY_SIZE);
+    ret = SHA1_Update(&ctx, a, a_size);
   }
-  if (ret && ipui)
+  if (ret && b)
   {
-    ret = SHA1_Update(&ctx, ipui, 5);
-  }
-  if (ret && emc)
-  {
-    ret = SHA1_Update(&ctx, emc, 2);
+    ret = SHA1_Update(&ctx, b, b_size);
   }
   if (ret)
   {
@@ -122,33 +100,22 @@ void Hash(OCUUIdentity *id, uint8_t *ipui, uint8_t *emc)
     LOG(LOG_ERR, "SHA1 - %d", ret);
   }
 #elif _WIN32
-  BCRYPT_ALG_HANDLE hAlg = NULL;
+  static const NamespaceHash ns_hash;
   BCRYPT_HASH_HANDLE hHash = NULL;
-  DWORD cbHashObject;
   uint8_t *pbHashObject = NULL;
-  NTSTATUS status;
-  status = BCryptOpenAlgorithmProvider(&hAlg, BCRYPT_SHA1_ALGORITM, NULL, 0);
+  NTSTATUS status = ns_hash.status;
   if (BCRYPT_SUCCESS(status))
   {
-    DWORD cbResult;
-    status = BCryptGetProperty(hAlg, BCRYPT_OBJECT_LENGTH, (PBYTE)&cbHashObject, sizeof(DWORD), &cbResult, 0);
+    pbHashObject = new uint8_t[ns_hash.cbHashObject];
+    status = BCryptDuplicateHash(ns_hash.hHash, &hHash, pbHashObject, ns_hash.cbHashObject, 0);
   }
-  if (BCRYPT_SUCCESS(status))
-  {
-    pbHashObject = new uint8_t[cbHashObject];
-    status = BCryptCreateHash(hAlg, &hHash, pbHashObject, cbHashObject, NULL, 0, 0);
-  }
-  if (BCRYPT_SUCCESS(status))
+  if (BCRYPT_SUCCESS(status) && a)
   {
-    status = BCryptHashData(hHash, (PUCHAR)ns.id, UUID_IDENTITY_SIZE, 0);
+    status = BCryptHashData(hHash, (PUCHAR)a, a_size, 0);
   }
-  if (BCRYPT_SUCCESS(status) && ipui)
+  if (BCRYPT_SUCCESS(status) && b)
   {
-    status = BCryptHashData(hHash, (PUCHAR)ipui, 5, 0);
-  }
-  if (BCRYPT_SUCCESS(status) && emc)
-  {
-    status = BCryptHashData(hHash, (PUCHAR)emc, 2, 0);
+    status = BCryptHashData(hHash, (PUCHAR)b, b_size, 0);
   }
   if (BCRYPT_SUCCESS(status))
   {
@@ -158,10 +125,6 @@ void Hash(OCUUIdentity *id, uint8_t *ipui, uint8_t *emc)
   {
     LOG(LOG_ERR, "SHA1 - 0x%x", status);
   }
-  if (hAlg)
-  {
-    BCryptCloseAlgorithmProvider(hAlg, 0);
-  }
   if (hHash)
   {
     BCryptDestroyHash(hHash);
@@ -173,4 +136,24 @@ void Hash(OCUUIdentity *id, uint8_t *ipui, uint8_t *emc)
   digest[7] = (digest[7] & 0x0f) | 0x50;
   digest[8] = (digest[8] & 0x3f) | 0x80;
   memcpy(id->id, digest, UUID_IDENTITY_SIZE);
-}
\ No newline at end of file
+}
+
+void Hash(OCUUIdentity *id, const char *uid)
+{
+  LOG(LOG_DEBUG, "uid=%s", uid);
+
+  Hash(id, uid, uid ? strlen(uid) : 0, NULL, 0);
+}
+
+void Hash(OCUUIdentity *id, uint8_t *ipui, uint8_t *emc)
+{
+  Hash(id, ipui, 5, emc, 2);
+}
+
+void Hash(OCUUIdentity *ids, uint8_t **ipuis, uint8_t **emcs, size_t count)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    Hash(&ids[i], ipuis[i], 5, emcs[i], 2);
+  }
+}
@@ -5,5 +5,7 @@
 
 void Hash(OCUUIdentity *id, const char *uid);
 void Hash(OCUUIdentity *id, uint8_t *ipui, uint8_t *emc);
+/* Hashes count IPUI and EMC pairs into ids. */
+void Hash(OCUUIdentity *ids, uint8_t **ipuis, uint8_t **emcs, size_t count);
 
-#endif
\ No newline at end of file
+#endif
@@ -3,36 +3,277 @@
 #include "device_configuration_resource.h"
 #include "octypes.h"
 #include "platform_configuration_resource.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
 #include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
 
-bool TranslateResourceType(const char *name)
+struct KnownResourceType
+{
+  const char *name;
+  ResourceTypeClass type_class;
+};
+
+static constexpr KnownResourceType known[] = {
+  { "oic.d.bridge", RT_DO_NOT_TRANSLATE },
+  { OC_RSRVD_RESOURCE_TYPE_COLLECTION, RT_DO_NOT_TRANSLATE },
+  { OC_RSRVD_RESOURCE_TYPE_INTROSPECTION, RT_DO_NOT_TRANSLATE },
+  { OC_RSRVD_RESOURCE_TYPE_RD, RT_DO_NOT_TRANSLATE },
+  { OC_RSRVD_RESOURCE_TYPE_RDPUBLISH, RT_DO_NOT_TRANSLATE },
+  { OC_RSRVD_RESOURCE_TYPE_RES, RT_DO_NOT_TRANSLATE },
+  { "oic.r.hanfunobject", RT_DO_NOT_TRANSLATE },
+  { "oic.r.acl", RT_DO_NOT_TRANSLATE },
+  { "oic.r.acl2", RT_DO_NOT_TRANSLATE },
+  { "oic.r.amacl", RT_DO_NOT_TRANSLATE },
+  { "oic.r.cred", RT_DO_NOT_TRANSLATE },
+  { "oic.r.crl", RT_DO_NOT_TRANSLATE },
+  { "oic.r.csr", RT_DO_NOT_TRANSLATE },
+  { "oic.r.doxm", RT_DO_NOT_TRANSLATE },
+  { "oic.r.pstat", RT_DO_NOT_TRANSLATE },
+  { "oic.r.roles", RT_DO_NOT_TRANSLATE },
+  { "oic.r.securemode", RT_DO_NOT_TRANSLATE },
+  { OC_RSRVD_RESOURCE_TYPE_DEVICE, RT_DEEP_TRANSLATE },
+  { OC_RSRVD_RESOURCE_TYPE_DEVICE_CONFIGURATION, RT_DEEP_TRANSLATE },
+  { OC_RSRVD_RESOURCE_TYPE_MAINTENANCE, RT_DEEP_TRANSLATE },
+  { OC_RSRVD_RESOURCE_TYPE_PLATFORM, RT_DEEP_TRANSLATE },
+  { OC_RSRVD_RESOURCE_TYPE_PLATFORM_CONFIGURATION, RT_DEEP_TRANSLATE }
+};
+static constexpr size_t KNOWN_COUNT = sizeof(known) / sizeof(known[0]);
+
+/*
+ * The known types are placed with a seeded hash into a table of SLOTS entries.
+ * The seed is searched for at compile time so that no two known types share a
+ * slot, so a known type is found with one hash and one strcmp.  Types registered
+ * at runtime go into the free slots with linear probing.
+ *
+ * As all types share the "oic." prefix, only the length and the last TAIL bytes
+ * are hashed.
+ */
+static constexpr uint32_t SLOTS = 128;
+static constexpr size_t MAX_REGISTERED = SLOTS / 2;
+static constexpr size_t TAIL = 8;
+static constexpr uint32_t MAX_SEED = 1024;
+
+static constexpr size_t Length(const char *s)
+{
+  return *s ? 1 + Length(s + 1) : 0;
+}
+
+static constexpr uint32_t Fnv1a(const char *s, uint32_t h)
+{
+  return *s ? Fnv1a(s + 1, (h ^ (uint8_t) *s) * 16777619u) : h;
+}
+
+static constexpr uint32_t Slot(const char *s, size_t length, uint32_t seed)
+{
+  return Fnv1a(s + ((length > TAIL) ? length - TAIL : 0), (2166136261u ^ seed) + length) % SLOTS;
+}
+
+static constexpr uint32_t Slot(const char *s, uint32_t seed)
+{
+  return Slot(s, Length(s), seed);
+}
+
+static constexpr bool IsUnique(uint32_t seed, size_t i, size_t j)
+{
+  return (j >= KNOWN_COUNT) ||
+    ((Slot(known[i].name, seed) != Slot(known[j].name, seed)) && IsUnique(seed, i, j + 1));
+}
+
+static constexpr bool IsPerfect(uint32_t seed, size_t i)
+{
+  return (i >= KNOWN_COUNT) || (IsUnique(seed, i, i + 1) && IsPerfect(seed, i + 1));
+}
+
+static constexpr uint32_t FindSeed(uint32_t seed)
+{
+  return (seed >= MAX_SEED || IsPerfect(seed, 0)) ? seed : FindSeed(seed + 1);
+}
+
+static constexpr uint32_t SEED = FindSeed(0);
+static_assert(SEED < MAX_SEED, "No perfect hash seed for the known resource types, increase SLOTS");
+
+static uint32_t Slot(const char *s)
+{
+  size_t length = strlen(s);
+  uint32_t h = (2166136261u ^ SEED) + length;
+  for (s += (length > TAIL) ? length - TAIL : 0; *s; ++s)
+  {
+    h = (h ^ (uint8_t) *s) * 16777619u;
+  }
+  return h % SLOTS;
+}
+
+/* Tables are immutable once published so that lookups never take a lock. */
+struct TypeTable
+{
+  KnownResourceType slots[SLOTS];
+  size_t registered;
+
+  TypeTable() : registered(0)
+  {
+    memset(slots, 0, sizeof(slots));
+    for (size_t i = 0; i < KNOWN_COUNT; ++i)
+    {
+      slots[Slot(known[i].name)] = known[i];
+    }
+  }
+
+  bool Refers(const char *name) const
+  {
+    for (uint32_t i = 0; i < SLOTS; ++i)
+    {
+      if (slots[i].name == name)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  const KnownResourceType *Find(const char *name) const
+  {
+    for (uint32_t i = Slot(name); slots[i].name; i = (i + 1) % SLOTS)
+    {
+      if (!strcmp(slots[i].name, name))
+      {
+        return &slots[i];
+      }
+    }
+    return NULL;
+  }
+};
+
+static const TypeTable known_table;
+static std::atomic<const TypeTable *> table(&known_table);
+static std::mutex registered_mutex;
+/* Owns the registered names that the current table refers to. */
+static std::vector<std::unique_ptr<std::string>> registered_names;
+
+/*
+ * A superseded table is deleted once no lookup can still be using it.  Each
+ * lookup is counted in one of two reader counts, chosen by the generation it
+ * starts in.  Publish() moves to the next generation and waits for the previous
+ * one's readers twice, so that a lookup that read the generation just before a
+ * move is waited for too.
+ */
+static std::atomic<uint32_t> generation(0);
+static std::atomic<uint32_t> readers[2];
+
+static bool IsKnown(const char *name)
+{
+  return known_table.Find(name) != NULL;
+}
+
+// Called with registered_mutex held.
+static void WaitForReaders()
 {
-  const char *do_not_translate[] = {
-    "oic.d.bridge",
-    OC_RSRVD_RESOURCE_TYPE_COLLECTION, OC_RSRVD_RESOURCE_TYPE_INTROSPECTION,
-    OC_RSRVD_RESOURCE_TYPE_RD, OC_RSRVD_RESOURCE_TYPE_RDPUBLISH, OC_RSRVD_RESOURCE_TYPE_RES,
-    "oic.r.hanfunobject", "oic.r.acl", "oic.r.acl2", "oic.r.amacl", "oic.r.cred", "oic.r.crl",
-    "oic.r.csr", "oic.r.doxm", "oic.r.pstat", "oic.r.roles", "oic.r.securemode" 
-  };
-  for (size_t i = 0; i < sizeof(do_not_translate)/sizeof(do_not_translate[0]); ++i)
+  for (int i = 0; i < 2; ++i)
   {
-    if (!strcmp(do_not_translate[i], name))
+    uint32_t g = generation.fetch_add(1);
+    while (readers[g & 1].load())
     {
-      return false;
+      std::this_thread::yield();
     }
   }
-  const char *do_deep_translation[] = {
-    OC_RSRVD_RESOURCE_TYPE_DEVICE, OC_RSRVD_RESOURCE_TYPE_DEVICE_CONFIGURATION,
-    OC_RSRVD_RESOURCE_TYPE_MAINTENANCE, OC_RSRVD_RESOURCE_TYPE_PLATFORM,
-    OC_RSRVD_RESOURCE_TYPE_PLATFORM_CONFIGURATION
-  };
-  for (size_t i = 0; i < sizeof(do_deep_translation)/sizeof(do_deep_translation[0]); ++i)
+}
+
+// Called with registered_mutex held.
+static void Publish(TypeTable *next)
+{
+  const TypeTable *previous = table.exchange(next);
+  WaitForReaders();
+  if (previous != &known_table)
+  {
+    delete previous;
+  }
+  std::vector<std::unique_ptr<std::string>>::iterator it = registered_names.begin();
+  while (it != registered_names.end())
+  {
+    it = next->Refers((*it)->c_str()) ? it + 1 : registered_names.erase(it);
+  }
+}
+
+ResourceTypeClass ClassifyResourceType(const char *name)
+{
+  std::atomic<uint32_t> &count = readers[generation.load() & 1];
+  count.fetch_add(1);
+  const KnownResourceType *entry = table.load()->Find(name);
+  ResourceTypeClass type_class = entry ? entry->type_class : RT_TRANSLATE;
+  count.fetch_sub(1, std::memory_order_release);
+  //return IsResourceTypeInWellDefinedSet(name) ? RT_DO_NOT_TRANSLATE : RT_TRANSLATE;
+  return type_class;
+}
+
+bool TranslateResourceType(const char *name)
+{
+  return ClassifyResourceType(name) != RT_DO_NOT_TRANSLATE;
+}
+
+bool RegisterResourceType(const char *name, ResourceTypeClass type_class)
+{
+  if (IsKnown(name))
+  {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(registered_mutex);
+  const TypeTable *current = table.load(std::memory_order_relaxed);
+  const KnownResourceType *entry = current->Find(name);
+  if (entry)
   {
-    if (!strcmp(do_deep_translation[i], name))
+    if (entry->type_class != type_class)
     {
-      return true;
+      TypeTable *next = new TypeTable(*current);
+      next->slots[entry - current->slots].type_class = type_class;
+      Publish(next);
     }
+    return true;
+  }
+  if (current->registered >= MAX_REGISTERED)
+  {
+    return false;
+  }
+  registered_names.push_back(std::unique_ptr<std::string>(new std::string(name)));
+  TypeTable *next = new TypeTable(*current);
+  uint32_t i = Slot(name);
+  while (next->slots[i].name)
+  {
+    i = (i + 1) % SLOTS;
   }
-  //return !IsResourceTypeInWellDefinedSet(name);
+  next->slots[i].name = registered_names.back()->c_str();
+  next->slots[i].type_class = type_class;
+  ++next->registered;
+  Publish(next);
   return true;
-}
\ No newline at end of file
+}
+
+void UnregisterResourceType(const char *name)
+{
+  std::lock_guard<std::mutex> lock(registered_mutex);
+  const TypeTable *current = table.load(std::memory_order_relaxed);
+  if (IsKnown(name) || !current->Find(name))
+  {
+    return;
+  }
+  /* Rebuild from the remaining registrations so that probe chains stay intact. */
+  TypeTable *next = new TypeTable();
+  for (uint32_t i = 0; i < SLOTS; ++i)
+  {
+    const KnownResourceType &slot = current->slots[i];
+    if (slot.name && strcmp(slot.name, name) && !IsKnown(slot.name))
+    {
+      uint32_t j = Slot(slot.name);
+      while (next->slots[j].name)
+      {
+        j = (j + 1) % SLOTS;
+      }
+      next->slots[j] = slot;
+      ++next->registered;
+    }
+  }
+  Publish(next);
+}
@@ -1,7 +1,22 @@
 #ifndef _INTERFACES_H
 #define _INTERFACES_H
 
+enum ResourceTypeClass
+{
+  RT_TRANSLATE,        // Translated as an ordinary resource
+  RT_DO_NOT_TRANSLATE, // Never translated
+  RT_DEEP_TRANSLATE    // Translated, including the properties of the device
+};
+
 //bool IsResourceTypeInWellDefinedSet(const char *name);
+ResourceTypeClass ClassifyResourceType(const char *name);
 bool TranslateResourceType(const char *name);
 
-#endif // _INTERFACES_H
\ No newline at end of file
+/*
+ * Adds a resource type, e.g. one defined by a HAN-FUN profile, to the classifier.
+ * Types known at compile time cannot be overridden.
+ */
+bool RegisterResourceType(const char *name, ResourceTypeClass type_class);
+void UnregisterResourceType(const char *name);
+
+#endif // _INTERFACES_H
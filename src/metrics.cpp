@@ -0,0 +1,257 @@
+#include "metrics.h"
+
+#include "log.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+Histogram::Histogram()
+  : sum_(0)
+{
+  for (size_t i = 0; i < BUCKETS; ++i)
+  {
+    buckets_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+size_t Histogram::Index(uint64_t value)
+{
+  if (value < SUB_BUCKETS)
+  {
+    return value;
+  }
+  unsigned e = 63 - __builtin_clzll(value);
+  if (e >= MAX_BITS)
+  {
+    return BUCKETS - 1;
+  }
+  return (e - SUB_BITS + 1) * SUB_BUCKETS + ((value >> (e - SUB_BITS)) - SUB_BUCKETS);
+}
+
+static uint64_t LowerBound(size_t i)
+{
+  if (i < Histogram::SUB_BUCKETS)
+  {
+    return i;
+  }
+  unsigned e = (i / Histogram::SUB_BUCKETS) - 1 + Histogram::SUB_BITS;
+  uint64_t m = Histogram::SUB_BUCKETS + (i % Histogram::SUB_BUCKETS);
+  return m << (e - Histogram::SUB_BITS);
+}
+
+uint64_t Histogram::UpperBound(size_t i)
+{
+  return LowerBound(i + 1) - 1;
+}
+
+void Histogram::Observe(uint64_t value)
+{
+  buckets_[Index(value)].fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::GetCount() const
+{
+  uint64_t count = 0;
+  for (size_t i = 0; i < BUCKETS; ++i)
+  {
+    count += GetBucket(i);
+  }
+  return count;
+}
+
+uint64_t Histogram::GetQuantile(double q) const
+{
+  uint64_t counts[BUCKETS];
+  uint64_t total = 0;
+  for (size_t i = 0; i < BUCKETS; ++i)
+  {
+    counts[i] = GetBucket(i);
+    total += counts[i];
+  }
+  if (total == 0)
+  {
+    return 0;
+  }
+  uint64_t rank = (uint64_t) ceil(q * total);
+  if (rank < 1)
+  {
+    rank = 1;
+  }
+  uint64_t seen = 0;
+  for (size_t i = 0; i < BUCKETS; ++i)
+  {
+    seen += counts[i];
+    if (seen >= rank)
+    {
+      return UpperBound(i);
+    }
+  }
+  return UpperBound(BUCKETS - 1);
+}
+
+namespace Metrics
+{
+  Gauge discovery_sessions;
+  Histogram onboarding_ms;
+  Counter do_resource_retries;
+  Counter endpoint_failovers;
+  Counter rd_publish;
+  Counter rd_publish_errors;
+  Counter rd_publish_resources;
+  Counter rd_publish_bytes;
+  Counter han_messages_in;
+  Counter han_messages_out;
+  Histogram device_table_sync_ms;
+  Gauge task_queue_depth;
+  Gauge plugin_processes;
+  Counter plugin_execs;
+  Gauge startup_storage_us;
+  Gauge startup_rd_database_us;
+  Gauge startup_stack_us;
+  Gauge startup_stop_multicast_us;
+  Gauge startup_rd_us;
+  Gauge startup_bridge_us;
+  Gauge startup_threads_us;
+  Gauge startup_total_us;
+  Gauge startup_reachable_us;
+
+  static const Entry kEntries[] = {
+    { "hanfun_bridge_discovery_sessions", "OCF devices being onboarded.",
+      GAUGE, &discovery_sessions },
+    { "hanfun_bridge_onboarding_milliseconds", "Time from discovery to the onboarding of an OCF device.",
+      HISTOGRAM, &onboarding_ms },
+    { "hanfun_bridge_do_resource_retries_total", "OCF requests sent again after a failed response.",
+      COUNTER, &do_resource_retries },
+    { "hanfun_bridge_endpoint_failovers_total", "OCF requests answered by an endpoint other than the first.",
+      COUNTER, &endpoint_failovers },
+    { "hanfun_bridge_rd_publish_total", "Publications to the Resource Directory.",
+      COUNTER, &rd_publish },
+    { "hanfun_bridge_rd_publish_errors_total", "Publications to the Resource Directory that failed.",
+      COUNTER, &rd_publish_errors },
+    { "hanfun_bridge_rd_publish_resources_total", "Resources published to the Resource Directory.",
+      COUNTER, &rd_publish_resources },
+    { "hanfun_bridge_rd_publish_bytes_total", "Bytes of href, rt and if strings published to the Resource Directory.",
+      COUNTER, &rd_publish_bytes },
+    { "hanfun_bridge_han_messages_in_total", "UDP messages received from the HAN-FUN base.",
+      COUNTER, &han_messages_in },
+    { "hanfun_bridge_han_messages_out_total", "UDP messages sent to the HAN-FUN base.",
+      COUNTER, &han_messages_out },
+    { "hanfun_bridge_device_table_sync_milliseconds", "Time to read the HAN-FUN device table.",
+      HISTOGRAM, &device_table_sync_ms },
+    { "hanfun_bridge_task_queue_depth", "Tasks waiting to run in Bridge::Process().",
+      GAUGE, &task_queue_depth },
+    { "hanfun_bridge_plugin_processes", "Plugin processes started and not killed.",
+      GAUGE, &plugin_processes },
+    { "hanfun_bridge_plugin_execs_total", "Plugin processes started.",
+      COUNTER, &plugin_execs },
+    { "hanfun_bridge_startup_storage_microseconds", "Time to register the persistent storage handler.",
+      GAUGE, &startup_storage_us },
+    { "hanfun_bridge_startup_rd_database_microseconds", "Time to set up the Resource Directory database.",
+      GAUGE, &startup_rd_database_us },
+    { "hanfun_bridge_startup_stack_microseconds", "Time to initialize the OCF stack.",
+      GAUGE, &startup_stack_us },
+    { "hanfun_bridge_startup_stop_multicast_microseconds", "Time to stop the multicast server of a plugin.",
+      GAUGE, &startup_stop_multicast_us },
+    { "hanfun_bridge_startup_rd_microseconds", "Time to find or start the Resource Directory.",
+      GAUGE, &startup_rd_us },
+    { "hanfun_bridge_startup_bridge_microseconds", "Time to start the bridge.",
+      GAUGE, &startup_bridge_us },
+    { "hanfun_bridge_startup_threads_microseconds", "Time to start the processing threads.",
+      GAUGE, &startup_threads_us },
+    { "hanfun_bridge_startup_total_microseconds", "Time from the start of the process to the end of its startup.",
+      GAUGE, &startup_total_us },
+    { "hanfun_bridge_startup_reachable_microseconds", "Time from the start of a plugin to its first publication to the Resource Directory.",
+      GAUGE, &startup_reachable_us },
+  };
+
+  const Entry *Begin()
+  {
+    return kEntries;
+  }
+
+  const Entry *End()
+  {
+    return kEntries + sizeof(kEntries) / sizeof(kEntries[0]);
+  }
+
+  static void Append(std::string &out, const char *format, ...)
+  {
+    char line[256];
+    va_list ap;
+    va_start(ap, format);
+    int n = vsnprintf(line, sizeof(line), format, ap);
+    va_end(ap);
+    if (n > 0)
+    {
+      out.append(line, ((size_t) n < sizeof(line)) ? n : sizeof(line) - 1);
+    }
+  }
+
+  void WritePrometheus(std::string &out)
+  {
+    static const char *types[] = { "counter", "gauge", "histogram" };
+    for (const Entry *entry = Begin(); entry != End(); ++entry)
+    {
+      Append(out, "# HELP %s %s\n# TYPE %s %s\n", entry->name, entry->help, entry->name,
+          types[entry->type]);
+      switch (entry->type)
+      {
+        case COUNTER:
+          Append(out, "%s %" PRIu64 "\n", entry->name,
+              static_cast<const Counter *>(entry->metric)->Get());
+          break;
+        case GAUGE:
+          Append(out, "%s %" PRId64 "\n", entry->name,
+              static_cast<const Gauge *>(entry->metric)->Get());
+          break;
+        case HISTOGRAM:
+          {
+            // Only the occupied buckets are listed; the counts are cumulative.  The
+            // last bucket has no upper bound, so it is only counted in +Inf.
+            const Histogram *histogram = static_cast<const Histogram *>(entry->metric);
+            uint64_t count = 0;
+            for (size_t i = 0; i < Histogram::BUCKETS - 1; ++i)
+            {
+              uint64_t n = histogram->GetBucket(i);
+              if (n)
+              {
+                count += n;
+                Append(out, "%s_bucket{le=\"%" PRIu64 "\"} %" PRIu64 "\n", entry->name,
+                    Histogram::UpperBound(i), count);
+              }
+            }
+            count += histogram->GetBucket(Histogram::BUCKETS - 1);
+            Append(out, "%s_bucket{le=\"+Inf\"} %" PRIu64 "\n", entry->name, count);
+            Append(out, "%s_sum %" PRIu64 "\n", entry->name, histogram->GetSum());
+            Append(out, "%s_count %" PRIu64 "\n", entry->name, count);
+            break;
+          }
+      }
+    }
+  }
+
+  bool WritePrometheusFile(const char *path)
+  {
+    std::string out;
+    WritePrometheus(out);
+    std::string tmp = std::string(path) + ".tmp";
+    FILE *file = fopen(tmp.c_str(), "w");
+    if (!file)
+    {
+      LOG(LOG_ERR, "fopen(%s) failed", tmp.c_str());
+      return false;
+    }
+    bool success = (fwrite(out.data(), 1, out.size(), file) == out.size());
+    success = (fclose(file) == 0) && success;
+    if (!success || rename(tmp.c_str(), path) != 0)
+    {
+      LOG(LOG_ERR, "writing %s failed", path);
+      remove(tmp.c_str());
+      return false;
+    }
+    return true;
+  }
+}
@@ -0,0 +1,116 @@
+#include "metrics_resource.h"
+
+#include "log.h"
+#include "metrics.h"
+#include "resource.h"
+#include "ocpayload.h"
+#include "ocstack.h"
+#include <string.h>
+#include <string>
+
+MetricsResource::MetricsResource()
+  : handle_(NULL)
+{
+}
+
+MetricsResource::~MetricsResource()
+{
+  DeleteResource(handle_);
+}
+
+OCStackResult MetricsResource::Create()
+{
+  return CreateResource(&handle_, OC_RSRVD_METRICS_URI, OC_RSRVD_RESOURCE_TYPE_METRICS,
+          OC_RSRVD_INTERFACE_READ, MetricsResource::EntityHandlerCB, this,
+          OC_DISCOVERABLE | OC_SECURE);
+}
+
+static bool SetHistogram(OCRepPayload *payload, const char *name, const Histogram *histogram)
+{
+  std::string prefix = name;
+  return OCRepPayloadSetPropInt(payload, (prefix + "_count").c_str(), histogram->GetCount()) &&
+      OCRepPayloadSetPropInt(payload, (prefix + "_sum").c_str(), histogram->GetSum()) &&
+      OCRepPayloadSetPropInt(payload, (prefix + "_p50").c_str(), histogram->GetQuantile(0.5)) &&
+      OCRepPayloadSetPropInt(payload, (prefix + "_p99").c_str(), histogram->GetQuantile(0.99));
+}
+
+OCRepPayload *MetricsResource::GetMetrics(OCResourceHandle handle, const QueryView &query,
+        PayloadArena &arena)
+{
+  OCRepPayload *payload = CreatePayload(handle, query, arena);
+  if (!payload)
+  {
+    return NULL;
+  }
+  for (const Metrics::Entry *entry = Metrics::Begin(); entry != Metrics::End(); ++entry)
+  {
+    bool success = false;
+    switch (entry->type)
+    {
+      case Metrics::COUNTER:
+        success = OCRepPayloadSetPropInt(payload, entry->name,
+            static_cast<const Counter *>(entry->metric)->Get());
+        break;
+      case Metrics::GAUGE:
+        success = OCRepPayloadSetPropInt(payload, entry->name,
+            static_cast<const Gauge *>(entry->metric)->Get());
+        break;
+      case Metrics::HISTOGRAM:
+        success = SetHistogram(payload, entry->name,
+            static_cast<const Histogram *>(entry->metric));
+        break;
+    }
+    if (!success)
+    {
+      arena.Destroy(payload);
+      return NULL;
+    }
+  }
+  return payload;
+}
+
+OCEntityHandlerResult MetricsResource::EntityHandlerCB(OCEntityHandlerFlag flag,
+        OCEntityHandlerRequest *request, void *ctx)
+{
+  LOG(LOG_DEBUG, "[%p] flag=%x,request=%p,ctx=%p", ctx, flag, request, ctx);
+  QueryView query(request->query);
+  if (!IsValidRequest(request, query))
+  {
+    LOG(LOG_WARN, "Invalid request received");
+    return OC_EH_BAD_REQ;
+  }
+
+  MetricsResource *thiz = reinterpret_cast<MetricsResource *>(ctx);
+  OCEntityHandlerResult result;
+  switch (request->method)
+  {
+    case OC_REST_GET:
+      {
+        OCEntityHandlerResponse response;
+        memset(&response, 0, sizeof(response));
+        response.requestHandle = request->requestHandle;
+        response.resourceHandle = request->resource;
+        PayloadArena arena;
+        OCRepPayload *payload = thiz->GetMetrics(request->resource, query, arena);
+        if (!payload)
+        {
+          result = OC_EH_ERROR;
+          break;
+        }
+        result = OC_EH_OK;
+        response.ehResult = result;
+        response.payload = reinterpret_cast<OCPayload *>(payload);
+        OCStackResult do_result = OCDoResponse(&response);
+        if (do_result != OC_STACK_OK)
+        {
+          LOG(LOG_ERR, "OCDoResponse - %d", do_result);
+        }
+        arena.Destroy(payload);
+        break;
+      }
+    default:
+      result = OC_EH_METHOD_NOT_ALLOWED;
+      break;
+  }
+  return result;
+}
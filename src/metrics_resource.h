@@ -0,0 +1,33 @@
+#ifndef _METRICS_RESOURCE_H
+#define _METRICS_RESOURCE_H
+
+#include "octypes.h"
+
+class PayloadArena;
+class QueryView;
+
+#define OC_RSRVD_RESOURCE_TYPE_METRICS "x.org.hanfun.metrics"
+
+#define OC_RSRVD_METRICS_URI "/metrics"
+
+/*
+ * Read-only view of the bridge metrics.  Counters and gauges are properties
+ * named as in the Prometheus dump; a histogram is reported as its _count,
+ * _sum, _p50 and _p99 properties.
+ */
+class MetricsResource
+{
+  public:
+    MetricsResource();
+    ~MetricsResource();
+    OCStackResult Create();
+
+  private:
+    OCResourceHandle handle_;
+
+    OCRepPayload *GetMetrics(OCResourceHandle handle, const QueryView &query, PayloadArena &arena);
+    static OCEntityHandlerResult EntityHandlerCB(OCEntityHandlerFlag flag,
+            OCEntityHandlerRequest *request, void *ctx);
+};
+
+#endif
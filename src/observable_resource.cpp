@@ -0,0 +1,117 @@
+#include "observable_resource.h"
+
+#include "log.h"
+#include "payload_arena.h"
+#include "ocstack.h"
+#include <algorithm>
+#include <chrono>
+
+const uint32_t ObservableResource::NOTIFY_WINDOW_MS;
+
+static uint64_t NowMs()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void ObservableResource::SetNotifyWindow(uint32_t window_ms)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  coalescer_ = Coalescer(window_ms);
+}
+
+size_t ObservableResource::GetObserverCount()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return observers_.size();
+}
+
+void ObservableResource::Observe(OCEntityHandlerFlag flag, OCEntityHandlerRequest *request)
+{
+  if (!(flag & OC_OBSERVE_FLAG))
+  {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  OCObservationId id = request->obsInfo.obsId;
+  std::vector<OCObservationId>::iterator it = std::find(observers_.begin(), observers_.end(), id);
+  switch (request->obsInfo.action)
+  {
+    case OC_OBSERVE_REGISTER:
+      if (it == observers_.end())
+      {
+        observers_.push_back(id);
+      }
+      break;
+    case OC_OBSERVE_DEREGISTER:
+      if (it != observers_.end())
+      {
+        observers_.erase(it);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+void ObservableResource::Notify(OCResourceHandle handle)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (coalescer_.Changed(this, NowMs()))
+  {
+    is_held_ = false;
+    Send(handle);
+  }
+  else
+  {
+    held_ = handle;
+    is_held_ = true;
+  }
+}
+
+void ObservableResource::Flush()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<Coalescer::Key> due;
+  coalescer_.Due(NowMs(), due);
+  if (!due.empty() && is_held_)
+  {
+    is_held_ = false;
+    Send(held_);
+  }
+}
+
+// Called with mutex_ held.
+void ObservableResource::Send(OCResourceHandle handle)
+{
+  if (observers_.empty())
+  {
+    return;
+  }
+  PayloadArena arena;
+  OCRepPayload *payload = CreateNotification(handle, arena);
+  if (!payload)
+  {
+    LOG(LOG_ERR, "CreateNotification() failed");
+    return;
+  }
+  // The observation list is limited to UINT8_MAX entries per call
+  size_t i = 0;
+  while (i < observers_.size())
+  {
+    uint8_t n = std::min(observers_.size() - i, (size_t) UINT8_MAX);
+    OCStackResult result = OCNotifyListOfObservers(handle, &observers_[i], n, payload, OC_NA_QOS);
+    if (result == OC_STACK_NO_OBSERVERS)
+    {
+      // The stack has dropped these observers without telling the entity handler
+      observers_.erase(observers_.begin() + i, observers_.begin() + i + n);
+      continue;
+    }
+    if (result != OC_STACK_OK)
+    {
+      LOG(LOG_ERR, "OCNotifyListOfObservers() - %d", result);
+    }
+    i += n;
+  }
+  arena.Destroy(payload);
+}
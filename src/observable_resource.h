@@ -0,0 +1,49 @@
+#ifndef _OBSERVABLE_RESOURCE_H
+#define _OBSERVABLE_RESOURCE_H
+
+#include "coalescer.h"
+#include "octypes.h"
+#include <mutex>
+#include <vector>
+
+class PayloadArena;
+
+/*
+ * Notifies the observers of a bridge resource.  The representation is built
+ * once per notification and sent to every observer, and changes arriving
+ * inside the notify window are folded into one notification of the latest
+ * state.
+ *
+ * Members may be called from any thread.  CreateNotification() is called with
+ * the notification lock held, so it must only read the resource's own state.
+ */
+class ObservableResource
+{
+  public:
+    static const uint32_t NOTIFY_WINDOW_MS = 100;
+
+    ObservableResource() : coalescer_(NOTIFY_WINDOW_MS), held_(NULL), is_held_(false) {}
+    virtual ~ObservableResource() {}
+    void SetNotifyWindow(uint32_t window_ms);
+    /* Sends a held notification once its window has closed. */
+    void Flush();
+    size_t GetObserverCount();
+
+  protected:
+    /* Tracks observers from the requests passed to the entity handler. */
+    void Observe(OCEntityHandlerFlag flag, OCEntityHandlerRequest *request);
+    void Notify(OCResourceHandle handle);
+    /* Creates the representation sent to every observer. */
+    virtual OCRepPayload *CreateNotification(OCResourceHandle handle, PayloadArena &arena) = 0;
+
+  private:
+    std::mutex mutex_;
+    std::vector<OCObservationId> observers_;
+    Coalescer coalescer_;
+    OCResourceHandle held_;
+    bool is_held_;
+
+    void Send(OCResourceHandle handle);
+};
+
+#endif
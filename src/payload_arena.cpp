@@ -0,0 +1,280 @@
+#include "payload_arena.h"
+
+#include "ocpayload.h"
+#include "oic_malloc.h"
+#include <string.h>
+
+PayloadArena::PayloadArena()
+  : blocks_(NULL), next_(inline_), left_(INLINE_SIZE)
+{
+}
+
+PayloadArena::~PayloadArena()
+{
+  while (blocks_)
+  {
+    Block *next = blocks_->next;
+    OICFree(blocks_);
+    blocks_ = next;
+  }
+}
+
+void *PayloadArena::Allocate(size_t size)
+{
+  const size_t align = alignof(std::max_align_t);
+  // Every allocation takes space, so the pointer returned is always Owns()
+  if (size == 0)
+  {
+    size = 1;
+  }
+  size = (size + align - 1) & ~(align - 1);
+  if (size > left_)
+  {
+    size_t header = (sizeof(Block) + align - 1) & ~(align - 1);
+    size_t block_size = (size > BLOCK_SIZE) ? size : BLOCK_SIZE;
+    Block *block = (Block *) OICMalloc(header + block_size);
+    if (!block)
+    {
+      return NULL;
+    }
+    block->next = blocks_;
+    block->size = header + block_size;
+    blocks_ = block;
+    next_ = (char *) block + header;
+    left_ = block_size;
+  }
+  void *p = next_;
+  next_ += size;
+  left_ -= size;
+  return p;
+}
+
+char *PayloadArena::Strdup(const char *str)
+{
+  if (!str)
+  {
+    return NULL;
+  }
+  size_t n = strlen(str) + 1;
+  char *p = (char *) Allocate(n);
+  if (p)
+  {
+    memcpy(p, str, n);
+  }
+  return p;
+}
+
+bool PayloadArena::Owns(const void *p) const
+{
+  const char *c = (const char *) p;
+  if (!c)
+  {
+    return false;
+  }
+  if (c >= inline_ && c < inline_ + INLINE_SIZE)
+  {
+    return true;
+  }
+  for (const Block *block = blocks_; block; block = block->next)
+  {
+    if (c >= (const char *) block && c < (const char *) block + block->size)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool PayloadArena::SetStringArray(OCRepPayload *payload, const char *name, const char **strs,
+  size_t n)
+{
+  if (!payload)
+  {
+    return false;
+  }
+  char **array = (char **) Allocate(n * sizeof(char *));
+  if (!array)
+  {
+    return false;
+  }
+  if (n)
+  {
+    memcpy(array, strs, n * sizeof(char *));
+  }
+  /* Replacing a value frees its contents, so first detach any that are ours. */
+  for (OCRepPayloadValue *value = payload->values; value; value = value->next)
+  {
+    if (!strcmp(value->name, name))
+    {
+      Detach(value);
+    }
+  }
+  size_t dim[MAX_REP_ARRAY_DEPTH] = { n, 0, 0 };
+  return OCRepPayloadSetStringArrayAsOwner(payload, name, array, dim);
+}
+
+OCRepPayload *PayloadArena::CreatePayload()
+{
+  OCRepPayload *payload = (OCRepPayload *) Allocate(sizeof(OCRepPayload));
+  if (payload)
+  {
+    memset(payload, 0, sizeof(OCRepPayload));
+    payload->base.type = PAYLOAD_TYPE_REPRESENTATION;
+  }
+  return payload;
+}
+
+OCRepPayloadValue *PayloadArena::AddValue(OCRepPayload *payload, const char *name,
+  OCRepPayloadPropType type)
+{
+  if (!payload || !Owns(payload))
+  {
+    return NULL;
+  }
+  OCRepPayloadValue *value = (OCRepPayloadValue *) Allocate(sizeof(OCRepPayloadValue));
+  char *dup = Strdup(name);
+  if (!value || !dup)
+  {
+    return NULL;
+  }
+  memset(value, 0, sizeof(OCRepPayloadValue));
+  value->name = dup;
+  value->type = type;
+  /* Appended, so the properties keep the order they are added in. */
+  OCRepPayloadValue **tail = &payload->values;
+  while (*tail)
+  {
+    tail = &(*tail)->next;
+  }
+  *tail = value;
+  return value;
+}
+
+bool PayloadArena::AddString(OCRepPayload *payload, const char *name, const char *str)
+{
+  OCRepPayloadValue *value = str ? AddValue(payload, name, OCREP_PROP_STRING) : NULL;
+  if (!value)
+  {
+    return false;
+  }
+  value->str = (char *) str;
+  return true;
+}
+
+bool PayloadArena::AddStringArray(OCRepPayload *payload, const char *name, const char **strs,
+  size_t n)
+{
+  OCRepPayloadValue *value = AddValue(payload, name, OCREP_PROP_ARRAY);
+  if (!value)
+  {
+    return false;
+  }
+  value->arr.type = OCREP_PROP_STRING;
+  value->arr.dimensions[0] = n;
+  value->arr.strArr = (char **) strs;
+  return true;
+}
+
+bool PayloadArena::SetObjectArray(OCRepPayload *payload, const char *name, OCRepPayload **objs,
+  size_t n)
+{
+  if (!payload || !Owns(objs))
+  {
+    return false;
+  }
+  for (OCRepPayloadValue *value = payload->values; value; value = value->next)
+  {
+    if (!strcmp(value->name, name))
+    {
+      Detach(value);
+    }
+  }
+  size_t dim[MAX_REP_ARRAY_DEPTH] = { n, 0, 0 };
+  return OCRepPayloadSetPropObjectArrayAsOwner(payload, name, objs, dim);
+}
+
+void PayloadArena::Detach(OCRepPayloadValue *value)
+{
+  switch (value->type)
+  {
+    case OCREP_PROP_STRING:
+      if (Owns(value->str))
+      {
+        value->str = NULL;
+      }
+      break;
+    case OCREP_PROP_BYTE_STRING:
+      if (Owns(value->ocByteStr.bytes))
+      {
+        value->ocByteStr.bytes = NULL;
+        value->ocByteStr.len = 0;
+      }
+      break;
+    case OCREP_PROP_OBJECT:
+      Release(value->obj);
+      break;
+    case OCREP_PROP_ARRAY:
+      {
+        size_t n = calcDimTotal(value->arr.dimensions);
+        if (value->arr.type == OCREP_PROP_STRING)
+        {
+          if (Owns(value->arr.strArr))
+          {
+            /* The elements belong to the arena or the caller. */
+            memset(value->arr.dimensions, 0, sizeof(value->arr.dimensions));
+            value->arr.strArr = NULL;
+          }
+          else
+          {
+            for (size_t i = 0; i < n; ++i)
+            {
+              if (Owns(value->arr.strArr[i]))
+              {
+                value->arr.strArr[i] = NULL;
+              }
+            }
+          }
+        }
+        else if (value->arr.type == OCREP_PROP_OBJECT)
+        {
+          if (Owns(value->arr.objArray))
+          {
+            /* Made by SetObjectArray(); the objects and their values are ours. */
+            memset(value->arr.dimensions, 0, sizeof(value->arr.dimensions));
+            value->arr.objArray = NULL;
+          }
+          else
+          {
+            for (size_t i = 0; i < n; ++i)
+            {
+              Release(value->arr.objArray[i]);
+            }
+          }
+        }
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+void PayloadArena::Release(OCRepPayload *payload)
+{
+  for (; payload; payload = payload->next)
+  {
+    if (Owns(payload->uri))
+    {
+      payload->uri = NULL;
+    }
+    for (OCRepPayloadValue *value = payload->values; value; value = value->next)
+    {
+      Detach(value);
+    }
+  }
+}
+
+void PayloadArena::Destroy(OCRepPayload *payload)
+{
+  Release(payload);
+  OCRepPayloadDestroy(payload);
+}
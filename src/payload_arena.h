@@ -0,0 +1,64 @@
+#ifndef _PAYLOAD_ARENA_H
+#define _PAYLOAD_ARENA_H
+
+#include "octypes.h"
+#include <cstddef>
+
+/*
+ * Bump allocator for the strings and arrays of one response payload.  Arena
+ * memory must only be attached to a payload that is released with Destroy(),
+ * and the arena must outlive the payload.
+ */
+class PayloadArena
+{
+  public:
+    PayloadArena();
+    ~PayloadArena();
+
+    void *Allocate(size_t size);
+    char *Strdup(const char *str);
+    bool Owns(const void *p) const;
+
+    /* Sets a string array property without copying the elements, which must outlive the payload. */
+    bool SetStringArray(OCRepPayload *payload, const char *name, const char **strs, size_t n);
+
+    /*
+     * Creates a payload that lives in the arena with its values, for the
+     * objects of SetObjectArray().  Its properties are added with AddString()
+     * and AddStringArray(), which do not copy the values.
+     */
+    OCRepPayload *CreatePayload();
+    bool AddString(OCRepPayload *payload, const char *name, const char *str);
+    bool AddStringArray(OCRepPayload *payload, const char *name, const char **strs, size_t n);
+    /* Sets an array of payloads made by CreatePayload(). */
+    bool SetObjectArray(OCRepPayload *payload, const char *name, OCRepPayload **objs, size_t n);
+    /* Detaches the arena's memory from payload then destroys the rest of it. */
+    void Destroy(OCRepPayload *payload);
+
+  private:
+    struct Block
+    {
+      Block *next;
+      size_t size;
+    };
+    static const size_t INLINE_SIZE = 512;
+    static const size_t BLOCK_SIZE = 4096;
+
+    Block *blocks_;
+    char *next_;
+    size_t left_;
+    union
+    {
+      std::max_align_t align_;
+      char inline_[INLINE_SIZE];
+    };
+
+    void Detach(OCRepPayloadValue *value);
+    OCRepPayloadValue *AddValue(OCRepPayload *payload, const char *name, OCRepPayloadPropType type);
+    void Release(OCRepPayload *payload);
+
+    PayloadArena(const PayloadArena &);
+    PayloadArena &operator=(const PayloadArena &);
+};
+
+#endif
@@ -0,0 +1,674 @@
+#include "persistent_store.h"
+
+#include "log.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * The file starts with a header, followed by records of
+ *   magic, crc, key size, value size, key, value
+ * padded to 8 bytes.  The crc covers the sizes, the key and the value.  A
+ * removed key is recorded with a value size of TOMBSTONE and no value.
+ */
+static const char kMagic[8] = { 'H', 'F', 'S', 'T', 'O', 'R', 'E', '\0' };
+static const uint32_t VERSION = 1;
+static const size_t HEADER_SIZE = 16;
+static const uint32_t RECORD_MAGIC = 0x52465348;
+static const uint32_t TOMBSTONE = 0xffffffff;
+static const size_t MAP_GRANULE = 64 * 1024;
+/* Compact once the file is at least this large and mostly dead records. */
+static const size_t COMPACT_MIN_BYTES = 256 * 1024;
+
+struct RecordHeader
+{
+  uint32_t magic;
+  uint32_t crc;
+  uint32_t key_size;
+  uint32_t value_size;
+};
+
+struct CrcTable
+{
+  uint32_t values[256];
+  CrcTable()
+  {
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k)
+      {
+        c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+      }
+      values[i] = c;
+    }
+  }
+};
+
+static uint32_t Crc32(uint32_t crc, const void *data, size_t size)
+{
+  static const CrcTable table;
+  const uint8_t *p = (const uint8_t *) data;
+  crc = ~crc;
+  for (size_t i = 0; i < size; ++i)
+  {
+    crc = table.values[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+static uint32_t RecordCrc(uint32_t key_size, uint32_t value_size, const void *key, const void *value)
+{
+  uint32_t sizes[2] = { key_size, value_size };
+  uint32_t crc = Crc32(0, sizes, sizeof(sizes));
+  crc = Crc32(crc, key, key_size);
+  if (value_size != TOMBSTONE)
+  {
+    crc = Crc32(crc, value, value_size);
+  }
+  return crc;
+}
+
+static size_t RecordSize(uint32_t key_size, uint32_t value_size)
+{
+  size_t size = sizeof(RecordHeader) + key_size + ((value_size != TOMBSTONE) ? value_size : 0);
+  return (size + 7) & ~(size_t) 7;
+}
+
+static bool WriteAll(int fd, const void *data, size_t size, off_t offset)
+{
+  const uint8_t *p = (const uint8_t *) data;
+  while (size)
+  {
+    ssize_t n = pwrite(fd, p, size, offset);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return false;
+    }
+    p += n;
+    size -= n;
+    offset += n;
+  }
+  return true;
+}
+
+/* Makes a rename in the directory of path durable. */
+/* True if every byte of the file is zero, as when a crash beat the header to the disk. */
+static bool IsZeroed(int fd, size_t size)
+{
+  uint8_t buf[4096];
+  size_t offset = 0;
+  while (offset < size)
+  {
+    ssize_t n = pread(fd, buf, sizeof(buf), offset);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return false;
+    }
+    if (n == 0)
+    {
+      break;
+    }
+    for (ssize_t i = 0; i < n; ++i)
+    {
+      if (buf[i])
+      {
+        return false;
+      }
+    }
+    offset += n;
+  }
+  return true;
+}
+
+static bool SyncDirectory(const std::string &path)
+{
+  std::string::size_type slash = path.rfind('/');
+  std::string dir = (slash == std::string::npos) ? "." : (slash ? path.substr(0, slash) : "/");
+  int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    return false;
+  }
+  bool success = (fsync(fd) == 0);
+  close(fd);
+  return success;
+}
+
+PersistentStore::PersistentStore()
+  : sync_(false), fd_(-1), ino_(0), map_(NULL), map_size_(0), end_(0), live_bytes_(0)
+{
+}
+
+PersistentStore::~PersistentStore()
+{
+  Close();
+}
+
+bool PersistentStore::Open(const char *path, bool sync)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  CloseFile();
+  path_ = path;
+  sync_ = sync;
+  if (!Lock())
+  {
+    CloseFile();
+    return false;
+  }
+  Unlock();
+  return true;
+}
+
+void PersistentStore::Close()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  CloseFile();
+}
+
+bool PersistentStore::OpenFile()
+{
+  fd_ = open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd_ < 0)
+  {
+    LOG(LOG_ERR, "open(%s) failed - %d", path_.c_str(), errno);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd_, &st) < 0)
+  {
+    LOG(LOG_ERR, "fstat(%s) failed - %d", path_.c_str(), errno);
+    CloseFile();
+    return false;
+  }
+  ino_ = st.st_ino;
+  return true;
+}
+
+void PersistentStore::CloseFile()
+{
+  if (map_)
+  {
+    munmap(map_, map_size_);
+    map_ = NULL;
+    map_size_ = 0;
+  }
+  if (fd_ >= 0)
+  {
+    close(fd_);
+    fd_ = -1;
+  }
+  ino_ = 0;
+  end_ = 0;
+  live_bytes_ = 0;
+  index_.clear();
+}
+
+// Locks the current file, reopening it if it was compacted by another
+// process, and reads the records appended since the last call.
+bool PersistentStore::Lock()
+{
+  for (;;)
+  {
+    if ((fd_ < 0) && !OpenFile())
+    {
+      return false;
+    }
+    while (flock(fd_, LOCK_EX) < 0)
+    {
+      if (errno != EINTR)
+      {
+        LOG(LOG_ERR, "flock(%s) failed - %d", path_.c_str(), errno);
+        return false;
+      }
+    }
+    struct stat st;
+    if ((stat(path_.c_str(), &st) == 0) && (st.st_ino == ino_))
+    {
+      if (Scan())
+      {
+        return true;
+      }
+      Unlock();
+      return false;
+    }
+    CloseFile();
+  }
+}
+
+void PersistentStore::Unlock()
+{
+  if (fd_ >= 0)
+  {
+    flock(fd_, LOCK_UN);
+  }
+}
+
+bool PersistentStore::Map(size_t size)
+{
+  if (size <= map_size_)
+  {
+    return true;
+  }
+  size_t map_size = map_size_ ? map_size_ : MAP_GRANULE;
+  while (map_size < size)
+  {
+    map_size *= 2;
+  }
+  // Pages past the end of the file are never touched
+  void *map = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd_, 0);
+  if (map == MAP_FAILED)
+  {
+    LOG(LOG_ERR, "mmap(%s) failed - %d", path_.c_str(), errno);
+    return false;
+  }
+  if (map_)
+  {
+    munmap(map_, map_size_);
+  }
+  map_ = (uint8_t *) map;
+  map_size_ = map_size;
+  return true;
+}
+
+bool PersistentStore::Scan()
+{
+  struct stat st;
+  if (fstat(fd_, &st) < 0)
+  {
+    LOG(LOG_ERR, "fstat(%s) failed - %d", path_.c_str(), errno);
+    return false;
+  }
+  size_t size = st.st_size;
+  if ((size < HEADER_SIZE) || ((end_ == 0) && IsZeroed(fd_, size)))
+  {
+    // A new file, or one whose header was cut short or left zeroed by a crash
+    if ((size > 0) && (ftruncate(fd_, 0) < 0))
+    {
+      LOG(LOG_ERR, "ftruncate(%s) failed - %d", path_.c_str(), errno);
+      return false;
+    }
+    uint8_t header[HEADER_SIZE] = { 0 };
+    memcpy(header, kMagic, sizeof(kMagic));
+    memcpy(header + sizeof(kMagic), &VERSION, sizeof(VERSION));
+    if (!WriteAll(fd_, header, sizeof(header), 0) || (sync_ && fdatasync(fd_) < 0))
+    {
+      LOG(LOG_ERR, "write(%s) failed - %d", path_.c_str(), errno);
+      return false;
+    }
+    size = HEADER_SIZE;
+  }
+  if (size < end_)
+  {
+    index_.clear();
+    live_bytes_ = 0;
+    end_ = 0;
+  }
+  if (!Map(size))
+  {
+    return false;
+  }
+  if (end_ == 0)
+  {
+    uint32_t version = 0;
+    if (size >= HEADER_SIZE)
+    {
+      memcpy(&version, map_ + sizeof(kMagic), sizeof(version));
+    }
+    if ((version != VERSION) || memcmp(map_, kMagic, sizeof(kMagic)))
+    {
+      LOG(LOG_ERR, "%s is not a store", path_.c_str());
+      return false;
+    }
+    end_ = HEADER_SIZE;
+  }
+  while (end_ < size)
+  {
+    RecordHeader header;
+    bool valid = (size - end_ >= sizeof(header));
+    size_t record_size = 0;
+    if (valid)
+    {
+      memcpy(&header, map_ + end_, sizeof(header));
+      valid = (header.magic == RECORD_MAGIC) && (header.key_size <= size) &&
+        ((header.value_size == TOMBSTONE) || (header.value_size <= size));
+    }
+    if (valid)
+    {
+      record_size = RecordSize(header.key_size, header.value_size);
+      valid = (record_size <= size - end_);
+    }
+    const uint8_t *key = map_ + end_ + sizeof(header);
+    if (valid)
+    {
+      valid = (RecordCrc(header.key_size, header.value_size, key, key + header.key_size) == header.crc);
+    }
+    if (!valid)
+    {
+      // The tail of a write that did not complete; nobody else writes while the lock is held
+      LOG(LOG_WARN, "%s: dropping %zu bytes at %zu", path_.c_str(), size - end_, end_);
+      if (ftruncate(fd_, end_) < 0)
+      {
+        LOG(LOG_ERR, "ftruncate(%s) failed - %d", path_.c_str(), errno);
+        return false;
+      }
+      break;
+    }
+    std::string name((const char *) key, header.key_size);
+    std::unordered_map<std::string, Entry>::iterator it = index_.find(name);
+    if (it != index_.end())
+    {
+      live_bytes_ -= it->second.record_size;
+    }
+    if (header.value_size == TOMBSTONE)
+    {
+      if (it != index_.end())
+      {
+        index_.erase(it);
+      }
+    }
+    else
+    {
+      Entry entry = { end_ + sizeof(header) + header.key_size, header.value_size, record_size };
+      index_[name] = entry;
+      live_bytes_ += record_size;
+    }
+    end_ += record_size;
+  }
+  return true;
+}
+
+bool PersistentStore::Append(const std::string &key, const void *data, uint32_t size)
+{
+  RecordHeader header;
+  header.magic = RECORD_MAGIC;
+  header.key_size = key.size();
+  header.value_size = size;
+  header.crc = RecordCrc(header.key_size, header.value_size, key.data(), data);
+  size_t record_size = RecordSize(header.key_size, header.value_size);
+  std::vector<uint8_t> record(record_size, 0);
+  memcpy(&record[0], &header, sizeof(header));
+  memcpy(&record[sizeof(header)], key.data(), key.size());
+  if (size != TOMBSTONE)
+  {
+    memcpy(&record[sizeof(header) + key.size()], data, size);
+  }
+  if (!WriteAll(fd_, &record[0], record_size, end_) || (sync_ && fdatasync(fd_) < 0))
+  {
+    LOG(LOG_ERR, "write(%s) failed - %d", path_.c_str(), errno);
+    // A partial record is dropped by the next Scan()
+    return false;
+  }
+  // Indexed like the records of the other processes
+  return Scan();
+}
+
+bool PersistentStore::Get(const std::string &key, std::string &value)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!Lock())
+  {
+    return false;
+  }
+  std::unordered_map<std::string, Entry>::iterator it = index_.find(key);
+  bool found = (it != index_.end());
+  if (found)
+  {
+    value.assign((const char *) map_ + it->second.offset, it->second.size);
+  }
+  Unlock();
+  return found;
+}
+
+bool PersistentStore::Put(const std::string &key, const void *data, size_t size)
+{
+  if (size >= TOMBSTONE)
+  {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!Lock())
+  {
+    return false;
+  }
+  bool success = Append(key, data, size);
+  if (success && (end_ >= COMPACT_MIN_BYTES) && (end_ > 2 * (HEADER_SIZE + live_bytes_)))
+  {
+    CompactLocked();
+  }
+  Unlock();
+  return success;
+}
+
+bool PersistentStore::Remove(const std::string &key)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!Lock())
+  {
+    return false;
+  }
+  bool found = (index_.find(key) != index_.end());
+  if (found)
+  {
+    found = Append(key, NULL, TOMBSTONE);
+  }
+  Unlock();
+  return found;
+}
+
+bool PersistentStore::Compact()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!Lock())
+  {
+    return false;
+  }
+  bool success = CompactLocked();
+  Unlock();
+  return success;
+}
+
+// Called with the file locked.  On success the new file is open and indexed.
+bool PersistentStore::CompactLocked()
+{
+  std::string tmp = path_ + ".tmp";
+  int fd = open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0)
+  {
+    LOG(LOG_ERR, "open(%s) failed - %d", tmp.c_str(), errno);
+    return false;
+  }
+  std::vector<uint8_t> out(HEADER_SIZE + live_bytes_, 0);
+  memcpy(&out[0], map_, HEADER_SIZE);
+  size_t n = HEADER_SIZE;
+  for (auto &entry : index_)
+  {
+    // Records are copied whole, so their crc still holds
+    memcpy(&out[n], map_ + entry.second.offset - sizeof(RecordHeader) - entry.first.size(),
+        entry.second.record_size);
+    n += entry.second.record_size;
+  }
+  // Whatever sync_ says, the old records are only dropped once the new ones are
+  // on the disk
+  if (!WriteAll(fd, &out[0], n, 0) || (fsync(fd) < 0))
+  {
+    LOG(LOG_ERR, "write(%s) failed - %d", tmp.c_str(), errno);
+    close(fd);
+    unlink(tmp.c_str());
+    return false;
+  }
+  // The lock is taken before the rename, so nobody appends to the new file
+  // before it is indexed
+  flock(fd, LOCK_EX);
+  if (rename(tmp.c_str(), path_.c_str()) < 0)
+  {
+    LOG(LOG_ERR, "rename(%s) failed - %d", tmp.c_str(), errno);
+    close(fd);
+    unlink(tmp.c_str());
+    return false;
+  }
+  if (!SyncDirectory(path_))
+  {
+    LOG(LOG_WARN, "fsync(%s) directory failed - %d", path_.c_str(), errno);
+  }
+  LOG(LOG_INFO, "%s: compacted %zu bytes to %zu", path_.c_str(), end_, n);
+  Unlock();
+  CloseFile();
+  fd_ = fd;
+  struct stat st;
+  if (fstat(fd_, &st) < 0)
+  {
+    CloseFile();
+    return false;
+  }
+  ino_ = st.st_ino;
+  return Scan();
+}
+
+size_t PersistentStore::GetLiveBytes()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!Lock())
+  {
+    return 0;
+  }
+  size_t size = live_bytes_;
+  Unlock();
+  return size;
+}
+
+size_t PersistentStore::GetFileBytes()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!Lock())
+  {
+    return 0;
+  }
+  size_t size = end_;
+  Unlock();
+  return size;
+}
+
+struct Stream
+{
+  PersistentStore *store;
+  std::string key;
+  std::string data;
+  size_t pos;
+  bool write;
+  bool append;
+};
+
+static ssize_t StreamRead(void *cookie, char *buf, size_t size)
+{
+  Stream *stream = (Stream *) cookie;
+  if (stream->pos >= stream->data.size())
+  {
+    return 0;
+  }
+  size_t n = std::min(size, stream->data.size() - stream->pos);
+  memcpy(buf, stream->data.data() + stream->pos, n);
+  stream->pos += n;
+  return n;
+}
+
+static ssize_t StreamWrite(void *cookie, const char *buf, size_t size)
+{
+  Stream *stream = (Stream *) cookie;
+  if (!stream->write)
+  {
+    errno = EBADF;
+    return -1;
+  }
+  if (stream->append)
+  {
+    stream->pos = stream->data.size();
+  }
+  if (stream->pos > stream->data.size())
+  {
+    stream->data.resize(stream->pos, '\0');
+  }
+  stream->data.replace(stream->pos, std::min(size, stream->data.size() - stream->pos), buf, size);
+  stream->pos += size;
+  return size;
+}
+
+static int StreamSeek(void *cookie, off64_t *offset, int whence)
+{
+  Stream *stream = (Stream *) cookie;
+  off64_t base;
+  switch (whence)
+  {
+    case SEEK_SET:
+      base = 0;
+      break;
+    case SEEK_CUR:
+      base = stream->pos;
+      break;
+    case SEEK_END:
+      base = stream->data.size();
+      break;
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+  if (base + *offset < 0)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+  stream->pos = base + *offset;
+  *offset = stream->pos;
+  return 0;
+}
+
+static int StreamClose(void *cookie)
+{
+  Stream *stream = (Stream *) cookie;
+  bool success = !stream->write || stream->store->Put(stream->key, stream->data.data(), stream->data.size());
+  delete stream;
+  return success ? 0 : EOF;
+}
+
+FILE *PersistentStore::OpenStream(const std::string &key, const char *mode)
+{
+  if (!mode || !strchr("rwa", mode[0]))
+  {
+    errno = EINVAL;
+    return NULL;
+  }
+  Stream *stream = new Stream();
+  stream->store = this;
+  stream->key = key;
+  stream->pos = 0;
+  stream->write = (mode[0] != 'r') || strchr(mode, '+');
+  stream->append = (mode[0] == 'a');
+  if ((mode[0] != 'w') && !Get(key, stream->data) && (mode[0] == 'r'))
+  {
+    delete stream;
+    errno = ENOENT;
+    return NULL;
+  }
+  cookie_io_functions_t functions = { StreamRead, StreamWrite, StreamSeek, StreamClose };
+  FILE *file = fopencookie(stream, mode, functions);
+  if (!file)
+  {
+    delete stream;
+  }
+  return file;
+}
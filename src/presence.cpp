@@ -3,8 +3,15 @@
 #include "log.h"
 #include <string>
 
-HFPresence::HFPresence(uint16_t address)
-  : Presence(std::to_string(address)), last_tick_(time(NULL))
+const time_t Presence::NEVER;
+
+const time_t HFPresence::KEEP_ALIVE_SECS;
+const time_t HFPresence::MIN_TIMEOUT_SECS;
+const time_t HFPresence::MAX_TIMEOUT_SECS;
+
+HFPresence::HFPresence(uint16_t address, time_t keep_alive_secs)
+  : Presence(std::to_string(address)), address_(address), last_tick_(0),
+    interval_secs_(keep_alive_secs)
 {
   LOG(LOG_DEBUG, "[%p]", this);
 }
@@ -14,19 +21,33 @@ HFPresence::~HFPresence()
   LOG(LOG_DEBUG, "[%p]", this);
 }
 
-bool HFPresence::IsPresent()
+time_t HFPresence::Seen(time_t now)
 {
-  return true;
+  if (last_tick_ && (now > last_tick_))
+  {
+    /* Bursts within the same second are not a reporting interval. */
+    interval_secs_ = ((interval_secs_ * 7) + (now - last_tick_)) / 8;
+  }
+  last_tick_ = now;
+  return now + GetTimeout();
 }
 
-void HFPresence::Seen()
+time_t HFPresence::GetTimeout() const
 {
-  std::lock_guard<std::mutex> lock(mutex_);
-  last_tick_ = time(NULL);
+  time_t timeout = interval_secs_ * RETRIES;
+  if (timeout < MIN_TIMEOUT_SECS)
+  {
+    timeout = MIN_TIMEOUT_SECS;
+  }
+  else if (timeout > MAX_TIMEOUT_SECS)
+  {
+    timeout = MAX_TIMEOUT_SECS;
+  }
+  return timeout;
 }
 
-OCPresence::OCPresence(const char *di, time_t period_secs)
-  : Presence(di), period_secs_(period_secs), last_tick_(time(NULL))
+OCPresence::OCPresence(const char *di, time_t period)
+  : Presence(di), period_(period)
 {
   LOG(LOG_DEBUG, "[%p]", this);
 }
@@ -36,14 +57,106 @@ OCPresence::~OCPresence()
   LOG(LOG_DEBUG, "[%p]", this);
 }
 
-bool OCPresence::IsPresent()
+time_t OCPresence::Seen(time_t now)
+{
+    return now + (period_ * RETRIES);
+}
+
+PresenceTable::~PresenceTable()
+{
+  Clear();
+}
+
+void PresenceTable::Schedule(Entry &entry, time_t deadline)
+{
+  if (entry.deadline != deadlines_.end())
+  {
+    if (entry.deadline->first == deadline)
+    {
+      return;
+    }
+    deadlines_.erase(entry.deadline);
+  }
+  if (deadline == Presence::NEVER)
+  {
+    entry.deadline = deadlines_.end();
+  }
+  else
+  {
+    /* Deadlines mostly grow monotonically, so hint at the end. */
+    entry.deadline = deadlines_.insert(deadlines_.end(), std::make_pair(deadline, entry.presence));
+  }
+}
+
+bool PresenceTable::Add(Presence *presence, time_t now)
+{
+  Entry entry;
+  entry.presence = presence;
+  entry.deadline = deadlines_.end();
+  auto inserted = entries_.insert(std::make_pair(presence->GetId(), entry));
+  if (!inserted.second)
+  {
+    return false;
+  }
+  Schedule(inserted.first->second, presence->Seen(now));
+  return true;
+}
+
+bool PresenceTable::Remove(const std::string &id)
+{
+  auto it = entries_.find(id);
+  if (it == entries_.end())
+  {
+    return false;
+  }
+  if (it->second.deadline != deadlines_.end())
+  {
+    deadlines_.erase(it->second.deadline);
+  }
+  delete it->second.presence;
+  entries_.erase(it);
+  return true;
+}
+
+bool PresenceTable::Seen(const std::string &id, time_t now)
+{
+  auto it = entries_.find(id);
+  if (it == entries_.end())
+  {
+    return false;
+  }
+  Schedule(it->second, it->second.presence->Seen(now));
+  return true;
+}
+
+bool PresenceTable::Contains(const std::string &id) const
+{
+  return entries_.find(id) != entries_.end();
+}
+
+void PresenceTable::Expire(time_t now, std::vector<std::string> &expired)
+{
+  while (!deadlines_.empty() && deadlines_.begin()->first < now)
+  {
+    Presence *presence = deadlines_.begin()->second;
+    deadlines_.erase(deadlines_.begin());
+    expired.push_back(presence->GetId());
+    entries_.erase(presence->GetId());
+    delete presence;
+  }
+}
+
+time_t PresenceTable::NextDeadline() const
 {
-  std::lock_guard<std::mutex> lock(mutex_);
-  return (time(NULL) - last_tick_) <= (period_secs_ * RETRIES);
+  return deadlines_.empty() ? Presence::NEVER : deadlines_.begin()->first;
 }
 
-void OCPresence::Seen()
+void PresenceTable::Clear()
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    last_tick_ = time(NULL);
+  for (auto &e : entries_)
+  {
+    delete e.second.presence;
+  }
+  entries_.clear();
+  deadlines_.clear();
 }
@@ -4,52 +4,111 @@
 #include "cacommon.h"
 #include "octypes.h"
 #include <inttypes.h>
-#include <mutex>
+#include <map>
 #include <string>
 #include <time.h>
+#include <unordered_map>
+#include <vector>
 
 class Presence
 {
   public:
+    /* Returned by Seen() when the device never lapses on its own. */
+    static const time_t NEVER = 0;
+
     Presence(const std::string &id) : id_(id) { }
     virtual ~Presence() { }
-    virtual bool IsPresent() = 0;
-    virtual void Seen() = 0;
-    virtual std::string GetId() const { return id_; }
+    /* Records activity at now and returns the time after which the device is absent. */
+    virtual time_t Seen(time_t now) = 0;
+    const std::string &GetId() const { return id_; }
 
   private:
     std::string id_;
 };
 
+/*
+ * A HAN-FUN device lapses after missing RETRIES of its reporting intervals.  The
+ * interval is learned from the gaps between sightings, starting from the DECT ULE
+ * keep-alive period.
+ */
 class HFPresence : public Presence
 {
   public:
-    HFPresence(uint16_t address);
+    static const time_t KEEP_ALIVE_SECS = 60;
+
+    HFPresence(uint16_t address, time_t keep_alive_secs = KEEP_ALIVE_SECS);
     virtual ~HFPresence();
 
-    virtual bool IsPresent();
-    virtual void Seen();
+    /*
+     * Devices that report more often than the device table is synced are still
+     * kept for three syncs, so a lost sync reply does not expire them.
+     */
+    static const time_t MIN_TIMEOUT_SECS = 90;
+
+    virtual time_t Seen(time_t now);
+    uint16_t GetAddress() const { return address_; }
+    time_t GetTimeout() const;
 
   private:
-    std::mutex mutex_;
+    static const uint8_t RETRIES = 3;
+    static const time_t MAX_TIMEOUT_SECS = 3600;
+
+    const uint16_t address_;
     time_t last_tick_;
+    time_t interval_secs_;
 };
 
+/* An OCF device lapses after missing RETRIES periods, in the units of the table's clock. */
 class OCPresence : public Presence
 {
     public:
-        OCPresence(const char *di, time_t period_secs);
+        OCPresence(const char *di, time_t period);
         virtual ~OCPresence();
 
-        virtual bool IsPresent();
-        virtual void Seen();
+        virtual time_t Seen(time_t now);
 
     private:
         static const uint8_t RETRIES = 3;
 
-        const time_t period_secs_;
-        std::mutex mutex_;
-        time_t last_tick_;
+        const time_t period_;
+};
+
+/*
+ * Owns the tracked Presence objects, indexed by id and ordered by deadline so
+ * that only the devices which actually lapse are visited on each tick.
+ */
+class PresenceTable
+{
+  public:
+    PresenceTable() { }
+    ~PresenceTable();
+
+    /* Takes ownership of presence.  Returns false if its id is already tracked. */
+    bool Add(Presence *presence, time_t now);
+    bool Remove(const std::string &id);
+    bool Seen(const std::string &id, time_t now);
+    bool Contains(const std::string &id) const;
+    /* Removes the devices whose deadline is before now, returning their ids. */
+    void Expire(time_t now, std::vector<std::string> &expired);
+    /* Returns the earliest deadline, or Presence::NEVER when nothing can lapse. */
+    time_t NextDeadline() const;
+    size_t Size() const { return entries_.size(); }
+    void Clear();
+
+  private:
+    typedef std::multimap<time_t, Presence *> Deadlines;
+    struct Entry
+    {
+      Presence *presence;
+      Deadlines::iterator deadline;
+    };
+    std::unordered_map<std::string, Entry> entries_;
+    Deadlines deadlines_;
+
+    void Schedule(Entry &entry, time_t deadline);
+
+    PresenceTable(const PresenceTable &);
+    PresenceTable &operator=(const PresenceTable &);
 };
 
 #endif
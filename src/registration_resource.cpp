@@ -25,15 +25,15 @@
 #include "ocpayload.h"
 #include "ocstack.h"
 
-RegistrationResource::RegistrationResource(std::mutex &mutex, HanClient &han_client)
-  : mutex_(mutex), han_client_(han_client), open_(false), handle_(NULL)
+RegistrationResource::RegistrationResource(std::mutex &hf_mutex, HanClient &han_client)
+  : hf_mutex_(hf_mutex), han_client_(han_client), open_(false), timeout_(0), handle_(NULL)
 {
 
 }
 
 RegistrationResource::~RegistrationResource()
 {
-  OCDeleteResource(handle_);
+  DeleteResource(handle_);
 }
 
 OCStackResult RegistrationResource::Create()
@@ -43,36 +43,28 @@ OCStackResult RegistrationResource::Create()
           OC_DISCOVERABLE | OC_OBSERVABLE | OC_SECURE);
 }
 
-/* Called with mutex_ held. */
-OCRepPayload *RegistrationResource::GetRegistration(OCEntityHandlerRequest *request)
+OCRepPayload *RegistrationResource::GetRegistration(OCResourceHandle handle,
+        const QueryView &query, PayloadArena &arena)
 {
-  OCRepPayload *payload = CreatePayload(request->resource, request->query);
-  if (!OCRepPayloadSetPropBool(payload, "open", open_))
+  static const char *resource_types[] = { OC_RSRVD_RESOURCE_TYPE_REGISTRATION };
+  static const char *interfaces[] = { OC_RSRVD_INTERFACE_READ_WRITE };
+  OCRepPayload *payload = CreatePayload(handle, query, arena);
+  if (!OCRepPayloadSetPropBool(payload, "open", open_) ||
+      !arena.SetStringArray(payload, OC_RSRVD_RESOURCE_TYPE, resource_types, 1) ||
+      !arena.SetStringArray(payload, OC_RSRVD_INTERFACE, interfaces, 1))
   {
-    OCRepPayloadDestroy(payload);
-    payload = NULL;
-  }
-  size_t dimensions[MAX_REP_ARRAY_DEPTH] = { 0 };
-  dimensions[0] = 1;
-  const char** resource_type = new const char*[dimensions[0]];
-  resource_type[0] = OC_RSRVD_RESOURCE_TYPE_REGISTRATION;
-  if (!OCRepPayloadSetStringArray(payload, OC_RSRVD_RESOURCE_TYPE,
-                                  resource_type, dimensions))
-  {
-    OCRepPayloadDestroy(payload);
-    payload = NULL;
-  }
-  const char** interfaces = new const char*[dimensions[0]];
-  interfaces[0] = OC_RSRVD_INTERFACE_READ_WRITE;
-  if (!OCRepPayloadSetStringArray(payload, OC_RSRVD_INTERFACE,
-                                  interfaces, dimensions))
-  {
-    OCRepPayloadDestroy(payload);
+    arena.Destroy(payload);
     payload = NULL;
   }
   return payload;
 }
 
+OCRepPayload *RegistrationResource::CreateNotification(OCResourceHandle handle, PayloadArena &arena)
+{
+  return GetRegistration(handle, QueryView(NULL), arena);
+}
+
+/* Called with hf_mutex_ held. */
 void RegistrationResource::HFSetRegistration()
 {
   if (open_)
@@ -85,7 +77,6 @@ void RegistrationResource::HFSetRegistration()
   }
 }
 
-/* Called with mutex_ held. */
 bool RegistrationResource::PostRegistration(OCEntityHandlerRequest *request, bool &has_changed)
 {
   OCRepPayload *payload = (OCRepPayload *) request->payload;
@@ -94,8 +85,9 @@ bool RegistrationResource::PostRegistration(OCEntityHandlerRequest *request, boo
   {
     return false;
   }
-  has_changed = (open_ != open);
-  SetOpen(open);
+  // The HAN-FUN side must end up in the state of the last POST
+  std::lock_guard<std::mutex> lock(hf_mutex_);
+  has_changed = (open_.exchange(open) != open);
   HFSetRegistration();
   return true;
 }
@@ -104,14 +96,15 @@ OCEntityHandlerResult RegistrationResource::EntityHandlerCB(OCEntityHandlerFlag
         OCEntityHandlerRequest *request, void *ctx)
 {
   LOG(LOG_DEBUG, "[%p] flag=%x,request=%p,ctx=%p", ctx, flag, request, ctx);
-  if (!IsValidRequest(request))
+  QueryView query(request->query);
+  if (!IsValidRequest(request, query))
   {
     LOG(LOG_WARN, "Invalid request received");
     return OC_EH_BAD_REQ;
   }
 
   RegistrationResource *thiz = reinterpret_cast<RegistrationResource *>(ctx);
-  thiz->mutex_.lock();
+  thiz->Observe(flag, request);
   bool has_changed = false;
   OCEntityHandlerResult result;
   switch (request->method)
@@ -122,7 +115,8 @@ OCEntityHandlerResult RegistrationResource::EntityHandlerCB(OCEntityHandlerFlag
         memset(&response, 0, sizeof(response));
         response.requestHandle = request->requestHandle;
         response.resourceHandle = request->resource;
-        OCRepPayload *payload = thiz->GetRegistration(request);
+        PayloadArena arena;
+        OCRepPayload *payload = thiz->GetRegistration(request->resource, query, arena);
         if (!payload)
         {
           result = OC_EH_ERROR;
@@ -135,8 +129,8 @@ OCEntityHandlerResult RegistrationResource::EntityHandlerCB(OCEntityHandlerFlag
         if (do_result != OC_STACK_OK)
         {
           LOG(LOG_ERR, "OCDoResponse - %d", do_result);
-          OCRepPayloadDestroy(payload);
         }
+        arena.Destroy(payload);
         break;
       }
     case OC_REST_POST:
@@ -155,7 +149,8 @@ OCEntityHandlerResult RegistrationResource::EntityHandlerCB(OCEntityHandlerFlag
         memset(&response, 0, sizeof(response));
         response.requestHandle = request->requestHandle;
         response.resourceHandle = request->resource;
-        OCRepPayload *out_payload = thiz->GetRegistration(request);
+        PayloadArena arena;
+        OCRepPayload *out_payload = thiz->GetRegistration(request->resource, query, arena);
         result = OC_EH_OK;
         response.ehResult = result;
         response.payload = reinterpret_cast<OCPayload *>(out_payload);
@@ -163,7 +158,11 @@ OCEntityHandlerResult RegistrationResource::EntityHandlerCB(OCEntityHandlerFlag
         if (do_result != OC_STACK_OK)
         {
           LOG(LOG_ERR, "OCDoResponse - %d", do_result);
-          OCRepPayloadDestroy(out_payload);
+        }
+        arena.Destroy(out_payload);
+        if (has_changed)
+        {
+          thiz->Notify(request->resource);
         }
         break;
       }
@@ -171,10 +170,5 @@ OCEntityHandlerResult RegistrationResource::EntityHandlerCB(OCEntityHandlerFlag
       result = OC_EH_METHOD_NOT_ALLOWED;
       break;
   }
-  thiz->mutex_.unlock();
-  if (has_changed)
-  {
-    OCNotifyAllObservers(request->resource, OC_NA_QOS);
-  }
   return result;
 }
\ No newline at end of file
@@ -22,19 +22,24 @@
 #define _REGISTRATIONRESOURCE_H
 
 #include "octypes.h"
+#include <atomic>
 #include <mutex>
 
 #include "han_client.h"
+#include "observable_resource.h"
+
+class PayloadArena;
+class QueryView;
 
 /** To represent registration resource type.*/
 #define OC_RSRVD_RESOURCE_TYPE_REGISTRATION "oic.r.registration"
 
 #define OC_RSRVD_REGISTRATION_URI "/registration"
 
-class RegistrationResource
+class RegistrationResource : public ObservableResource
 {
   public:
-    RegistrationResource(std::mutex &mutex, HanClient &han_client);
+    RegistrationResource(std::mutex &hf_mutex, HanClient &han_client);
     ~RegistrationResource();
     OCStackResult Create();
     bool IsOpen() const { return open_; }
@@ -43,13 +48,15 @@ class RegistrationResource
     void SetTimeout(uint8_t timeout) { timeout_ = timeout; }
 
   private:
-    std::mutex &mutex_;
+    std::mutex &hf_mutex_;
     HanClient &han_client_;
-    bool open_;
-    uint8_t timeout_;
+    std::atomic<bool> open_;
+    std::atomic<uint8_t> timeout_;
     OCResourceHandle handle_;
 
-    OCRepPayload *GetRegistration(OCEntityHandlerRequest *request);
+    OCRepPayload *GetRegistration(OCResourceHandle handle, const QueryView &query,
+            PayloadArena &arena);
+    virtual OCRepPayload *CreateNotification(OCResourceHandle handle, PayloadArena &arena);
     bool PostRegistration(OCEntityHandlerRequest *request, bool &has_changed);
     void HFSetRegistration();
     static OCEntityHandlerResult EntityHandlerCB(OCEntityHandlerFlag flag,
@@ -21,14 +21,212 @@
 #include "resource.h"
 
 #include "log.h"
+#include "metrics.h"
+#include "trace.h"
 
 #include "oic_malloc.h"
 #include "oic_string.h"
 #include "ocpayload.h"
 #include "ocstack.h"
 #include <assert.h>
+#include <mutex>
+#include <unordered_map>
 
-#define INTERFACE_DEFAULT_QUERY "if=" OC_RSRVD_INTERFACE_DEFAULT
+/* A string array flattened into one buffer so that it can be copied in one go. */
+struct StringFragment
+{
+    std::string blob;
+    std::vector<size_t> offsets;
+
+    void Add(const char *str)
+    {
+        offsets.push_back(blob.size());
+        blob.append(str ? str : "");
+        blob.push_back('\0');
+    }
+};
+
+/* The rt, if and links of a hosted resource, which only change through the wrappers below. */
+struct ResourceFragments
+{
+    StringFragment uri;
+    StringFragment rts;
+    StringFragment ifs;
+    std::vector<OCResourceHandle> links;
+};
+
+static std::mutex s_fragmentsMutex;
+static std::unordered_map<OCResourceHandle, ResourceFragments> s_fragments;
+
+static const OCRepPayloadValue *FindValue(const OCRepPayload *payload, const char *name,
+        OCRepPayloadPropType type)
+{
+    for (const OCRepPayloadValue *value = payload->values; value; value = value->next)
+    {
+        if (!strcmp(value->name, name))
+        {
+            return (value->type == type) ? value : NULL;
+        }
+    }
+    return NULL;
+}
+
+/* Returns the value of a string property without copying it. */
+static const char *FindString(const OCRepPayload *payload, const char *name)
+{
+    const OCRepPayloadValue *value = FindValue(payload, name, OCREP_PROP_STRING);
+    return value ? value->str : NULL;
+}
+
+/* Copies an address, turning the "%25" that escapes an IPv6 scope id back into '%'. */
+static bool CopyAddr(char *dst, size_t dstSize, const char *src, size_t srcLen, bool isV6)
+{
+    size_t j = 0;
+    for (size_t i = 0; i < srcLen; ++i)
+    {
+        if (j + 1 >= dstSize)
+        {
+            dst[j] = '\0';
+            return false;
+        }
+        dst[j++] = src[i];
+        if (isV6 && (src[i] == '%') && (i + 2 < srcLen) && (src[i + 1] == '2') && (src[i + 2] == '5'))
+        {
+            i += 2;
+        }
+    }
+    dst[j] = '\0';
+    return true;
+}
+
+struct Endpoint
+{
+    StringView tps;
+    StringView host;
+    OCTransportAdapter adapter;
+    OCTransportFlags flags;
+    uint16_t port;
+};
+
+/* Returns false for a scheme the bridge has no transport for. */
+static bool ParseTps(StringView tps, OCTransportAdapter *adapter, OCTransportFlags *flags)
+{
+    if (tps == "coap")
+    {
+        *adapter = OC_ADAPTER_IP;
+        *flags = OC_DEFAULT_FLAGS;
+    }
+    else if (tps == "coaps")
+    {
+        *adapter = OC_ADAPTER_IP;
+        *flags = OC_FLAG_SECURE;
+    }
+    else if (tps == "coap+tcp")
+    {
+        *adapter = OC_ADAPTER_TCP;
+        *flags = OC_DEFAULT_FLAGS;
+    }
+    else if (tps == "coaps+tcp")
+    {
+        *adapter = OC_ADAPTER_TCP;
+        *flags = OC_FLAG_SECURE;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+/* Splits "tps://host:port" in place; an IPv6 host is given without its brackets. */
+static bool ParseEndpoint(const char *str, Endpoint *ep)
+{
+    const char *sep = strstr(str, "://");
+    if (!sep)
+    {
+        return false;
+    }
+    ep->tps = StringView(str, sep - str);
+    if (!ParseTps(ep->tps, &ep->adapter, &ep->flags))
+    {
+        return false;
+    }
+    const char *p = sep + 3;
+    if (*p == '[')
+    {
+        const char *end = strchr(++p, ']');
+        if (!end)
+        {
+            return false;
+        }
+        ep->host = StringView(p, end - p);
+        ep->flags = (OCTransportFlags) (ep->flags | OC_IP_USE_V6);
+        p = end + 1;
+    }
+    else
+    {
+        size_t n = strcspn(p, ":");
+        ep->host = StringView(p, n);
+        ep->flags = (OCTransportFlags) (ep->flags | OC_IP_USE_V4);
+        p += n;
+    }
+    if (!ep->host.len)
+    {
+        return false;
+    }
+    ep->port = 0;
+    if (*p == ':')
+    {
+        uint32_t port = 0;
+        if (!*++p)
+        {
+            return false;
+        }
+        for (; *p; ++p)
+        {
+            if ((*p < '0') || (*p > '9') || ((port = (port * 10) + (*p - '0')) > UINT16_MAX))
+            {
+                return false;
+            }
+        }
+        ep->port = (uint16_t) port;
+    }
+    return *p == '\0';
+}
+
+static bool ToDevAddr(const Endpoint &ep, OCDevAddr *addr)
+{
+    addr->adapter = ep.adapter;
+    addr->flags = ep.flags;
+    addr->port = ep.port;
+    addr->ifindex = 0;
+    addr->routeData[0] = '\0';
+    addr->remoteId[0] = '\0';
+    return CopyAddr(addr->addr, sizeof(addr->addr), ep.host.str, ep.host.len,
+            ep.flags & OC_IP_USE_V6);
+}
+
+bool ParseEndpoint(const char *str, OCDevAddr *addr)
+{
+    Endpoint ep;
+    return ParseEndpoint(str, &ep) && ToDevAddr(ep, addr);
+}
+
+/* The stack has already split a discovered endpoint, so only its scheme is parsed here. */
+static bool ParseEndpoint(const OCEndpointPayload *payload, OCDevAddr *addr)
+{
+    Endpoint ep;
+    OCTransportFlags flags;
+    if (!payload->tps || !payload->addr ||
+            !ParseTps(StringView(payload->tps, strlen(payload->tps)), &ep.adapter, &flags))
+    {
+        return false;
+    }
+    ep.host = StringView(payload->addr, strlen(payload->addr));
+    ep.flags = payload->family;
+    ep.port = payload->port;
+    return ToDevAddr(ep, addr);
+}
 
 static std::vector<OCDevAddr> GetDevAddrs(OCDevAddr origin, const char *di,
         OCResourcePayload *resource)
@@ -48,57 +246,110 @@ static std::vector<OCDevAddr> GetDevAddrs(OCDevAddr origin, const char *di,
 #endif
     }
     std::vector<OCDevAddr> addrs;
-    if (!resource->eps)
-    {
-        addrs.push_back(origin);
-    }
     for (const OCEndpointPayload *ep = resource->eps; ep; ep = ep->next)
     {
         OCDevAddr addr;
-        if (!strcmp(ep->tps, "coap") || !strcmp(ep->tps, "coaps"))
+        if (!ParseEndpoint(ep, &addr))
         {
-            addr.adapter = OC_ADAPTER_IP;
+            LOG(LOG_INFO, "Skipping endpoint tps=%s,addr=%s", ep->tps ? ep->tps : "(null)",
+                    ep->addr ? ep->addr : "(null)");
+            continue;
         }
-        else if (!strcmp(ep->tps, "coap+tcp") || !strcmp(ep->tps, "coaps+tcp"))
+        strncpy(addr.remoteId, di, MAX_IDENTITY_SIZE);
+        addrs.push_back(addr);
+    }
+    if (addrs.empty())
+    {
+        addrs.push_back(origin);
+    }
+    return addrs;
+}
+
+static void Intern(std::vector<Symbol> &symbols, OCStringLL *strs)
+{
+    size_t n = 0;
+    for (OCStringLL *str = strs; str; str = str->next)
+    {
+        ++n;
+    }
+    symbols.reserve(n);
+    for (OCStringLL *str = strs; str; str = str->next)
+    {
+        Symbol symbol = Symbols::Intern(str->value);
+        if (symbol != Symbols::NONE)
         {
-            addr.adapter = OC_ADAPTER_TCP;
+            symbols.push_back(symbol);
         }
-        addr.flags = ep->family;
-        addr.port = ep->port;
-        memset(addr.addr, 0, MAX_ADDR_STR_SIZE);
-        for (size_t i = 0, j = 0; (i < MAX_ADDR_STR_SIZE) && ep->addr[i]; ++i, ++j)
+        else
         {
-            addr.addr[j] = ep->addr[i];
-            if (addr.flags & OC_IP_USE_V6 && !strncmp(&ep->addr[i], "%25", 3))
-            {
-                i += 2;
-            }
+            LOG(LOG_ERR, "Symbols::Intern(%s) failed", str->value);
         }
-        addr.ifindex = 0;
-        addr.routeData[0] = '\0';
-        strncpy(addr.remoteId, di, MAX_IDENTITY_SIZE);
-        addrs.push_back(addr);
     }
-    return addrs;
 }
 
-Resource::Resource(OCDevAddr origin, const char *di, OCResourcePayload *resource)
-    : uri_(resource->uri), is_observable_(resource->bitmap & OC_OBSERVABLE)
+static bool IsSameDevAddrs(const std::vector<OCDevAddr> &a, const std::vector<OCDevAddr> &b)
 {
-    for (OCStringLL *ifc = resource->interfaces; ifc; ifc = ifc->next)
+    if (a.size() != b.size())
     {
-        ifs_.push_back(ifc->value);
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if ((a[i].adapter != b[i].adapter) || (a[i].flags != b[i].flags) ||
+                (a[i].port != b[i].port) || (a[i].ifindex != b[i].ifindex) ||
+                strncmp(a[i].addr, b[i].addr, sizeof(a[i].addr)) ||
+                strncmp(a[i].routeData, b[i].routeData, sizeof(a[i].routeData)) ||
+                strncmp(a[i].remoteId, b[i].remoteId, sizeof(a[i].remoteId)))
+        {
+            return false;
+        }
     }
-    for (OCStringLL *type = resource->types; type; type = type->next)
+    return true;
+}
+
+Resource::Resource(OCDevAddr origin, const char *di, OCResourcePayload *resource)
+    : uri_(resource->uri), is_observable_(resource->bitmap & OC_OBSERVABLE),
+    addrs_(std::make_shared<const std::vector<OCDevAddr>>(GetDevAddrs(origin, di, resource)))
+{
+    Intern(ifs_, resource->interfaces);
+    Intern(rts_, resource->types);
+}
+
+Resource::Resource(const Resource &other)
+    : uri_(other.uri_), ifs_(other.ifs_), rts_(other.rts_), is_observable_(other.is_observable_),
+    resources_(other.resources_), addrs_(other.addrs_)
+{
+    Symbols::Acquire(ifs_);
+    Symbols::Acquire(rts_);
+}
+
+Resource &Resource::operator=(const Resource &other)
+{
+    if (this != &other)
     {
-        rts_.push_back(type->value);
+        Symbols::Acquire(other.ifs_);
+        Symbols::Acquire(other.rts_);
+        Symbols::Release(ifs_);
+        Symbols::Release(rts_);
+        uri_ = other.uri_;
+        ifs_ = other.ifs_;
+        rts_ = other.rts_;
+        is_observable_ = other.is_observable_;
+        resources_ = other.resources_;
+        addrs_ = other.addrs_;
     }
-    addrs_ = GetDevAddrs(origin, di, resource);
+    return *this;
+}
+
+Resource::~Resource()
+{
+    Symbols::Release(ifs_);
+    Symbols::Release(rts_);
 }
 
 bool Resource::IsSecure()
 {
-    for (auto &addr : addrs_)
+    for (auto &addr : *addrs_)
     {
         if (addr.flags & OC_FLAG_SECURE)
         {
@@ -111,10 +362,30 @@ bool Resource::IsSecure()
 Device::Device(OCDevAddr origin, OCDiscoveryPayload *payload)
     : di_(payload->sid)
 {
+    size_t n = 0;
+    for (OCResourcePayload *resource = (OCResourcePayload *) payload->resources; resource;
+         resource = resource->next)
+    {
+        ++n;
+    }
+    resources_.reserve(n);
+    std::vector<std::shared_ptr<const std::vector<OCDevAddr>>> addrs;
     for (OCResourcePayload *resource = (OCResourcePayload *) payload->resources; resource;
          resource = resource->next)
     {
         resources_.push_back(Resource(origin, payload->sid, resource));
+        Resource &added = resources_.back();
+        auto it = std::find_if(addrs.begin(), addrs.end(),
+                [&added](std::shared_ptr<const std::vector<OCDevAddr>> &a) -> bool
+                {return IsSameDevAddrs(*a, *added.addrs_);});
+        if (it != addrs.end())
+        {
+            added.addrs_ = *it;
+        }
+        else
+        {
+            addrs.push_back(added.addrs_);
+        }
     }
 }
 
@@ -147,77 +418,84 @@ bool Device::IsVirtual()
     Resource *resource = GetResourceUri(OC_RSRVD_DEVICE_URI);
     if (resource)
     {
-        return HasResourceType(resource->rts_, "oic.d.virtual");
+        static const Symbol virtualType = Symbols::Intern("oic.d.virtual");
+        return HasResourceType(resource->rts_, virtualType);
     }
     return false;
 }
 
 bool Device::SetCollectionLinks(std::string collectionUri, OCRepPayload *payload)
 {
-    bool success = false;
-    size_t dim[MAX_REP_ARRAY_DEPTH] = { 0 };
-    size_t dimTotal;
-    OCRepPayload **links = NULL;
-    std::vector<Resource>::iterator collection = FindResourceFromUri(resources_, collectionUri);
-    assert(collection != resources_.end());
-    if (OCRepPayloadGetPropObjectArray(payload, OC_RSRVD_LINKS, &links, dim))
-    {
-        dimTotal = calcDimTotal(dim);
-    }
-    else
+    std::vector<const char *> hrefs;
+    const OCRepPayloadValue *links = FindValue(payload, OC_RSRVD_LINKS, OCREP_PROP_ARRAY);
+    if (links && (links->arr.type == OCREP_PROP_OBJECT))
     {
-        for (OCRepPayload *p = payload; p; p = p->next)
-        {
-            ++dim[0];
-        }
-        links = (OCRepPayload **) OICCalloc(dim[0], sizeof(OCRepPayload*));
-        if (!links)
-        {
-            goto exit;
-        }
-        dimTotal = calcDimTotal(dim);
-        OCRepPayload *p = payload;
+        size_t dimTotal = calcDimTotal(links->arr.dimensions);
+        hrefs.reserve(dimTotal);
         for (size_t i = 0; i < dimTotal; ++i)
         {
-            links[i] = OCRepPayloadClone(p);
-            p = p->next;
+            const char *href = FindString(links->arr.objArray[i], OC_RSRVD_HREF);
+            hrefs.push_back(href ? href : links->arr.objArray[i]->uri);
         }
     }
-    for (size_t i = 0; i < dimTotal; ++i)
+    else
     {
-        char *href = NULL;
-        if (!OCRepPayloadGetPropString(links[i], OC_RSRVD_HREF, &href))
+        for (const OCRepPayload *p = payload; p; p = p->next)
         {
-            href = OICStrdup(links[i]->uri);
+            const char *href = FindString(p, OC_RSRVD_HREF);
+            hrefs.push_back(href ? href : p->uri);
         }
+    }
+
+    std::unordered_map<std::string, size_t> index;
+    index.reserve(resources_.size());
+    for (size_t i = 0; i < resources_.size(); ++i)
+    {
+        index.insert(std::make_pair(resources_[i].uri_, i));
+    }
+    auto collection = index.find(collectionUri);
+    assert(collection != index.end());
+    std::vector<bool> isLinked(resources_.size(), false);
+    std::vector<size_t> linked;
+    linked.reserve(hrefs.size());
+    for (const char *href : hrefs)
+    {
         if (!href)
         {
-            goto exit;
+            return false;
         }
-        auto rit = FindResourceFromUri(resources_, href);
-        if (rit != resources_.end())
+        auto it = index.find(href);
+        if ((it != index.end()) && (it != collection) && !isLinked[it->second])
         {
-            collection->resources_.push_back(*rit);
-            resources_.erase(rit);
-            /* Find collection again since resources has been modified */
-            collection = FindResourceFromUri(resources_, collectionUri);
-            assert(collection != resources_.end());
+            isLinked[it->second] = true;
+            linked.push_back(it->second);
         }
-        OICFree(href);
     }
-    success = true;
 
-exit:
-    if (links)
+    /* Move the linked resources, in link order, under the collection. */
+    std::vector<Resource> resources;
+    resources.reserve(linked.size());
+    for (size_t i : linked)
     {
-        dimTotal = calcDimTotal(dim);
-        for(size_t i = 0; i < dimTotal; ++i)
+        resources.push_back(std::move(resources_[i]));
+    }
+    size_t j = 0;
+    for (size_t i = 0; i < resources_.size(); ++i)
+    {
+        if (!isLinked[i])
         {
-            OCRepPayloadDestroy(links[i]);
+            if (i != j)
+            {
+                resources_[j] = std::move(resources_[i]);
+            }
+            ++j;
         }
     }
-    OICFree(links);
-    return success;
+    resources_.erase(resources_.begin() + j, resources_.end());
+    std::vector<Resource>::iterator it = FindResourceFromUri(resources_, collectionUri);
+    it->resources_.insert(it->resources_.end(), std::make_move_iterator(resources.begin()),
+            std::make_move_iterator(resources.end()));
+    return true;
 }
 
 std::vector<Resource>::iterator FindResourceFromUri(std::vector<Resource> &resources,
@@ -249,6 +527,64 @@ OCStackResult CreateResource(OCResourceHandle *handle, const char *uri, const ch
         result = OCCreateResource(handle, typeName, interfaceName, uri, entityHandler,
                 callbackParam, properties);
     }
+    if (result == OC_STACK_OK)
+    {
+        InvalidateFragments(*handle);
+    }
+    return result;
+}
+
+void InvalidateFragments(OCResourceHandle handle)
+{
+    std::lock_guard<std::mutex> lock(s_fragmentsMutex);
+    s_fragments.erase(handle);
+}
+
+OCStackResult BindResourceType(OCResourceHandle handle, const char *resourceTypeName)
+{
+    OCStackResult result = OCBindResourceTypeToResource(handle, resourceTypeName);
+    InvalidateFragments(handle);
+    return result;
+}
+
+OCStackResult BindResourceInterface(OCResourceHandle handle, const char *resourceInterfaceName)
+{
+    OCStackResult result = OCBindResourceInterfaceToResource(handle, resourceInterfaceName);
+    InvalidateFragments(handle);
+    return result;
+}
+
+OCStackResult BindResource(OCResourceHandle collection, OCResourceHandle resource)
+{
+    OCStackResult result = OCBindResource(collection, resource);
+    InvalidateFragments(collection);
+    return result;
+}
+
+OCStackResult UnBindResource(OCResourceHandle collection, OCResourceHandle resource)
+{
+    OCStackResult result = OCUnBindResource(collection, resource);
+    InvalidateFragments(collection);
+    return result;
+}
+
+OCStackResult DeleteResource(OCResourceHandle handle)
+{
+    OCStackResult result = OCDeleteResource(handle);
+    std::lock_guard<std::mutex> lock(s_fragmentsMutex);
+    s_fragments.erase(handle);
+    for (auto it = s_fragments.begin(); it != s_fragments.end(); )
+    {
+        std::vector<OCResourceHandle> &links = it->second.links;
+        if (std::find(links.begin(), links.end(), handle) != links.end())
+        {
+            it = s_fragments.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
     return result;
 }
 
@@ -276,6 +612,8 @@ struct DoContext
     OCCallbackData cb_data_;
     OCHeaderOption *options_;
     uint8_t num_options_;
+    /* Set when the request is traced. */
+    std::string trace_id_;
 
     std::vector<OCDevAddr>::iterator destination_;
     ~DoContext()
@@ -300,6 +638,17 @@ static void DoContextDeleter(void *ctx)
 
 static OCStackResult DoResource(DoContext *context);
 
+static void TraceRequest(DoContext *context, Trace::Phase phase, const char *name, const char *arg)
+{
+    char span[Trace::NAME_SIZE];
+    if (!name)
+    {
+        snprintf(span, sizeof(span), "%s %s", MethodText(context->method_), context->uri_.c_str());
+        name = span;
+    }
+    Trace::Record(phase, name, context->trace_id_.c_str(), arg);
+}
+
 static OCStackApplicationResult DoResourceCB(void *ctx, OCDoHandle handle,
         OCClientResponse *response)
 {
@@ -314,6 +663,13 @@ static OCStackApplicationResult DoResourceCB(void *ctx, OCDoHandle handle,
                 /* Don't expect a retry to succeed for these: */
                 (OC_STACK_INVALID_QUERY != response->result))
         {
+            Metrics::do_resource_retries.Add();
+            if (!context->trace_id_.empty())
+            {
+                char arg[32];
+                snprintf(arg, sizeof(arg), "result=%d", response->result);
+                TraceRequest(context, Trace::INSTANT, "retry", arg);
+            }
             OCStackResult result = DoResource(context);
             if (result == OC_STACK_OK)
             {
@@ -321,6 +677,17 @@ static OCStackApplicationResult DoResourceCB(void *ctx, OCDoHandle handle,
             }
         }
     }
+    if (response && (response->result <= OC_STACK_RESOURCE_CHANGED) &&
+            ((context->destination_ - context->destinations_.begin()) > 1))
+    {
+        Metrics::endpoint_failovers.Add();
+    }
+    if (!context->trace_id_.empty())
+    {
+        char arg[32];
+        snprintf(arg, sizeof(arg), "result=%d", response ? response->result : -1);
+        TraceRequest(context, Trace::END, NULL, arg);
+    }
     OCStackApplicationResult result = context->cb_data_.cb(context->cb_data_.context, context,
             response);
     if ((result == OC_STACK_DELETE_TRANSACTION) && !context->cb_data_.cd)
@@ -333,11 +700,18 @@ static OCStackApplicationResult DoResourceCB(void *ctx, OCDoHandle handle,
 static OCStackResult DoResource(DoContext *context)
 {
     const OCDevAddr *destination = NULL;
+    bool is_first = (context->destination_ == context->destinations_.begin());
     if (context->destination_ != context->destinations_.end())
     {
         destination = &(*context->destination_);
         ++context->destination_;
     }
+    if (!context->trace_id_.empty())
+    {
+        char arg[MAX_ADDR_STR_SIZE + 8];
+        snprintf(arg, sizeof(arg), "%s:%d", destination ? destination->addr : "", destination ? destination->port : 0);
+        TraceRequest(context, is_first ? Trace::BEGIN : Trace::INSTANT, is_first ? NULL : "endpoint", arg);
+    }
     OCCallbackData cbData;
     cbData.cb = DoResourceCB;
     cbData.context = context;
@@ -373,6 +747,10 @@ OCStackResult DoResource(DoHandle *handle, OCMethod method, const char *uri,
     }
 
     context->destination_ = context->destinations_.begin();
+    if (Trace::IsEnabled() && Trace::CurrentId())
+    {
+        context->trace_id_ = Trace::CurrentId();
+    }
     *handle = context;
 
     return DoResource(context);
@@ -402,229 +780,215 @@ OCStackResult Cancel(DoHandle handle, OCQualityOfService qos, OCHeaderOption *op
     return OCCancel(h, qos, options, numOptions);
 }
 
-std::map<std::string, std::string> ParseQuery(OCResourceHandle resource, const char *query)
-{
-    std::map<std::string, std::string> queryMap;
+const size_t QueryView::MAX_PARAMS;
 
-    if (query)
+QueryView::QueryView(const char *query)
+    : n_(0), truncated_(false)
+{
+    const char *p = query;
+    while (p && *p)
     {
-        std::string queryStr = query;
-        std::string::size_type beg, end = 0;
-        beg = 0;
-        while (end != std::string::npos)
+        Param param;
+        const char *end = p + strcspn(p, "&;");
+        const char *eq = (const char *) memchr(p, '=', end - p);
+        if (eq)
         {
-            std::string key, value;
-            end = queryStr.find('=', beg);
-            if (end == std::string::npos)
-            {
-                key = queryStr.substr(beg);
-            }
-            else
-            {
-                key = queryStr.substr(beg, end - beg);
-                beg = end + 1;
-                end = queryStr.find_first_of("&;", beg);
-                if (end == std::string::npos)
-                {
-                    value = queryStr.substr(beg);
-                }
-                else
-                {
-                    value = queryStr.substr(beg, end - beg);
-                    beg = end + 1;
-                }
-            }
-            queryMap[key] = value;
+            param.key = StringView(p, eq - p);
+            param.value = StringView(eq + 1, end - (eq + 1));
         }
+        else
+        {
+            param.key = StringView(p, end - p);
+            param.value = StringView(end, 0);
+        }
+        if (param.key == OC_RSRVD_INTERFACE)
+        {
+            if_ = param.value;
+        }
+        else if (param.key == OC_RSRVD_RESOURCE_TYPE)
+        {
+            rt_ = param.value;
+        }
+        if (n_ < MAX_PARAMS)
+        {
+            params_[n_++] = param;
+        }
+        else
+        {
+            truncated_ = true;
+        }
+        p = *end ? end + 1 : end;
     }
-    /* Default interface for multi-value rt resources is the baseline interface. */
-    if (queryMap.find(OC_RSRVD_INTERFACE) == queryMap.end())
+}
+
+StringView QueryView::Find(const char *key) const
+{
+    for (size_t i = n_; i > 0; --i)
     {
-        uint8_t n = 0;
-        if ((OCGetNumberOfResourceTypes(resource, &n) == OC_STACK_OK) && n)
+        if (params_[i - 1].key == key)
         {
-            queryMap[OC_RSRVD_INTERFACE] = OC_RSRVD_INTERFACE_DEFAULT;
+            return params_[i - 1].value;
         }
     }
-    return queryMap;
+    return StringView();
 }
 
 // TODO Use public core API when it becomes available
-static OCEndpointPayload *ParseEndpoint(OCRepPayload *payload)
+/* An endpoint the bridge cannot use is skipped, so this fails only when out of memory. */
+static bool AddEndpoint(OCResourcePayload *rp, const OCRepPayload *payload)
 {
     OCEndpointPayload *ep = NULL;
-    char *s = NULL;
-    int64_t n;
+    Endpoint endpoint;
+    const OCRepPayloadValue *pri;
 
+    const char *s = FindString(payload, OC_RSRVD_ENDPOINT);
+    if (!s || !ParseEndpoint(s, &endpoint))
+    {
+        LOG(LOG_INFO, "Skipping endpoint %s", s ? s : "(null)");
+        return true;
+    }
     ep = (OCEndpointPayload *) OICCalloc(1, sizeof(OCEndpointPayload));
     if (!ep)
     {
         goto exit;
     }
-    if (OCRepPayloadGetPropString(payload, OC_RSRVD_ENDPOINT, &s))
+    ep->tps = (char *) OICMalloc(endpoint.tps.len + 1);
+    ep->addr = (char *) OICMalloc(endpoint.host.len + 1);
+    if (!ep->tps || !ep->addr)
     {
-        // 0         1         2         3         4         5         6
-        // 01234567890123456789012345678901234567890123456789012345678901234
-        // coaps+tcp://[xxxx:xxxx:xxxx:xxxx:xxxx:xxxx:yyy.yyy.yyy.yyy]:xxxxx
-        char *tps = (char *) OICMalloc(10);
-        char *addr = (char *) OICMalloc(48);
-        int port;
-        if (tps && addr && (sscanf(s, "%10s://%48s:%d", tps, addr, &port) == 3))
-        {
-            ep->tps = tps;
-            ep->addr = addr;
-            ep->family = strchr(addr, '[') ? OC_IP_USE_V6 : OC_IP_USE_V4;
-            if (!strncmp(tps, "coaps", 5))
-            {
-                ep->family = (OCTransportFlags) (ep->family | OC_FLAG_SECURE);
-            }
-            ep->port = (uint16_t) port;
-        }
-        else
-        {
-            OICFree(addr);
-            OICFree(tps);
-            goto exit;
-        }
-        OICFree(s);
-        s = NULL;
+        goto exit;
     }
-    if (OCRepPayloadGetPropInt(payload, OC_RSRVD_TCP_PORT, &n))
+    memcpy(ep->tps, endpoint.tps.str, endpoint.tps.len);
+    ep->tps[endpoint.tps.len] = '\0';
+    memcpy(ep->addr, endpoint.host.str, endpoint.host.len);
+    ep->addr[endpoint.host.len] = '\0';
+    ep->family = endpoint.flags;
+    ep->port = endpoint.port;
+    pri = FindValue(payload, OC_RSRVD_PRIORITY, OCREP_PROP_INT);
+    ep->pri = pri ? (uint16_t) pri->i : 1;
+    OCResourcePayloadAddNewEndpoint(rp, ep);
+    return true;
+
+exit:
+    if (ep)
     {
-        ep->pri = (uint16_t) n;
+        OICFree(ep->tps);
+        OICFree(ep->addr);
     }
-    else
+    OICFree(ep);
+    return false;
+}
+
+/* Builds the list straight from the payload's array, one copy per string. */
+static bool AddStringLL(OCStringLL **list, const OCRepPayload *payload, const char *name,
+        const OCStringLL *fallback)
+{
+    const OCRepPayloadValue *value = FindValue(payload, name, OCREP_PROP_ARRAY);
+    if (!value || (value->arr.type != OCREP_PROP_STRING))
     {
-        ep->pri = 1;
+        *list = CloneOCStringLL((OCStringLL *) fallback);
+        return !fallback || *list;
     }
-    return ep;
-
-exit:
-    OICFree(s);
-    OICFree(ep);
-    return NULL;
+    OCStringLL **tail = list;
+    size_t dimTotal = calcDimTotal(value->arr.dimensions);
+    for (size_t i = 0; i < dimTotal; ++i)
+    {
+        OCStringLL *node = (OCStringLL *) OICCalloc(1, sizeof(OCStringLL));
+        if (!node)
+        {
+            return false;
+        }
+        *tail = node;
+        tail = &node->next;
+        node->value = OICStrdup(value->arr.strArr[i]);
+        if (!node->value)
+        {
+            return false;
+        }
+    }
+    return true;
 }
 
 OCResourcePayload *ParseLink(OCRepPayload *payload)
 {
     OCResourcePayload *rp = NULL;
-    size_t ssDim[MAX_REP_ARRAY_DEPTH] = { 0 };
-    char **ss = NULL;
-    OCRepPayload *o = NULL;
-    size_t osDim[MAX_REP_ARRAY_DEPTH] = { 0 };
-    OCRepPayload **os = NULL;
+    const OCRepPayloadValue *value;
+    const char *s;
 
     rp = (OCResourcePayload *) OICCalloc(1, sizeof(OCResourcePayload));
     if (!rp)
     {
         goto exit;
     }
-    if (!OCRepPayloadGetPropString(payload, OC_RSRVD_HREF, &rp->uri))
+    s = FindString(payload, OC_RSRVD_HREF);
+    rp->uri = OICStrdup(s ? s : payload->uri);
+    if ((s = FindString(payload, OC_RSRVD_REL)))
     {
-        rp->uri = OICStrdup(payload->uri);
+        rp->rel = OICStrdup(s);
     }
-    OCRepPayloadGetPropString(payload, OC_RSRVD_REL, &rp->rel);
-    OCRepPayloadGetPropString(payload, OC_RSRVD_URI, &rp->anchor);
-    if (OCRepPayloadGetStringArray(payload, OC_RSRVD_RESOURCE_TYPE, &ss, ssDim))
+    if ((s = FindString(payload, OC_RSRVD_URI)))
     {
-        size_t dimTotal = calcDimTotal(ssDim);
-        for (size_t i = 0; i < dimTotal; ++i)
-        {
-            OCResourcePayloadAddStringLL(&rp->types, ss[i]);
-            OICFree(ss[i]);
-        }
-        OICFree(ss);
-        ss = NULL;
+        rp->anchor = OICStrdup(s);
     }
-    else
+    if (!AddStringLL(&rp->types, payload, OC_RSRVD_RESOURCE_TYPE, payload->types) ||
+            !AddStringLL(&rp->interfaces, payload, OC_RSRVD_INTERFACE, payload->interfaces))
     {
-        rp->types = CloneOCStringLL(payload->types);
+        goto exit;
     }
-    if (OCRepPayloadGetStringArray(payload, OC_RSRVD_INTERFACE, &ss, ssDim))
+    value = FindValue(payload, OC_RSRVD_POLICY, OCREP_PROP_OBJECT);
+    if (value && value->obj)
     {
-        size_t dimTotal = calcDimTotal(ssDim);
-        for (size_t i = 0; i < dimTotal; ++i)
+        const OCRepPayload *o = value->obj;
+        const OCRepPayloadValue *n;
+        if ((n = FindValue(o, OC_RSRVD_BITMAP, OCREP_PROP_INT)))
         {
-            OCResourcePayloadAddStringLL(&rp->interfaces, ss[i]);
-            OICFree(ss[i]);
+            rp->bitmap = (uint8_t) n->i;
         }
-        OICFree(ss);
-        ss = NULL;
-    }
-    else
-    {
-        rp->interfaces = CloneOCStringLL(payload->interfaces);
-    }
-    if (OCRepPayloadGetPropObject(payload, OC_RSRVD_POLICY, &o))
-    {
-        int64_t n;
-        if (OCRepPayloadGetPropInt(o, OC_RSRVD_BITMAP, &n))
+        if ((n = FindValue(o, OC_RSRVD_SECURE, OCREP_PROP_BOOL)))
         {
-            rp->bitmap = (uint8_t) n;
+            rp->secure = n->b;
         }
-        OCRepPayloadGetPropBool(o, OC_RSRVD_SECURE, &rp->secure);
-        if (OCRepPayloadGetPropInt(o, OC_RSRVD_HOSTING_PORT, &n))
+        if ((n = FindValue(o, OC_RSRVD_HOSTING_PORT, OCREP_PROP_INT)))
         {
-            rp->port = (uint16_t) n;
+            rp->port = (uint16_t) n->i;
         }
 #ifdef TCP_ADAPTER
-        if (OCRepPayloadGetPropInt(o, OC_RSRVD_TCP_PORT, &n))
+        if ((n = FindValue(o, OC_RSRVD_TCP_PORT, OCREP_PROP_INT)))
         {
-            rp->tcpPort = (uint16_t) n;
+            rp->tcpPort = (uint16_t) n->i;
         }
 #endif
-        OCRepPayloadDestroy(o);
-        o = NULL;
     }
-    if (OCRepPayloadGetPropObjectArray(payload, OC_RSRVD_ENDPOINTS, &os, osDim))
+    value = FindValue(payload, OC_RSRVD_ENDPOINTS, OCREP_PROP_ARRAY);
+    if (value && (value->arr.type == OCREP_PROP_OBJECT))
     {
-        size_t dimTotal = calcDimTotal(osDim);
+        size_t dimTotal = calcDimTotal(value->arr.dimensions);
         for (size_t i = 0; i < dimTotal; ++i)
         {
-            OCEndpointPayload *ep = ParseEndpoint(os[i]);
-            if (!ep)
+            if (!AddEndpoint(rp, value->arr.objArray[i]))
             {
                 goto exit;
             }
-            OCResourcePayloadAddNewEndpoint(rp, ep);
-            OCRepPayloadDestroy(os[i]);
         }
-        OICFree(os);
-        os = NULL;
     }
     return rp;
 
 exit:
-    if (os)
-    {
-        size_t dimTotal = calcDimTotal(osDim);
-        for (size_t i = 0; i < dimTotal; ++i)
-        {
-            OICFree(os[i]);
-        }
-        OICFree(os);
-    }
-    OCRepPayloadDestroy(o);
-    if (ss)
-    {
-        size_t dimTotal = calcDimTotal(ssDim);
-        for (size_t i = 0; i < dimTotal; ++i)
-        {
-            OICFree(ss[i]);
-        }
-        OICFree(ss);
-    }
-    OICFree(rp);
+    OCDiscoveryResourceDestroy(rp);
     return NULL;
 }
 
-bool IsValidRequest(OCEntityHandlerRequest *request)
+bool IsValidRequest(OCEntityHandlerRequest *request, const QueryView &query)
 {
     OCStackResult result;
     uint8_t n;
 
-    auto queryMap = ParseQuery(request->resource, request->query);
-    auto itf = queryMap.find("if");
+    /* Default interface is the baseline interface. */
+    StringView itf = query.GetInterface();
+    if (itf.IsNull())
+    {
+        itf = StringView(OC_RSRVD_INTERFACE_DEFAULT, strlen(OC_RSRVD_INTERFACE_DEFAULT));
+    }
     bool hasItf = false;
     result = OCGetNumberOfResourceInterfaces(request->resource, &n);
     if (result != OC_STACK_OK)
@@ -638,7 +1002,7 @@ bool IsValidRequest(OCEntityHandlerRequest *request)
         {
             return false;
         }
-        if (itf->second == name)
+        if (itf == name)
         {
             hasItf = true;
             break;
@@ -649,8 +1013,8 @@ bool IsValidRequest(OCEntityHandlerRequest *request)
         return false;
     }
     bool hasRt = false;
-    auto rt = queryMap.find("rt");
-    if (rt != queryMap.end())
+    const StringView &rt = query.GetResourceType();
+    if (!rt.IsNull())
     {
         result = OCGetNumberOfResourceTypes(request->resource, &n);
         if (result != OC_STACK_OK)
@@ -664,7 +1028,7 @@ bool IsValidRequest(OCEntityHandlerRequest *request)
             {
                 return false;
             }
-            if (rt->second == name)
+            if (rt == name)
             {
                 hasRt = true;
                 break;
@@ -678,97 +1042,122 @@ bool IsValidRequest(OCEntityHandlerRequest *request)
     return true;
 }
 
-bool SetResourceTypes(OCRepPayload *payload, OCResourceHandle resource)
+/* Called with s_fragmentsMutex held. */
+static ResourceFragments *GetFragments(OCResourceHandle resource)
 {
+    auto it = s_fragments.find(resource);
+    if (it != s_fragments.end())
+    {
+        return &it->second;
+    }
     uint8_t n;
-    char **array = NULL;
-    size_t dim[MAX_REP_ARRAY_DEPTH] = { 0, 0, 0 };
-    OCStackResult result;
-
-    result = OCGetNumberOfResourceTypes(resource, &n);
-    if (result != OC_STACK_OK)
+    ResourceFragments fragments;
+    fragments.uri.Add(OCGetResourceUri(resource));
+    if (OCGetNumberOfResourceTypes(resource, &n) != OC_STACK_OK)
     {
-        goto error;
+        return NULL;
     }
-    array = (char **)OICCalloc(n, sizeof(char *));
-    if (!array)
+    for (uint8_t i = 0; i < n; ++i)
     {
-        goto error;
+        fragments.rts.Add(OCGetResourceTypeName(resource, i));
+    }
+    if (OCGetNumberOfResourceInterfaces(resource, &n) != OC_STACK_OK)
+    {
+        return NULL;
     }
     for (uint8_t i = 0; i < n; ++i)
     {
-        array[i] = OICStrdup(OCGetResourceTypeName(resource, i));
-        if (!array[i])
-        {
-            goto error;
-        }
+        fragments.ifs.Add(OCGetResourceInterfaceName(resource, i));
     }
-    dim[0] = n;
-    if (!OCRepPayloadSetStringArrayAsOwner(payload, OC_RSRVD_RESOURCE_TYPE, array, dim))
+    OCResourceHandle link;
+    for (uint8_t i = 0; (link = OCGetResourceHandleFromCollection(resource, i)); ++i)
     {
-        goto error;
+        fragments.links.push_back(link);
     }
-    array = NULL;
-    return true;
+    return &s_fragments.insert(std::make_pair(resource, fragments)).first->second;
+}
 
-error:
-    if (array)
+// Copies the strings of fragment into the arena, as the cache may change once its lock is released.
+static const char **CopyStrings(const StringFragment &fragment, PayloadArena &arena)
+{
+    size_t n = fragment.offsets.size();
+    char *blob = (char *) arena.Allocate(fragment.blob.size());
+    const char **strs = (const char **) arena.Allocate(n * sizeof(char *));
+    if (!strs || !blob)
     {
-        for (uint8_t i = 0; i < n; ++i)
-        {
-            OICFree(array[i]);
-        }
-        OICFree(array);
+        return NULL;
     }
-    return false;
+    memcpy(blob, fragment.blob.data(), fragment.blob.size());
+    for (size_t i = 0; i < n; ++i)
+    {
+        strs[i] = blob + fragment.offsets[i];
+    }
+    return strs;
 }
 
-bool SetInterfaces(OCRepPayload *payload, OCResourceHandle resource)
+static bool SetStringArray(OCRepPayload *payload, const char *name, const StringFragment &fragment,
+        PayloadArena &arena)
 {
-    uint8_t n;
-    char **array = NULL;
-    size_t dim[MAX_REP_ARRAY_DEPTH] = { 0, 0, 0 };
-    OCStackResult result;
+    const char **strs = CopyStrings(fragment, arena);
+    return strs && arena.SetStringArray(payload, name, strs, fragment.offsets.size());
+}
 
-    result = OCGetNumberOfResourceInterfaces(resource, &n);
-    if (result != OC_STACK_OK)
-    {
-        goto error;
-    }
-    array = (char **)OICCalloc(n, sizeof(char *));
-    if (!array)
+static bool AddStringArray(OCRepPayload *payload, const char *name, const StringFragment &fragment,
+        PayloadArena &arena)
+{
+    const char **strs = CopyStrings(fragment, arena);
+    return strs && arena.AddStringArray(payload, name, strs, fragment.offsets.size());
+}
+
+bool SetResourceTypes(OCRepPayload *payload, OCResourceHandle resource, PayloadArena &arena)
+{
+    std::lock_guard<std::mutex> lock(s_fragmentsMutex);
+    ResourceFragments *fragments = GetFragments(resource);
+    return fragments && SetStringArray(payload, OC_RSRVD_RESOURCE_TYPE, fragments->rts, arena);
+}
+
+bool SetInterfaces(OCRepPayload *payload, OCResourceHandle resource, PayloadArena &arena)
+{
+    std::lock_guard<std::mutex> lock(s_fragmentsMutex);
+    ResourceFragments *fragments = GetFragments(resource);
+    return fragments && SetStringArray(payload, OC_RSRVD_INTERFACE, fragments->ifs, arena);
+}
+
+bool SetLinks(OCRepPayload *payload, OCResourceHandle resource, PayloadArena &arena)
+{
+    std::lock_guard<std::mutex> lock(s_fragmentsMutex);
+    ResourceFragments *fragments = GetFragments(resource);
+    if (!fragments)
     {
-        goto error;
+        return false;
     }
-    for (uint8_t i = 0; i < n; ++i)
+    size_t n = fragments->links.size();
+    if (!n)
     {
-        array[i] = OICStrdup(OCGetResourceInterfaceName(resource, i));
-        if (!array[i])
-        {
-            goto error;
-        }
+        return true;
     }
-    dim[0] = n;
-    if (!OCRepPayloadSetStringArrayAsOwner(payload, OC_RSRVD_INTERFACE, array, dim))
+    // The links and their values all live in the arena
+    OCRepPayload **links = (OCRepPayload **) arena.Allocate(n * sizeof(OCRepPayload *));
+    if (!links)
     {
-        goto error;
+        return false;
     }
-    array = NULL;
-    return true;
-
-error:
-    if (array)
+    for (size_t i = 0; i < n; ++i)
     {
-        for (uint8_t i = 0; i < n; ++i)
+        ResourceFragments *link = GetFragments(fragments->links[i]);
+        links[i] = arena.CreatePayload();
+        if (!link || !links[i] ||
+                !arena.AddString(links[i], OC_RSRVD_HREF, arena.Strdup(link->uri.blob.c_str())) ||
+                !AddStringArray(links[i], OC_RSRVD_RESOURCE_TYPE, link->rts, arena) ||
+                !AddStringArray(links[i], OC_RSRVD_INTERFACE, link->ifs, arena))
         {
-            OICFree(array[i]);
+            return false;
         }
-        OICFree(array);
     }
-    return false;
+    return arena.SetObjectArray(payload, OC_RSRVD_LINKS, links, n);
 }
 
-OCRepPayload *CreatePayload(OCResourceHandle resource, const char *query)
+OCRepPayload *CreatePayload(OCResourceHandle resource, const QueryView &query, PayloadArena &arena)
 {
     OCRepPayload *payload = NULL;
 
@@ -781,10 +1170,18 @@ OCRepPayload *CreatePayload(OCResourceHandle resource, const char *query)
     {
         goto error;
     }*/
-    if (query && strstr(query, INTERFACE_DEFAULT_QUERY))
+    if (query.GetInterface() == OC_RSRVD_INTERFACE_DEFAULT)
+    {
+        if (!SetResourceTypes(payload, resource, arena) ||
+                !SetInterfaces(payload, resource, arena) ||
+                !SetLinks(payload, resource, arena))
+        {
+            goto error;
+        }
+    }
+    else if (query.GetInterface() == OC_RSRVD_INTERFACE_LL)
     {
-        if (!SetResourceTypes(payload, resource) ||
-                !SetInterfaces(payload, resource))
+        if (!SetLinks(payload, resource, arena))
         {
             goto error;
         }
@@ -792,6 +1189,6 @@ OCRepPayload *CreatePayload(OCResourceHandle resource, const char *query)
     return payload;
 
 error:
-    OCRepPayloadDestroy(payload);
+    arena.Destroy(payload);
     return NULL;
 }
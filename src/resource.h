@@ -23,8 +23,12 @@
 
 #include "cacommon.h"
 #include "octypes.h"
+#include "payload_arena.h"
+#include "symbol.h"
 #include <algorithm>
 #include <map>
+#include <memory>
+#include <string.h>
 #include <string>
 #include <vector>
 
@@ -35,14 +39,23 @@ class Resource
 {
 public:
     std::string uri_;
-    std::vector<std::string> ifs_;
-    std::vector<std::string> rts_;
+    std::vector<Symbol> ifs_;
+    std::vector<Symbol> rts_;
     bool is_observable_;
-    std::vector<OCDevAddr> addrs_;
     std::vector<Resource> resources_;
     
     Resource(OCDevAddr origin, const char *di, OCResourcePayload *resource);
+    /* Copies share the interned names, which are released with the last one. */
+    Resource(const Resource &other);
+    Resource &operator=(const Resource &other);
+    ~Resource();
+    const std::vector<OCDevAddr> &addrs() const { return *addrs_; }
     bool IsSecure();
+
+private:
+    friend class Device;
+    /* Resources of the same device with identical endpoints share one copy. */
+    std::shared_ptr<const std::vector<OCDevAddr>> addrs_;
 };
 
 class Device
@@ -58,10 +71,19 @@ public:
     bool SetCollectionLinks(std::string collectionUri, OCRepPayload *payload);
 };
 
-template <typename T>
-bool HasResourceType(std::vector<std::string> &rts, T rt)
+inline bool HasResourceType(const std::vector<Symbol> &rts, Symbol rt)
+{
+    return (rt != Symbols::NONE) && (std::find(rts.begin(), rts.end(), rt) != rts.end());
+}
+
+inline bool HasResourceType(const std::vector<Symbol> &rts, const char *rt)
+{
+    return HasResourceType(rts, Symbols::Find(rt));
+}
+
+inline bool HasResourceType(const std::vector<Symbol> &rts, const std::string &rt)
 {
-    return std::find(rts.begin(), rts.end(), rt) != rts.end();
+    return HasResourceType(rts, rt.c_str());
 }
 
 std::vector<Resource>::iterator FindResourceFromUri(std::vector<Resource> &resources,
@@ -74,6 +96,17 @@ OCStackResult CreateResource(OCResourceHandle *handle, const char *uri, const ch
         const char *interfaceName, OCEntityHandler entityHandler, void *callbackParam,
         uint8_t properties);
 
+/*
+ * Wrappers that keep the cached rt, if and links of hosted resources in step with
+ * the stack.  Use these instead of the OC* equivalents.
+ */
+OCStackResult BindResourceType(OCResourceHandle handle, const char *resourceTypeName);
+OCStackResult BindResourceInterface(OCResourceHandle handle, const char *resourceInterfaceName);
+OCStackResult BindResource(OCResourceHandle collection, OCResourceHandle resource);
+OCStackResult UnBindResource(OCResourceHandle collection, OCResourceHandle resource);
+OCStackResult DeleteResource(OCResourceHandle handle);
+void InvalidateFragments(OCResourceHandle handle);
+
 typedef void *DoHandle;
 OCStackResult DoResource(DoHandle *handle, OCMethod method, const char *uri,
         const OCDevAddr* destination, OCPayload *payload, OCCallbackData *cbData,
@@ -84,12 +117,62 @@ OCStackResult DoResource(DoHandle *handle, OCMethod method, const char *uri,
 OCStackResult Cancel(DoHandle handle, OCQualityOfService qos, OCHeaderOption *options,
         uint8_t numOptions);
 
-bool IsValidRequest(OCEntityHandlerRequest *request);
-std::map<std::string, std::string> ParseQuery(OCResourceHandle resource, const char *query);
+/* A run of characters in a string that outlives the view. */
+struct StringView
+{
+    const char *str;
+    size_t len;
+
+    StringView() : str(NULL), len(0) { }
+    StringView(const char *str, size_t len) : str(str), len(len) { }
+    bool IsNull() const { return str == NULL; }
+    bool operator==(const char *s) const { return str && !strncmp(str, s, len) && !s[len]; }
+    bool operator!=(const char *s) const { return !(*this == s); }
+    std::string ToString() const { return str ? std::string(str, len) : std::string(); }
+};
+
+/*
+ * A query string split in place into key/value views.  Parsing does not allocate;
+ * parameters beyond MAX_PARAMS are dropped, but the interface and resource type are
+ * always kept.  The query string must outlive the view.
+ */
+class QueryView
+{
+public:
+    static const size_t MAX_PARAMS = 8;
+
+    struct Param
+    {
+        StringView key;
+        StringView value;
+    };
+
+    explicit QueryView(const char *query);
+    size_t Size() const { return n_; }
+    const Param &operator[](size_t i) const { return params_[i]; }
+    bool IsTruncated() const { return truncated_; }
+    /* Returns the value of the last parameter named key, or a null view. */
+    StringView Find(const char *key) const;
+    const StringView &GetInterface() const { return if_; }
+    const StringView &GetResourceType() const { return rt_; }
+
+private:
+    Param params_[MAX_PARAMS];
+    size_t n_;
+    bool truncated_;
+    StringView if_;
+    StringView rt_;
+};
+
+bool IsValidRequest(OCEntityHandlerRequest *request, const QueryView &query);
 OCResourcePayload *ParseLink(OCRepPayload *payload);
+/* Parses an endpoint such as "coaps://[fe80::1%25eth0]:5684" without allocating. */
+bool ParseEndpoint(const char *str, OCDevAddr *addr);
 
-OCRepPayload *CreatePayload(OCResourceHandle resource, const char *query);
-bool SetResourceTypes(OCRepPayload *payload, OCResourceHandle resource);
-bool SetInterfaces(OCRepPayload *payload, OCResourceHandle resource);
+/* The returned payload must be released with arena.Destroy(). */
+OCRepPayload *CreatePayload(OCResourceHandle resource, const QueryView &query, PayloadArena &arena);
+bool SetResourceTypes(OCRepPayload *payload, OCResourceHandle resource, PayloadArena &arena);
+bool SetInterfaces(OCRepPayload *payload, OCResourceHandle resource, PayloadArena &arena);
+bool SetLinks(OCRepPayload *payload, OCResourceHandle resource, PayloadArena &arena);
 
 #endif
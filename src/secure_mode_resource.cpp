@@ -25,14 +25,14 @@
 #include "ocpayload.h"
 #include "ocstack.h"
 
-SecureModeResource::SecureModeResource(std::mutex &mutex, bool secureMode)
-    : m_mutex(mutex), m_secureMode(secureMode), m_handle(NULL)
+SecureModeResource::SecureModeResource(bool secureMode)
+    : m_secureMode(secureMode), m_handle(NULL)
 {
 }
 
 SecureModeResource::~SecureModeResource()
 {
-    OCDeleteResource(m_handle);
+    DeleteResource(m_handle);
 }
 
 OCStackResult SecureModeResource::Create()
@@ -42,19 +42,23 @@ OCStackResult SecureModeResource::Create()
             OC_DISCOVERABLE | OC_OBSERVABLE | OC_SECURE);
 }
 
-/* Called with m_mutex held. */
-OCRepPayload *SecureModeResource::GetSecureMode(OCEntityHandlerRequest *request)
+OCRepPayload *SecureModeResource::GetSecureMode(OCResourceHandle handle,
+        const QueryView &query, PayloadArena &arena)
 {
-    OCRepPayload *payload = CreatePayload(request->resource, request->query);
+    OCRepPayload *payload = CreatePayload(handle, query, arena);
     if (!OCRepPayloadSetPropBool(payload, "secureMode", m_secureMode))
     {
-        OCRepPayloadDestroy(payload);
+        arena.Destroy(payload);
         payload = NULL;
     }
     return payload;
 }
 
-/* Called with m_mutex held. */
+OCRepPayload *SecureModeResource::CreateNotification(OCResourceHandle handle, PayloadArena &arena)
+{
+    return GetSecureMode(handle, QueryView(NULL), arena);
+}
+
 bool SecureModeResource::PostSecureMode(OCEntityHandlerRequest *request, bool &hasChanged)
 {
     OCRepPayload *payload = (OCRepPayload *) request->payload;
@@ -63,8 +67,7 @@ bool SecureModeResource::PostSecureMode(OCEntityHandlerRequest *request, bool &h
     {
         return false;
     }
-    hasChanged = (m_secureMode != secureMode);
-    m_secureMode = secureMode;
+    hasChanged = (m_secureMode.exchange(secureMode) != secureMode);
     return true;
 }
 
@@ -72,14 +75,15 @@ OCEntityHandlerResult SecureModeResource::EntityHandlerCB(OCEntityHandlerFlag fl
         OCEntityHandlerRequest *request, void *ctx)
 {
     LOG(LOG_DEBUG, "[%p] flag=%x,request=%p,ctx=%p", ctx, flag, request, ctx);
-    if (!IsValidRequest(request))
+    QueryView query(request->query);
+    if (!IsValidRequest(request, query))
     {
         LOG(LOG_WARN, "Invalid request received");
         return OC_EH_BAD_REQ;
     }
 
     SecureModeResource *thiz = reinterpret_cast<SecureModeResource *>(ctx);
-    thiz->m_mutex.lock();
+    thiz->Observe(flag, request);
     bool hasChanged = false;
     OCEntityHandlerResult result;
     switch (request->method)
@@ -90,7 +94,8 @@ OCEntityHandlerResult SecureModeResource::EntityHandlerCB(OCEntityHandlerFlag fl
                 memset(&response, 0, sizeof(response));
                 response.requestHandle = request->requestHandle;
                 response.resourceHandle = request->resource;
-                OCRepPayload *payload = thiz->GetSecureMode(request);
+                PayloadArena arena;
+                OCRepPayload *payload = thiz->GetSecureMode(request->resource, query, arena);
                 if (!payload)
                 {
                     result = OC_EH_ERROR;
@@ -103,8 +108,8 @@ OCEntityHandlerResult SecureModeResource::EntityHandlerCB(OCEntityHandlerFlag fl
                 if (doResult != OC_STACK_OK)
                 {
                     LOG(LOG_ERR, "OCDoResponse - %d", doResult);
-                    OCRepPayloadDestroy(payload);
                 }
+                arena.Destroy(payload);
                 break;
             }
         case OC_REST_POST:
@@ -123,7 +128,8 @@ OCEntityHandlerResult SecureModeResource::EntityHandlerCB(OCEntityHandlerFlag fl
                 memset(&response, 0, sizeof(response));
                 response.requestHandle = request->requestHandle;
                 response.resourceHandle = request->resource;
-                OCRepPayload *outPayload = thiz->GetSecureMode(request);
+                PayloadArena arena;
+                OCRepPayload *outPayload = thiz->GetSecureMode(request->resource, query, arena);
                 result = OC_EH_OK;
                 response.ehResult = result;
                 response.payload = reinterpret_cast<OCPayload *>(outPayload);
@@ -131,7 +137,11 @@ OCEntityHandlerResult SecureModeResource::EntityHandlerCB(OCEntityHandlerFlag fl
                 if (doResult != OC_STACK_OK)
                 {
                     LOG(LOG_ERR, "OCDoResponse - %d", doResult);
-                    OCRepPayloadDestroy(outPayload);
+                }
+                arena.Destroy(outPayload);
+                if (hasChanged)
+                {
+                    thiz->Notify(request->resource);
                 }
                 break;
             }
@@ -139,10 +149,5 @@ OCEntityHandlerResult SecureModeResource::EntityHandlerCB(OCEntityHandlerFlag fl
             result = OC_EH_METHOD_NOT_ALLOWED;
             break;
     }
-    thiz->m_mutex.unlock();
-    if (hasChanged)
-    {
-        OCNotifyAllObservers(request->resource, OC_NA_QOS);
-    }
     return result;
 }
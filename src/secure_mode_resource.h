@@ -21,29 +21,34 @@
 #ifndef _SECUREMODERESOURCE_H
 #define _SECUREMODERESOURCE_H
 
+#include "observable_resource.h"
 #include "octypes.h"
-#include <mutex>
+#include <atomic>
+
+class PayloadArena;
+class QueryView;
 
 /** To represent secure mode resource type.*/
 #define OC_RSRVD_RESOURCE_TYPE_SECURE_MODE "oic.r.securemode"
 
 #define OC_RSRVD_SECURE_MODE_URI "/securemode"
 
-class SecureModeResource
+class SecureModeResource : public ObservableResource
 {
 public:
-    SecureModeResource(std::mutex &mutex, bool secureMode);
+    SecureModeResource(bool secureMode);
     ~SecureModeResource();
     OCStackResult Create();
     bool GetSecureMode() const { return m_secureMode; }
     void SetSecureMode(bool secureMode) { m_secureMode = secureMode; }
 
 private:
-    std::mutex &m_mutex;
-    bool m_secureMode;
+    std::atomic<bool> m_secureMode;
     OCResourceHandle m_handle;
 
-    OCRepPayload *GetSecureMode(OCEntityHandlerRequest *request);
+    OCRepPayload *GetSecureMode(OCResourceHandle handle, const QueryView &query,
+            PayloadArena &arena);
+    virtual OCRepPayload *CreateNotification(OCResourceHandle handle, PayloadArena &arena);
     bool PostSecureMode(OCEntityHandlerRequest *request, bool &hasChanged);
     static OCEntityHandlerResult EntityHandlerCB(OCEntityHandlerFlag flag,
             OCEntityHandlerRequest *request, void *ctx);
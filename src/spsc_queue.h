@@ -0,0 +1,58 @@
+#ifndef _SPSC_QUEUE_H
+#define _SPSC_QUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+
+/*
+ * A bounded, lock-free queue for one producer thread and one consumer thread.
+ * Neither side ever waits: Push() fails when the queue is full and Pop() when
+ * it is empty.
+ */
+template <typename T, size_t N>
+class SpscQueue
+{
+    static_assert(N && !(N & (N - 1)), "capacity must be a power of two");
+
+  public:
+    SpscQueue() : head_(0), tail_(0), items_() {}
+
+    /* Called from the producer thread only. */
+    bool Push(const T &value)
+    {
+      size_t tail = tail_.load(std::memory_order_relaxed);
+      if (tail - head_.load(std::memory_order_acquire) == N)
+      {
+        return false;
+      }
+      items_[tail & (N - 1)] = value;
+      tail_.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    /* Called from the consumer thread only. */
+    bool Pop(T &value)
+    {
+      size_t head = head_.load(std::memory_order_relaxed);
+      if (head == tail_.load(std::memory_order_acquire))
+      {
+        return false;
+      }
+      value = items_[head & (N - 1)];
+      head_.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    static size_t Capacity() { return N; }
+
+  private:
+    // The indices are kept on separate cache lines so the two threads do not
+    // invalidate each other's line on every operation.
+    std::atomic<size_t> head_;
+    char head_pad_[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail_;
+    char tail_pad_[64 - sizeof(std::atomic<size_t>)];
+    T items_[N];
+};
+
+#endif
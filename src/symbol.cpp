@@ -0,0 +1,149 @@
+#include "symbol.h"
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+const Symbol Symbols::NONE;
+
+/*
+ * Names are stored in fixed size chunks that are never reallocated, so Name() can
+ * read them without taking the lock.  A slot is only reused once its name has no
+ * references left, so whoever holds a Symbol reads the name it was given.
+ */
+static const size_t CHUNK_SIZE = 256;
+static const size_t MAX_CHUNKS = (Symbols::NONE + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+struct Slot
+{
+  std::atomic<const char *> name;
+  uint32_t refs;
+};
+
+static std::mutex s_mutex;
+static std::unordered_map<std::string, Symbol> s_symbols;
+static std::atomic<Slot *> s_chunks[MAX_CHUNKS];
+static std::atomic<size_t> s_size(0);
+static std::vector<Symbol> s_free;
+
+static Slot &GetSlot(Symbol symbol)
+{
+  return s_chunks[symbol / CHUNK_SIZE].load(std::memory_order_acquire)[symbol % CHUNK_SIZE];
+}
+
+// Called with s_mutex held.
+static void Release(Symbol symbol)
+{
+  if (symbol >= s_size.load(std::memory_order_relaxed))
+  {
+    return;
+  }
+  Slot &slot = GetSlot(symbol);
+  if (slot.refs && (--slot.refs == 0))
+  {
+    const char *name = slot.name.load(std::memory_order_relaxed);
+    slot.name.store(NULL, std::memory_order_release);
+    s_symbols.erase(name);
+    s_free.push_back(symbol);
+  }
+}
+
+Symbol Symbols::Intern(const char *name)
+{
+  std::lock_guard<std::mutex> lock(s_mutex);
+  auto it = s_symbols.find(name);
+  if (it != s_symbols.end())
+  {
+    ++GetSlot(it->second).refs;
+    return it->second;
+  }
+  Symbol symbol;
+  if (!s_free.empty())
+  {
+    symbol = s_free.back();
+    s_free.pop_back();
+  }
+  else
+  {
+    size_t n = s_size.load(std::memory_order_relaxed);
+    if (n >= NONE)
+    {
+      return NONE;
+    }
+    Slot *chunk = s_chunks[n / CHUNK_SIZE].load(std::memory_order_relaxed);
+    if (!chunk)
+    {
+      chunk = new Slot[CHUNK_SIZE]();
+      s_chunks[n / CHUNK_SIZE].store(chunk, std::memory_order_release);
+    }
+    symbol = (Symbol) n;
+    s_size.store(n + 1, std::memory_order_release);
+  }
+  it = s_symbols.insert(std::make_pair(std::string(name), symbol)).first;
+  Slot &slot = GetSlot(symbol);
+  slot.refs = 1;
+  /* Keys of an unordered_map are not moved by rehashing. */
+  slot.name.store(it->first.c_str(), std::memory_order_release);
+  return symbol;
+}
+
+void Symbols::Acquire(const std::vector<Symbol> &symbols)
+{
+  std::lock_guard<std::mutex> lock(s_mutex);
+  for (Symbol symbol : symbols)
+  {
+    if (symbol < s_size.load(std::memory_order_relaxed))
+    {
+      ++GetSlot(symbol).refs;
+    }
+  }
+}
+
+void Symbols::Release(Symbol symbol)
+{
+  std::lock_guard<std::mutex> lock(s_mutex);
+  ::Release(symbol);
+}
+
+void Symbols::Release(const std::vector<Symbol> &symbols)
+{
+  std::lock_guard<std::mutex> lock(s_mutex);
+  for (Symbol symbol : symbols)
+  {
+    ::Release(symbol);
+  }
+}
+
+Symbol Symbols::Find(const char *name)
+{
+  std::lock_guard<std::mutex> lock(s_mutex);
+  auto it = s_symbols.find(name);
+  return (it != s_symbols.end()) ? it->second : NONE;
+}
+
+const char *Symbols::Name(Symbol symbol)
+{
+  if (symbol >= s_size.load(std::memory_order_acquire))
+  {
+    return "";
+  }
+  const char *name = GetSlot(symbol).name.load(std::memory_order_acquire);
+  return name ? name : "";
+}
+
+size_t Symbols::Size()
+{
+  std::lock_guard<std::mutex> lock(s_mutex);
+  return s_symbols.size();
+}
+
+std::vector<std::string> Names(const std::vector<Symbol> &symbols)
+{
+  std::vector<std::string> names;
+  names.reserve(symbols.size());
+  for (Symbol symbol : symbols)
+  {
+    names.push_back(Symbols::Name(symbol));
+  }
+  return names;
+}
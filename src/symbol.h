@@ -0,0 +1,37 @@
+#ifndef _SYMBOL_H
+#define _SYMBOL_H
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+
+/* An interned resource type or interface name. */
+typedef uint16_t Symbol;
+
+/*
+ * Process-wide table of interned names.  Each Intern() takes a reference to the
+ * name, given back with Release(); a name is dropped with its last reference and
+ * its Symbol reused, so the table only holds the names that are in use.  The
+ * string returned by Name() stays valid while a reference is held.
+ */
+class Symbols
+{
+  public:
+    static const Symbol NONE = UINT16_MAX;
+
+    /* Returns NONE when the table is full. */
+    static Symbol Intern(const char *name);
+    /* Takes another reference to each of symbols. */
+    static void Acquire(const std::vector<Symbol> &symbols);
+    static void Release(Symbol symbol);
+    static void Release(const std::vector<Symbol> &symbols);
+    /* Returns NONE when name has not been interned.  No reference is taken. */
+    static Symbol Find(const char *name);
+    static const char *Name(Symbol symbol);
+    /* The number of names in use. */
+    static size_t Size();
+};
+
+std::vector<std::string> Names(const std::vector<Symbol> &symbols);
+
+#endif
@@ -0,0 +1,221 @@
+#include "trace.h"
+
+#include "log.h"
+
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+namespace Trace
+{
+  static const size_t ARG_SIZE = 48;
+
+  struct Event
+  {
+    /* Odd while the event is being written. */
+    std::atomic<uint32_t> seq;
+    char phase;
+    uint64_t ts_us;
+    char name[NAME_SIZE];
+    char id[ID_SIZE];
+    char arg[ARG_SIZE];
+  };
+
+  struct Ring
+  {
+    uint32_t tid;
+    std::atomic<uint64_t> head;
+    Event events[RING_SIZE];
+    Ring(uint32_t tid) : tid(tid), head(0)
+    {
+      for (size_t i = 0; i < RING_SIZE; ++i)
+      {
+        events[i].seq.store(0, std::memory_order_relaxed);
+      }
+    }
+  };
+
+  std::atomic<bool> enabled(false);
+
+  /* Rings live as long as the process, so a thread may exit with events pending. */
+  static std::mutex s_ringsMutex;
+  static std::vector<Ring *> s_rings;
+  static thread_local Ring *s_ring = NULL;
+  static thread_local const char *s_id = NULL;
+
+  static uint64_t NowUs()
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  static void Copy(char *dst, size_t size, const char *src)
+  {
+    if (!src)
+    {
+      dst[0] = '\0';
+      return;
+    }
+    size_t n = strnlen(src, size - 1);
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+
+  static Ring *GetRing()
+  {
+    if (!s_ring)
+    {
+      std::lock_guard<std::mutex> lock(s_ringsMutex);
+      s_ring = new Ring(s_rings.size() + 1);
+      s_rings.push_back(s_ring);
+    }
+    return s_ring;
+  }
+
+  void Enable(bool enable)
+  {
+    enabled.store(enable, std::memory_order_relaxed);
+  }
+
+  void Record(Phase phase, const char *name, const char *id, const char *arg)
+  {
+    Ring *ring = GetRing();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    Event &event = ring->events[head % RING_SIZE];
+    uint32_t seq = event.seq.load(std::memory_order_relaxed);
+    event.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.phase = phase;
+    event.ts_us = NowUs();
+    Copy(event.name, sizeof(event.name), name);
+    Copy(event.id, sizeof(event.id), id);
+    Copy(event.arg, sizeof(event.arg), arg);
+    event.seq.store(seq + 2, std::memory_order_release);
+    ring->head.store(head + 1, std::memory_order_release);
+  }
+
+  void Clear()
+  {
+    std::lock_guard<std::mutex> lock(s_ringsMutex);
+    for (Ring *ring : s_rings)
+    {
+      for (size_t i = 0; i < RING_SIZE; ++i)
+      {
+        ring->events[i].phase = 0;
+      }
+    }
+  }
+
+  const char *CurrentId()
+  {
+    return s_id;
+  }
+
+  IdScope::IdScope(const char *id)
+    : saved(s_id)
+  {
+    s_id = id;
+  }
+
+  IdScope::~IdScope()
+  {
+    s_id = saved;
+  }
+
+  static void AppendString(std::string &out, const char *str)
+  {
+    out += '"';
+    for (const char *p = str; *p; ++p)
+    {
+      if (*p == '"' || *p == '\\')
+      {
+        out += '\\';
+        out += *p;
+      }
+      else if ((unsigned char) *p < 0x20)
+      {
+        char esc[8];
+        snprintf(esc, sizeof(esc), "\\u%04x", *p);
+        out += esc;
+      }
+      else
+      {
+        out += *p;
+      }
+    }
+    out += '"';
+  }
+
+  void WriteChromeJson(std::string &out)
+  {
+    std::lock_guard<std::mutex> lock(s_ringsMutex);
+    char buf[64];
+    bool first = true;
+    out += "{\"traceEvents\":[";
+    for (Ring *ring : s_rings)
+    {
+      for (size_t i = 0; i < RING_SIZE; ++i)
+      {
+        // A copy that was overwritten while it was taken is dropped
+        const Event &event = ring->events[i];
+        uint32_t seq = event.seq.load(std::memory_order_acquire);
+        if (seq & 1)
+        {
+          continue;
+        }
+        Event copy;
+        copy.phase = event.phase;
+        copy.ts_us = event.ts_us;
+        memcpy(copy.name, event.name, sizeof(copy.name));
+        memcpy(copy.id, event.id, sizeof(copy.id));
+        memcpy(copy.arg, event.arg, sizeof(copy.arg));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (event.seq.load(std::memory_order_relaxed) != seq || !copy.phase)
+        {
+          continue;
+        }
+        out += first ? "\n" : ",\n";
+        first = false;
+        out += "{\"name\":";
+        AppendString(out, copy.name);
+        out += ",\"cat\":\"device\",\"ph\":\"";
+        out += copy.phase;
+        out += "\",\"id\":";
+        AppendString(out, copy.id);
+        snprintf(buf, sizeof(buf), ",\"ts\":%" PRIu64 ",\"pid\":%d,\"tid\":%u", copy.ts_us,
+            (int) getpid(), ring->tid);
+        out += buf;
+        if (copy.arg[0])
+        {
+          out += ",\"args\":{\"arg\":";
+          AppendString(out, copy.arg);
+          out += "}";
+        }
+        out += "}";
+      }
+    }
+    out += "\n],\"displayTimeUnit\":\"ms\"}\n";
+  }
+
+  bool WriteChromeJsonFile(const char *path)
+  {
+    std::string out;
+    WriteChromeJson(out);
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+      LOG(LOG_ERR, "fopen(%s) failed", path);
+      return false;
+    }
+    bool success = (fwrite(out.data(), 1, out.size(), file) == out.size());
+    success = (fclose(file) == 0) && success;
+    if (!success)
+    {
+      LOG(LOG_ERR, "writing %s failed", path);
+    }
+    return success;
+  }
+}
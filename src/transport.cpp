@@ -16,10 +16,7 @@
 #include "log.h"
 
 #include "transport.h"
-
-#define NONE_MSG    0xFFFF
-#define HELLO_MSG   0x0101     
-#define DATA_MSG    0x0201    
+#include "transport_message.h"
 
 #define CHECK_STATUS()                              \
   if (status != 0)                                  \
@@ -28,120 +25,6 @@
     exit(-1);                                       \
   }
 
-struct Message
-{
-  uint16_t nbytes;       
-  uint16_t primitive;    
-  HF::Common::ByteArray data;         
-
-  Message(uint16_t primitive = NONE_MSG):
-      primitive(primitive)
-  {}
-
-  Message(uint16_t primitive, HF::Common::ByteArray &data):
-      primitive(primitive), data(data)
-  {}
-
-  static constexpr uint16_t min_size = sizeof(nbytes) + sizeof(primitive);
-
-  uint16_t size() const
-  {
-    return min_size + data.size();
-  }
-
-  uint16_t pack(HF::Common::ByteArray &array, uint16_t offset = 0) const
-  {
-    HF_SERIALIZABLE_CHECK(array, offset, size());
-
-    uint16_t start = offset;
-
-    uint16_t temp  = (uint16_t) (sizeof(uint16_t) + data.size());
-
-    offset += array.write(offset, temp);
-
-    offset += array.write(offset, primitive);
-
-    std::copy(data.begin(), data.end(), array.begin() + offset);
-
-    return offset - start;
-  }
-
-  uint16_t unpack(HF::Common::ByteArray &array, uint16_t offset = 0)
-  {
-    HF_SERIALIZABLE_CHECK(array, offset, min_size);
-
-    uint16_t start = offset;
-
-    offset += array.read(offset, nbytes);
-
-    offset += array.read(offset, primitive);
-
-    uint16_t data_size = nbytes - sizeof(primitive);
-
-    data = HF::Common::ByteArray(data_size);
-
-    auto begin = array.begin();
-
-    begin += offset;
-
-    auto end = begin + data_size;
-
-    std::copy(begin, end, data.begin());
-
-    return offset - start;
-  }
-};
-
-struct HelloMessage
-{
-  uint8_t core;
-  uint8_t profiles;
-  uint8_t interfaces;
-  
-  HF::UID::UID uid;
-  
-  HelloMessage():
-    core(HF::CORE_VERSION), profiles(HF::PROFILES_VERSION), interfaces(HF::INTERFACES_VERSION)
-  {}
-  
-  static constexpr uint16_t min_size = 3 * sizeof(uint8_t);
-  
-  uint16_t size() const
-  {
-    return min_size + uid.size();
-  }
-  
-  uint16_t pack(HF::Common::ByteArray &array, uint16_t offset = 0) const
-  {
-    HF_SERIALIZABLE_CHECK(array, offset, size());
-    
-    uint16_t start = offset;
-    
-    offset += array.write(offset, core);
-    offset += array.write(offset, profiles);
-    offset += array.write(offset, interfaces);
-    
-    offset += uid.pack(array, offset);
-    
-    return offset - start;
-  }
-  
-  uint16_t unpack(HF::Common::ByteArray &array, uint16_t offset = 0)
-  {
-    HF_SERIALIZABLE_CHECK(array, offset, min_size);
-    
-    uint16_t start = offset;
-    
-    offset += array.read(offset, core);
-    offset += array.read(offset, profiles);
-    offset += array.read(offset, interfaces);
-    
-    uid.unpack(array, offset);
-    
-    return offset - start;
-  }
-};
-
 void alloc_buffer(uv_handle_t *handle, size_t suggested_size, uv_buf_t *buf)
 {
   UNUSED(handle);
@@ -190,6 +73,17 @@ static void on_read(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf)
   free(buf->base);
 }
 
+/* The payload must outlive the write; libuv may only queue it. */
+struct WriteRequest
+{
+  uv_write_t req;
+  HF::Common::ByteArray payload;
+
+  WriteRequest(uint16_t size):
+    payload(size)
+  {}
+};
+
 static void on_write(uv_write_t *req, int status)
 {
   CHECK_STATUS();
@@ -197,18 +91,18 @@ static void on_write(uv_write_t *req, int status)
   assert(req->type == UV_WRITE);
 
   /* Free the read/write buffer and the request */
-  free(req);
+  delete (WriteRequest *) req->data;
 }
 
 static void send_message(uv_stream_t *stream, Message &msg)
 {
-  HF::Common::ByteArray payload(msg.size());
-  msg.pack(payload);
+  WriteRequest *write = new WriteRequest(msg.size());
+  msg.pack(write->payload);
 
-  uv_write_t *req = (uv_write_t *) calloc(1, sizeof(uv_write_t));
-  uv_buf_t buf    = uv_buf_init((char *) payload.data(), payload.size());
+  write->req.data = write;
+  uv_buf_t buf    = uv_buf_init((char *) write->payload.data(), write->payload.size());
 
-  uv_write(req, (uv_stream_t *) stream, &buf, 1 /*nbufs*/, on_write);
+  uv_write(&write->req, (uv_stream_t *) stream, &buf, 1 /*nbufs*/, on_write);
 }
 
 static void send_hello(uv_stream_t *stream, Transport *transport)
@@ -248,6 +142,17 @@ static void handle_message(Link *link, Message &msg)
     }
     case DATA_MSG:
     {
+      // The frame is only parsed here when someone listens for the activity
+      if (transport->has_activity_cb())
+      {
+        HF::Protocol::Packet packet;
+
+        if (packet.unpack(msg.data) != 0)
+        {
+          transport->activity(packet.source.device);
+        }
+      }
+
       transport->receive(link, msg.data);
       break;
     }
@@ -284,7 +189,7 @@ static void on_connect(uv_connect_t *conn, int status)
   free(conn);
 }
 
-void Transport::initialize()
+void Transport::initialize(const char *address, uint16_t port)
 {
   LOG(LOG_TRACE, "[%p]", this);
 
@@ -297,7 +202,7 @@ void Transport::initialize()
   uv_connect_t *connect = (uv_connect_t *) calloc(1, sizeof(uv_connect_t));
 
   struct sockaddr_in dest;
-  uv_ip4_addr("127.0.0.1", 8000, &dest);
+  uv_ip4_addr(address, port, &dest);
 
   uv_tcp_connect(connect, &socket_, (const struct sockaddr *) &dest, on_connect);
 }
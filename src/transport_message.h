@@ -0,0 +1,129 @@
+#ifndef _TRANSPORT_MESSAGE_H
+#define _TRANSPORT_MESSAGE_H
+
+#include "hanfun.h"
+
+/*
+ * Frames exchanged over the TCP Transport: a 16-bit length of what follows,
+ * a 16-bit primitive, and the primitive's data.
+ */
+
+#define NONE_MSG    0xFFFF
+#define HELLO_MSG   0x0101     
+#define DATA_MSG    0x0201
+
+struct Message
+{
+  uint16_t nbytes;       
+  uint16_t primitive;    
+  HF::Common::ByteArray data;         
+
+  Message(uint16_t primitive = NONE_MSG):
+      primitive(primitive)
+  {}
+
+  Message(uint16_t primitive, HF::Common::ByteArray &data):
+      primitive(primitive), data(data)
+  {}
+
+  static constexpr uint16_t min_size = sizeof(nbytes) + sizeof(primitive);
+
+  uint16_t size() const
+  {
+    return min_size + data.size();
+  }
+
+  uint16_t pack(HF::Common::ByteArray &array, uint16_t offset = 0) const
+  {
+    HF_SERIALIZABLE_CHECK(array, offset, size());
+
+    uint16_t start = offset;
+
+    uint16_t temp  = (uint16_t) (sizeof(uint16_t) + data.size());
+
+    offset += array.write(offset, temp);
+
+    offset += array.write(offset, primitive);
+
+    std::copy(data.begin(), data.end(), array.begin() + offset);
+
+    return offset - start;
+  }
+
+  uint16_t unpack(HF::Common::ByteArray &array, uint16_t offset = 0)
+  {
+    HF_SERIALIZABLE_CHECK(array, offset, min_size);
+
+    uint16_t start = offset;
+
+    offset += array.read(offset, nbytes);
+
+    offset += array.read(offset, primitive);
+
+    uint16_t data_size = nbytes - sizeof(primitive);
+
+    data = HF::Common::ByteArray(data_size);
+
+    auto begin = array.begin();
+
+    begin += offset;
+
+    auto end = begin + data_size;
+
+    std::copy(begin, end, data.begin());
+
+    return offset - start;
+  }
+};
+
+struct HelloMessage
+{
+  uint8_t core;
+  uint8_t profiles;
+  uint8_t interfaces;
+  
+  HF::UID::UID uid;
+  
+  HelloMessage():
+    core(HF::CORE_VERSION), profiles(HF::PROFILES_VERSION), interfaces(HF::INTERFACES_VERSION)
+  {}
+  
+  static constexpr uint16_t min_size = 3 * sizeof(uint8_t);
+  
+  uint16_t size() const
+  {
+    return min_size + uid.size();
+  }
+  
+  uint16_t pack(HF::Common::ByteArray &array, uint16_t offset = 0) const
+  {
+    HF_SERIALIZABLE_CHECK(array, offset, size());
+    
+    uint16_t start = offset;
+    
+    offset += array.write(offset, core);
+    offset += array.write(offset, profiles);
+    offset += array.write(offset, interfaces);
+    
+    offset += uid.pack(array, offset);
+    
+    return offset - start;
+  }
+  
+  uint16_t unpack(HF::Common::ByteArray &array, uint16_t offset = 0)
+  {
+    HF_SERIALIZABLE_CHECK(array, offset, min_size);
+    
+    uint16_t start = offset;
+    
+    offset += array.read(offset, core);
+    offset += array.read(offset, profiles);
+    offset += array.read(offset, interfaces);
+    
+    uid.unpack(array, offset);
+    
+    return offset - start;
+  }
+};
+
+#endif // _TRANSPORT_MESSAGE_H
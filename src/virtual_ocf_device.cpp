@@ -3,6 +3,7 @@
 #include "device_resource.h"
 #include "log.h"
 #include "platform_resource.h"
+#include "resource.h"
 
 VirtualOcfDevice::VirtualOcfDevice(uint16_t address)
   : address_(address)
@@ -14,7 +15,7 @@ VirtualOcfDevice::VirtualOcfDevice(uint16_t address)
   {
     LOG(LOG_ERR, "OCGetResourceHandleAtUri(" OC_RSRVD_DEVICE_URI ") failed");
   }
-  OCStackResult result = OCBindResourceTypeToResource(handle, "oic.d.virtual");
+  OCStackResult result = BindResourceType(handle, "oic.d.virtual");
   if (result != OC_STACK_OK)
   {
     LOG(LOG_ERR, "OCBindResourceTypeToResource() - %d", result);
@@ -1,6 +1,7 @@
 #include "virtual_resource.h"
 
 #include "log.h"
+#include "resource.h"
 
 VirtualResource *VirtualResource::Create(uint16_t address, const char *path, CreateCB create_callback, void *create_context)
 {
@@ -15,7 +16,8 @@ VirtualResource *VirtualResource::Create(uint16_t address, const char *path, Cre
 }
 
 VirtualResource::VirtualResource(uint16_t address, const char *path, CreateCB create_callback, void *create_context)
-  : create_callback_(create_callback), create_context_(create_context)
+  : address_(address), create_callback_(create_callback), create_context_(create_context),
+    handle_(NULL)
 {
   (void) path;
   LOG(LOG_DEBUG, "[%p]", this);
@@ -28,8 +30,8 @@ VirtualResource::~VirtualResource()
   OCResourceHandle handle;
   while ((handle = OCGetResourceHandleFromCollection(handle_, 0)))
   {
-    OCUnBindResource(handle_, handle);
-    OCDeleteResource(handle);
+    UnBindResource(handle_, handle);
+    DeleteResource(handle);
   }
 }
 
@@ -0,0 +1,416 @@
+#include "uv.h"
+#include <algorithm>
+#include <map>
+#include <random>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/*
+ * Stands in for the CMBS base-station daemon that HanClient talks to.  It
+ * answers INIT, OPEN_REG, CLOSE_REG and GET_DEV_TABLE over the same UDP text
+ * protocol, from a synthetic device table that can churn, with injected reply
+ * latency and loss.  The time from each request to its reply is recorded.
+ */
+
+static const char *kAddress = "127.0.0.1";
+static uint16_t kPort = 3490;
+static size_t kDevices = 1000;
+static double kChurnPerSec = 0;
+static uint32_t kLatencyMs = 0;
+static uint32_t kJitterMs = 0;
+static double kLoss = 0;
+static uint32_t kSeed = 1;
+static uint32_t kReportSecs = 10;
+static const char *kTimingsFile = NULL;
+
+static const size_t MAX_DEVICES = 0x7ffe;
+static const uint64_t CHURN_PERIOD_MS = 100;
+
+struct Device
+{
+  uint16_t id;
+  uint8_t ipui[5];
+  uint8_t emc[2];
+};
+
+struct Stats
+{
+  uint64_t received;
+  uint64_t dropped;
+  std::vector<uint32_t> reply_us;
+  Stats() : received(0), dropped(0) {}
+};
+
+struct Reply
+{
+  uv_udp_send_t request;
+  uv_timer_t timer;
+  struct sockaddr_storage addr;
+  std::string text;
+  std::string command;
+  uint16_t index;
+  uint64_t received_us;
+};
+
+static uv_udp_t kSocket;
+static std::vector<Device> kTable;
+static uint64_t kGeneration = 0;
+static double kChurnDebt = 0;
+static uint64_t kChurned = 0;
+static std::mt19937 kRandom;
+static std::map<std::string, Stats> kStats;
+static FILE *kTimings = NULL;
+static bool kRegistrationOpen = false;
+
+static uint64_t NowUs()
+{
+  return uv_hrtime() / 1000;
+}
+
+// A device leaving and another joining at the same address gets a new IPUI.
+static void Join(Device &device)
+{
+  uint64_t ipui = ++kGeneration;
+  for (int i = 4; i >= 0; --i)
+  {
+    device.ipui[i] = ipui & 0xff;
+    ipui >>= 8;
+  }
+  device.emc[0] = kRandom() & 0xff;
+  device.emc[1] = kRandom() & 0xff;
+}
+
+static void CreateTable()
+{
+  kTable.resize(kDevices);
+  for (size_t i = 0; i < kDevices; ++i)
+  {
+    kTable[i].id = i + 1;
+    Join(kTable[i]);
+  }
+}
+
+static std::string GetParameter(const std::string &text, const char *name)
+{
+  std::string key = std::string(" ") + name + ": ";
+  size_t pos = text.find(key);
+  if (pos == std::string::npos)
+  {
+    return std::string();
+  }
+  pos += key.size();
+  return text.substr(pos, text.find("\r\n", pos) - pos);
+}
+
+static std::string DeviceTable(uint16_t index, uint8_t how_many)
+{
+  size_t begin = std::min((size_t) index, kTable.size());
+  size_t end = std::min(begin + how_many, kTable.size());
+  char line[128];
+  std::string text = "DEV_TABLE\r\n";
+  snprintf(line, sizeof(line), " DEV_INDEX: %u\r\n NO_OF_DEVICES: %u\r\n", index, (unsigned) (end - begin));
+  text += line;
+  for (size_t i = begin; i < end; ++i)
+  {
+    const Device &device = kTable[i];
+    snprintf(line, sizeof(line), " DEV_ID: %u\r\n DEV_IPUI: %u %u %u %u %u\r\n DEV_EMC: %u %u\r\n",
+             device.id, device.ipui[0], device.ipui[1], device.ipui[2], device.ipui[3], device.ipui[4],
+             device.emc[0], device.emc[1]);
+    text += line;
+  }
+  return text;
+}
+
+static void OnClose(uv_handle_t *handle)
+{
+  delete reinterpret_cast<Reply *>(handle->data);
+}
+
+static void OnSend(uv_udp_send_t *request, int status)
+{
+  Reply *reply = reinterpret_cast<Reply *>(request->data);
+  if (status < 0)
+  {
+    fprintf(stderr, "uv_udp_send - %s\n", uv_strerror(status));
+  }
+  uv_close((uv_handle_t *) &reply->timer, OnClose);
+}
+
+static void Send(uv_timer_t *timer)
+{
+  Reply *reply = reinterpret_cast<Reply *>(timer->data);
+  uint32_t us = NowUs() - reply->received_us;
+  kStats[reply->command].reply_us.push_back(us);
+  if (kTimings)
+  {
+    fprintf(kTimings, "%llu,%s,%u,%u\n", (unsigned long long) reply->received_us, reply->command.c_str(),
+            reply->index, us);
+  }
+  uv_buf_t buf = uv_buf_init(&reply->text[0], reply->text.size());
+  reply->request.data = reply;
+  int status = uv_udp_send(&reply->request, &kSocket, &buf, 1, (const struct sockaddr *) &reply->addr, OnSend);
+  if (status < 0)
+  {
+    fprintf(stderr, "uv_udp_send - %s\n", uv_strerror(status));
+    uv_close((uv_handle_t *) &reply->timer, OnClose);
+  }
+}
+
+static void OnAlloc(uv_handle_t *handle, size_t suggested_size, uv_buf_t *buf)
+{
+  (void) handle;
+  buf->base = (char *) malloc(suggested_size);
+  buf->len = suggested_size;
+}
+
+static void OnReceive(uv_udp_t *handle, ssize_t nread, const uv_buf_t *buf, const struct sockaddr *addr,
+                      unsigned flags)
+{
+  (void) handle;
+  (void) flags;
+  if (nread <= 0 || !addr)
+  {
+    free(buf->base);
+    return;
+  }
+  uint64_t received_us = NowUs();
+  std::string text(buf->base, nread);
+  free(buf->base);
+
+  // An optional [service] line precedes the command
+  size_t pos = 0;
+  if (text[0] == '[')
+  {
+    pos = text.find("\r\n") + 2;
+  }
+  std::string command = text.substr(pos, text.find("\r\n", pos) - pos);
+  Stats &stats = kStats[command];
+  ++stats.received;
+
+  Reply *reply = new Reply();
+  reply->command = command;
+  reply->index = 0;
+  reply->received_us = received_us;
+  if (command == "INIT")
+  {
+    reply->text = "INIT_RES\r\n VERSION: 1\r\n";
+  }
+  else if (command == "OPEN_REG")
+  {
+    kRegistrationOpen = true;
+    reply->text = "OPEN_REG_RES\r\n RESULT: 0\r\n";
+  }
+  else if (command == "CLOSE_REG")
+  {
+    kRegistrationOpen = false;
+    reply->text = "CLOSE_REG_RES\r\n RESULT: 0\r\n";
+  }
+  else if (command == "GET_DEV_TABLE")
+  {
+    reply->index = atoi(GetParameter(text, "DEV_INDEX").c_str());
+    reply->text = DeviceTable(reply->index, atoi(GetParameter(text, "HOW_MANY").c_str()));
+  }
+  else
+  {
+    fprintf(stderr, "Unknown command %s\n", command.c_str());
+    delete reply;
+    return;
+  }
+
+  if (std::uniform_real_distribution<double>(0, 1)(kRandom) < kLoss)
+  {
+    ++stats.dropped;
+    delete reply;
+    return;
+  }
+  memcpy(&reply->addr, addr, (addr->sa_family == AF_INET6) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+  uint64_t delay_ms = kLatencyMs;
+  if (kJitterMs)
+  {
+    delay_ms += kRandom() % (kJitterMs + 1);
+  }
+  uv_timer_init(uv_default_loop(), &reply->timer);
+  reply->timer.data = reply;
+  uv_timer_start(&reply->timer, Send, delay_ms, 0);
+}
+
+static void Churn(uv_timer_t *timer)
+{
+  (void) timer;
+  kChurnDebt += kChurnPerSec * CHURN_PERIOD_MS / 1000;
+  while (kChurnDebt >= 1 && !kTable.empty())
+  {
+    Join(kTable[kRandom() % kTable.size()]);
+    kChurnDebt -= 1;
+    ++kChurned;
+  }
+}
+
+static uint32_t Percentile(std::vector<uint32_t> &samples, size_t percent)
+{
+  if (samples.empty())
+  {
+    return 0;
+  }
+  std::sort(samples.begin(), samples.end());
+  return samples[(samples.size() - 1) * percent / 100];
+}
+
+static void Report(uv_timer_t *timer)
+{
+  (void) timer;
+  printf("devices=%zu churned=%llu registration=%s\n", kTable.size(), (unsigned long long) kChurned,
+         kRegistrationOpen ? "open" : "closed");
+  for (auto &kv : kStats)
+  {
+    Stats &stats = kv.second;
+    printf("  %-14s received=%llu dropped=%llu p50=%uus p99=%uus max=%uus\n", kv.first.c_str(),
+           (unsigned long long) stats.received, (unsigned long long) stats.dropped,
+           Percentile(stats.reply_us, 50), Percentile(stats.reply_us, 99), Percentile(stats.reply_us, 100));
+    stats.reply_us.clear();
+  }
+  fflush(stdout);
+  if (kTimings)
+  {
+    fflush(kTimings);
+  }
+}
+
+static void OnSignal(uv_signal_t *handle, int signum)
+{
+  (void) handle;
+  (void) signum;
+  Report(NULL);
+  uv_stop(uv_default_loop());
+}
+
+static void Usage(const char *argv0)
+{
+  printf("Usage: %s [options]\n"
+         "  --address ADDR      Address to listen on (default 127.0.0.1)\n"
+         "  --port PORT         Port to listen on (default 3490)\n"
+         "  --devices N         Devices in the table (default 1000, at most %zu)\n"
+         "  --churn N           Devices replaced per second (default 0)\n"
+         "  --latency MS        Delay before each reply (default 0)\n"
+         "  --jitter MS         Random extra delay up to MS (default 0)\n"
+         "  --loss FRACTION     Fraction of replies dropped, 0 to 1 (default 0)\n"
+         "  --seed N            Seed for churn, jitter and loss (default 1)\n"
+         "  --report SECS       Seconds between timing reports (default 10)\n"
+         "  --timings FILE      Append received_us,command,index,reply_us per reply\n",
+         argv0, MAX_DEVICES);
+}
+
+int main(int argc, char **argv)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "--address") && (i < (argc - 1)))
+    {
+      kAddress = argv[++i];
+    }
+    else if (!strcmp(argv[i], "--port") && (i < (argc - 1)))
+    {
+      kPort = strtoul(argv[++i], NULL, 10);
+    }
+    else if (!strcmp(argv[i], "--devices") && (i < (argc - 1)))
+    {
+      kDevices = std::min((size_t) strtoul(argv[++i], NULL, 10), MAX_DEVICES);
+    }
+    else if (!strcmp(argv[i], "--churn") && (i < (argc - 1)))
+    {
+      kChurnPerSec = strtod(argv[++i], NULL);
+    }
+    else if (!strcmp(argv[i], "--latency") && (i < (argc - 1)))
+    {
+      kLatencyMs = strtoul(argv[++i], NULL, 10);
+    }
+    else if (!strcmp(argv[i], "--jitter") && (i < (argc - 1)))
+    {
+      kJitterMs = strtoul(argv[++i], NULL, 10);
+    }
+    else if (!strcmp(argv[i], "--loss") && (i < (argc - 1)))
+    {
+      kLoss = strtod(argv[++i], NULL);
+    }
+    else if (!strcmp(argv[i], "--seed") && (i < (argc - 1)))
+    {
+      kSeed = strtoul(argv[++i], NULL, 10);
+    }
+    else if (!strcmp(argv[i], "--report") && (i < (argc - 1)))
+    {
+      kReportSecs = strtoul(argv[++i], NULL, 10);
+    }
+    else if (!strcmp(argv[i], "--timings") && (i < (argc - 1)))
+    {
+      kTimingsFile = argv[++i];
+    }
+    else
+    {
+      Usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  kRandom.seed(kSeed);
+  CreateTable();
+  if (kTimingsFile)
+  {
+    kTimings = fopen(kTimingsFile, "a");
+    if (!kTimings)
+    {
+      perror(kTimingsFile);
+      return EXIT_FAILURE;
+    }
+  }
+
+  uv_loop_t *loop = uv_default_loop();
+  struct sockaddr_in addr;
+  int status = uv_ip4_addr(kAddress, kPort, &addr);
+  if (status == 0)
+  {
+    status = uv_udp_init(loop, &kSocket);
+  }
+  if (status == 0)
+  {
+    status = uv_udp_bind(&kSocket, (const struct sockaddr *) &addr, UV_UDP_REUSEADDR);
+  }
+  if (status == 0)
+  {
+    status = uv_udp_recv_start(&kSocket, OnAlloc, OnReceive);
+  }
+  if (status < 0)
+  {
+    fprintf(stderr, "%s:%u - %s\n", kAddress, kPort, uv_strerror(status));
+    return EXIT_FAILURE;
+  }
+
+  uv_timer_t churn_timer;
+  uv_timer_init(loop, &churn_timer);
+  if (kChurnPerSec > 0)
+  {
+    uv_timer_start(&churn_timer, Churn, CHURN_PERIOD_MS, CHURN_PERIOD_MS);
+  }
+  uv_timer_t report_timer;
+  uv_timer_init(loop, &report_timer);
+  if (kReportSecs > 0)
+  {
+    uv_timer_start(&report_timer, Report, kReportSecs * 1000, kReportSecs * 1000);
+  }
+  uv_signal_t sigint;
+  uv_signal_init(loop, &sigint);
+  uv_signal_start(&sigint, OnSignal, SIGINT);
+
+  printf("Serving %zu devices on %s:%u\n", kTable.size(), kAddress, kPort);
+  fflush(stdout);
+  uv_run(loop, UV_RUN_DEFAULT);
+
+  if (kTimings)
+  {
+    fclose(kTimings);
+  }
+  return EXIT_SUCCESS;
+}
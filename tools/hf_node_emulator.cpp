@@ -0,0 +1,549 @@
+#include "log.h"
+#include "transport.h"
+#include "transport_message.h"
+
+#include "hanfun.h"
+#include "uv.h"
+#include <algorithm>
+#include <map>
+#include <random>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/*
+ * Plays the HAN-FUN base for Transport links: it listens where
+ * Transport::initialize() connects, answers HELLO_MSG, and then keeps a window
+ * of DATA_MSG frames outstanding on every link.  The frames are a mix of
+ * attribute reads, commands that want a response and commands that do not,
+ * addressed to a Simple Light unit.  Replies are matched by message reference
+ * to measure the round trip through Transport::receive and Link::send.
+ *
+ * With --nodes, the nodes are hosted in this process on real Transports;
+ * otherwise any process using Transport can connect.
+ */
+
+static const char *kAddress = "127.0.0.1";
+static uint16_t kPort = 8000;
+static size_t kNodes = 0;
+static size_t kWindow = 1;
+static uint32_t kMix[] = { 60, 30, 10 };
+static uint32_t kDurationSecs = 10;
+static uint32_t kTimeoutMs = 1000;
+static uint32_t kSeed = 1;
+
+// References are a byte, so at most this many frames can be told apart.
+static const size_t MAX_WINDOW = 255;
+// An unregistered node still has the broadcast address.
+static const uint16_t NODE_ADDRESS = 0x7fff;
+static const uint8_t LIGHT_UNIT = 1;
+static const uint16_t DEVICE_INFORMATION_ITF = 0x0005;
+static const uint16_t ON_OFF_ITF = 0x0200;
+static const uint8_t ON_OFF_TOGGLE_CMD = 0x03;
+static const uint8_t SERVER_ROLE = 1;
+
+enum Kind { READ, COMMAND, NOTIFY, KINDS };
+
+static const char *KindText[] = { "read", "command", "notify" };
+
+struct Stats
+{
+  uint64_t sent;
+  uint64_t replies;
+  uint64_t timeouts;
+  std::vector<uint32_t> rtt_us;
+  Stats() : sent(0), replies(0), timeouts(0) {}
+};
+
+struct Sent
+{
+  Kind kind;
+  uint64_t sent_us;
+};
+
+struct Peer
+{
+  uv_tcp_t socket;
+  std::vector<uint8_t> in;
+  std::map<uint8_t, Sent> outstanding;
+  size_t writing;
+  uint8_t reference;
+  bool hello;
+  Peer() : writing(0), reference(0), hello(false) {}
+};
+
+struct Write
+{
+  uv_write_t req;
+  Peer *peer;
+  bool frees_slot;
+  std::vector<uint8_t> frame;
+};
+
+typedef HF::Devices::Node::Unit0<HF::Core::DeviceInformation::Server,
+                                 HF::Core::DeviceManagement::Client,
+                                 HF::Core::AttributeReporting::Server
+                                > NodeUnit0;
+
+class Light : public HF::Units::Unit<HF::Profiles::SimpleLight>
+{
+  public:
+    Light(uint8_t index, HF::IDevice &device)
+      : HF::Units::Unit<HF::Profiles::SimpleLight>(index, device)
+    {}
+};
+
+class Node : public HF::Devices::Node::Abstract<NodeUnit0>
+{
+  public:
+    Light light;
+    Node() : light(LIGHT_UNIT, *this) {}
+};
+
+static uv_tcp_t kServer;
+static uv_timer_t kTimeoutTimer;
+static uv_timer_t kDurationTimer;
+static std::vector<Peer *> kPeers;
+static Stats kStats[KINDS];
+static uint64_t kFramesIn = 0;
+static uint64_t kFramesOut = 0;
+static uint64_t kStartUs = 0;
+static bool kRunning = true;
+static std::mt19937 kRandom;
+
+static uint64_t NowUs()
+{
+  return uv_hrtime() / 1000;
+}
+
+static void Put16(std::vector<uint8_t> &frame, uint16_t value)
+{
+  frame.push_back(value >> 8);
+  frame.push_back(value & 0xff);
+}
+
+// Frames are a 16-bit length of what follows, the primitive, and the data.
+static void Frame(std::vector<uint8_t> &frame, uint16_t primitive, const std::vector<uint8_t> &data)
+{
+  frame.clear();
+  Put16(frame, sizeof(uint16_t) + data.size());
+  Put16(frame, primitive);
+  frame.insert(frame.end(), data.begin(), data.end());
+}
+
+static void Packet(std::vector<uint8_t> &data, uint8_t reference, uint8_t type, uint16_t itf, uint8_t member)
+{
+  data.clear();
+  Put16(data, 0);                               // source: the base
+  data.push_back(0);
+  Put16(data, NODE_ADDRESS);                    // destination
+  data.push_back((itf == DEVICE_INFORMATION_ITF) ? 0 : LIGHT_UNIT);
+  Put16(data, 0);                               // transport, reserved
+  data.push_back(reference);
+  data.push_back(type);
+  Put16(data, (SERVER_ROLE << 15) | itf);
+  data.push_back(member);
+  Put16(data, 0);                               // payload length
+}
+
+static Kind PickKind()
+{
+  uint32_t total = kMix[READ] + kMix[COMMAND] + kMix[NOTIFY];
+  uint32_t r = total ? kRandom() % total : 0;
+  if (r < kMix[READ])
+  {
+    return READ;
+  }
+  return (r < kMix[READ] + kMix[COMMAND]) ? COMMAND : NOTIFY;
+}
+
+static void OnClose(uv_handle_t *handle)
+{
+  delete (Peer *) handle->data;
+}
+
+static void Close(Peer *peer)
+{
+  std::vector<Peer *>::iterator it = std::find(kPeers.begin(), kPeers.end(), peer);
+  if (it != kPeers.end())
+  {
+    kPeers.erase(it);
+    uv_close((uv_handle_t *) &peer->socket, OnClose);
+  }
+}
+
+static void Fill(Peer *peer);
+
+static void OnWrite(uv_write_t *req, int status)
+{
+  Write *write = (Write *) req->data;
+  Peer *peer = write->peer;
+  bool frees_slot = write->frees_slot;
+  if (frees_slot)
+  {
+    --peer->writing;
+  }
+  delete write;
+  if (status < 0)
+  {
+    fprintf(stderr, "write - %s\n", uv_strerror(status));
+  }
+  else if (frees_slot)
+  {
+    Fill(peer);
+  }
+}
+
+static bool Send(Peer *peer, uint16_t primitive, const std::vector<uint8_t> &data, bool frees_slot)
+{
+  Write *write = new Write();
+  write->req.data = write;
+  write->peer = peer;
+  write->frees_slot = frees_slot;
+  Frame(write->frame, primitive, data);
+  uv_buf_t buf = uv_buf_init((char *) write->frame.data(), write->frame.size());
+  int status = uv_write(&write->req, (uv_stream_t *) &peer->socket, &buf, 1, OnWrite);
+  if (status < 0)
+  {
+    fprintf(stderr, "uv_write - %s\n", uv_strerror(status));
+    delete write;
+    return false;
+  }
+  if (frees_slot)
+  {
+    ++peer->writing;
+  }
+  ++kFramesOut;
+  return true;
+}
+
+// Notifications have no reply; they hold their slot in the window until written.
+static void Fill(Peer *peer)
+{
+  std::vector<uint8_t> data;
+  while (kRunning && peer->hello && (peer->outstanding.size() + peer->writing < kWindow))
+  {
+    uint8_t reference = ++peer->reference;
+    if (peer->outstanding.count(reference))
+    {
+      continue;
+    }
+    Kind kind = PickKind();
+    switch (kind)
+    {
+      case READ:
+        Packet(data, reference, HF::Protocol::Message::GET_ATTR_REQ, DEVICE_INFORMATION_ITF,
+               HF::Core::DeviceInformation::CORE_VERSION_ATTR);
+        break;
+      case COMMAND:
+        Packet(data, reference, HF::Protocol::Message::COMMAND_RESP_REQ, ON_OFF_ITF, ON_OFF_TOGGLE_CMD);
+        break;
+      default:
+        Packet(data, reference, HF::Protocol::Message::COMMAND_REQ, ON_OFF_ITF, ON_OFF_TOGGLE_CMD);
+        break;
+    }
+    ++kStats[kind].sent;
+    if (kind != NOTIFY)
+    {
+      Sent sent = { kind, NowUs() };
+      peer->outstanding[reference] = sent;
+    }
+    if (!Send(peer, DATA_MSG, data, kind == NOTIFY))
+    {
+      break;
+    }
+  }
+}
+
+static void Hello(Peer *peer)
+{
+  static const char uri[] = "hf://base.emulator";
+  std::vector<uint8_t> data;
+  data.push_back(HF::CORE_VERSION);
+  data.push_back(HF::PROFILES_VERSION);
+  data.push_back(HF::INTERFACES_VERSION);
+  data.push_back(HF::UID::URI_UID);
+  data.push_back(sizeof(uri) - 1);
+  data.insert(data.end(), uri, uri + sizeof(uri) - 1);
+  Send(peer, HELLO_MSG, data, false);
+  peer->hello = true;
+  Fill(peer);
+}
+
+static void Reply(Peer *peer, const uint8_t *data, size_t size)
+{
+  // source(3) destination(3) transport(2) reference type
+  if (size < 10)
+  {
+    return;
+  }
+  uint8_t reference = data[8];
+  uint8_t type = data[9];
+  if ((type != HF::Protocol::Message::GET_ATTR_RES) && (type != HF::Protocol::Message::COMMAND_RES))
+  {
+    return;
+  }
+  std::map<uint8_t, Sent>::iterator it = peer->outstanding.find(reference);
+  if (it == peer->outstanding.end())
+  {
+    return;
+  }
+  Stats &stats = kStats[it->second.kind];
+  ++stats.replies;
+  stats.rtt_us.push_back(NowUs() - it->second.sent_us);
+  peer->outstanding.erase(it);
+  Fill(peer);
+}
+
+static void OnAlloc(uv_handle_t *handle, size_t suggested_size, uv_buf_t *buf)
+{
+  (void) handle;
+  buf->base = (char *) malloc(suggested_size);
+  buf->len = suggested_size;
+}
+
+static void OnRead(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf)
+{
+  Peer *peer = (Peer *) stream->data;
+  if (nread < 0)
+  {
+    Close(peer);
+  }
+  else if (nread > 0)
+  {
+    peer->in.insert(peer->in.end(), buf->base, buf->base + nread);
+    size_t offset = 0;
+    while (peer->in.size() - offset >= 4)
+    {
+      const uint8_t *p = &peer->in[offset];
+      size_t length = (p[0] << 8) | p[1];
+      if (peer->in.size() - offset < 2 + length)
+      {
+        break;
+      }
+      uint16_t primitive = (p[2] << 8) | p[3];
+      ++kFramesIn;
+      if (primitive == HELLO_MSG)
+      {
+        Hello(peer);
+      }
+      else if ((primitive == DATA_MSG) && (length >= 2))
+      {
+        Reply(peer, p + 4, length - 2);
+      }
+      offset += 2 + length;
+    }
+    peer->in.erase(peer->in.begin(), peer->in.begin() + offset);
+  }
+  free(buf->base);
+}
+
+static void OnConnection(uv_stream_t *server, int status)
+{
+  if (status < 0)
+  {
+    fprintf(stderr, "listen - %s\n", uv_strerror(status));
+    return;
+  }
+  Peer *peer = new Peer();
+  uv_tcp_init(uv_default_loop(), &peer->socket);
+  peer->socket.data = peer;
+  if (uv_accept(server, (uv_stream_t *) &peer->socket) == 0)
+  {
+    uv_tcp_nodelay(&peer->socket, 1);
+    kPeers.push_back(peer);
+    uv_read_start((uv_stream_t *) &peer->socket, OnAlloc, OnRead);
+  }
+  else
+  {
+    uv_close((uv_handle_t *) &peer->socket, OnClose);
+  }
+}
+
+static void OnTimeout(uv_timer_t *timer)
+{
+  (void) timer;
+  uint64_t now = NowUs();
+  for (Peer *peer : kPeers)
+  {
+    bool expired = false;
+    for (std::map<uint8_t, Sent>::iterator it = peer->outstanding.begin(); it != peer->outstanding.end(); )
+    {
+      if (now - it->second.sent_us >= kTimeoutMs * 1000ULL)
+      {
+        ++kStats[it->second.kind].timeouts;
+        it = peer->outstanding.erase(it);
+        expired = true;
+      }
+      else
+      {
+        ++it;
+      }
+    }
+    if (expired)
+    {
+      Fill(peer);
+    }
+  }
+}
+
+static uint32_t Percentile(std::vector<uint32_t> &values, double p)
+{
+  if (values.empty())
+  {
+    return 0;
+  }
+  size_t n = (size_t) (p * (values.size() - 1));
+  std::nth_element(values.begin(), values.begin() + n, values.end());
+  return values[n];
+}
+
+static void Report()
+{
+  double secs = (NowUs() - kStartUs) / 1e6;
+  printf("links=%zu window=%zu secs=%.1f frames/s out=%.0f in=%.0f\n", kPeers.size(), kWindow, secs,
+         kFramesOut / secs, kFramesIn / secs);
+  printf("%-8s %10s %10s %8s %10s %10s %10s\n", "kind", "sent", "replies", "timeouts", "p50_us", "p99_us",
+         "max_us");
+  for (int kind = 0; kind < KINDS; ++kind)
+  {
+    Stats &stats = kStats[kind];
+    uint32_t max = stats.rtt_us.empty() ? 0 : *std::max_element(stats.rtt_us.begin(), stats.rtt_us.end());
+    printf("%-8s %10llu %10llu %8llu %10u %10u %10u\n", KindText[kind], (unsigned long long) stats.sent,
+           (unsigned long long) stats.replies, (unsigned long long) stats.timeouts,
+           Percentile(stats.rtt_us, 0.50), Percentile(stats.rtt_us, 0.99), max);
+  }
+  fflush(stdout);
+}
+
+static void OnDuration(uv_timer_t *timer)
+{
+  (void) timer;
+  kRunning = false;
+  Report();
+  uv_stop(uv_default_loop());
+}
+
+static void SigIntCB(uv_signal_t *handle, int signum)
+{
+  (void) signum;
+  OnDuration(NULL);
+  uv_signal_stop(handle);
+}
+
+static void Usage(const char *name)
+{
+  printf("Usage: %s [options]\n", name);
+  printf("  --address ADDR     listen address (default %s)\n", kAddress);
+  printf("  --port PORT        listen port (default %u)\n", kPort);
+  printf("  --nodes N          host N nodes in this process (default %zu)\n", kNodes);
+  printf("  --window N         frames outstanding per link, at most %zu (default %zu)\n", MAX_WINDOW, kWindow);
+  printf("  --mix R:C:N        weights of attribute reads, commands with a response and\n");
+  printf("                     commands without one (default %u:%u:%u)\n", kMix[READ], kMix[COMMAND],
+         kMix[NOTIFY]);
+  printf("  --duration SECS    length of the run (default %u)\n", kDurationSecs);
+  printf("  --timeout MS       give up on a reply after MS milliseconds (default %u)\n", kTimeoutMs);
+  printf("  --seed N           random seed (default %u)\n", kSeed);
+}
+
+int main(int argc, char **argv)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "--address") && (i < (argc - 1)))
+    {
+      kAddress = argv[++i];
+    }
+    else if (!strcmp(argv[i], "--port") && (i < (argc - 1)))
+    {
+      kPort = strtoul(argv[++i], NULL, 10);
+    }
+    else if (!strcmp(argv[i], "--nodes") && (i < (argc - 1)))
+    {
+      kNodes = strtoul(argv[++i], NULL, 10);
+    }
+    else if (!strcmp(argv[i], "--window") && (i < (argc - 1)))
+    {
+      kWindow = std::min(std::max((size_t) strtoul(argv[++i], NULL, 10), (size_t) 1), MAX_WINDOW);
+    }
+    else if (!strcmp(argv[i], "--mix") && (i < (argc - 1)))
+    {
+      if (sscanf(argv[++i], "%u:%u:%u", &kMix[READ], &kMix[COMMAND], &kMix[NOTIFY]) != 3)
+      {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    }
+    else if (!strcmp(argv[i], "--duration") && (i < (argc - 1)))
+    {
+      kDurationSecs = strtoul(argv[++i], NULL, 10);
+    }
+    else if (!strcmp(argv[i], "--timeout") && (i < (argc - 1)))
+    {
+      kTimeoutMs = strtoul(argv[++i], NULL, 10);
+    }
+    else if (!strcmp(argv[i], "--seed") && (i < (argc - 1)))
+    {
+      kSeed = strtoul(argv[++i], NULL, 10);
+    }
+    else
+    {
+      Usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  kRandom.seed(kSeed);
+  uv_loop_t *loop = uv_default_loop();
+  struct sockaddr_in addr;
+  int status = uv_ip4_addr(kAddress, kPort, &addr);
+  if (status == 0)
+  {
+    status = uv_tcp_init(loop, &kServer);
+  }
+  if (status == 0)
+  {
+    status = uv_tcp_bind(&kServer, (const struct sockaddr *) &addr, 0);
+  }
+  if (status == 0)
+  {
+    status = uv_listen((uv_stream_t *) &kServer, SOMAXCONN, OnConnection);
+  }
+  if (status < 0)
+  {
+    fprintf(stderr, "%s:%u - %s\n", kAddress, kPort, uv_strerror(status));
+    return EXIT_FAILURE;
+  }
+
+  std::vector<Transport *> transports;
+  std::vector<Node *> nodes;
+  for (size_t i = 0; i < kNodes; ++i)
+  {
+    Transport *transport = new Transport();
+    Node *node = new Node();
+    transport->initialize(kAddress, kPort);
+    transport->uid(new HF::UID::URI("hf://node.emulator/" + std::to_string(i)));
+    transport->add(node);
+    transports.push_back(transport);
+    nodes.push_back(node);
+  }
+
+  uv_signal_t sigint;
+  uv_signal_init(loop, &sigint);
+  uv_signal_start(&sigint, SigIntCB, SIGINT);
+  uv_timer_init(loop, &kTimeoutTimer);
+  uv_timer_start(&kTimeoutTimer, OnTimeout, 100, 100);
+  uv_timer_init(loop, &kDurationTimer);
+  uv_timer_start(&kDurationTimer, OnDuration, kDurationSecs * 1000ULL, 0);
+  kStartUs = NowUs();
+  uv_run(loop, UV_RUN_DEFAULT);
+
+  for (size_t i = 0; i < transports.size(); ++i)
+  {
+    transports[i]->destroy();
+  }
+  return EXIT_SUCCESS;
+}
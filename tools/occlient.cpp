@@ -18,11 +18,16 @@
 //
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
+#include <algorithm>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/tokenizer.hpp>
+#include <chrono>
 #include <iostream>
 #include <poll.h>
+#include <random>
+#include <set>
 #include <sstream>
+#include <thread>
 
 #include "cJSON.h"
 #include "cacommon.h"
@@ -186,19 +191,8 @@ struct Resource
 };
 static std::vector<Resource> g_resources;
 
-static OCStackApplicationResult DiscoverCB(void *context, OCDoHandle,
-        OCClientResponse *response)
+static void AddResources(OCClientResponse *response)
 {
-    uint16_t format = (uint16_t)(uintptr_t)context;
-    switch (format)
-    {
-        case COAP_MEDIATYPE_APPLICATION_VND_OCF_CBOR:
-            LogResponse(OC_REST_DISCOVER, response, OC_FORMAT_VND_OCF_CBOR);
-            break;
-        case COAP_MEDIATYPE_APPLICATION_CBOR:
-            LogResponse(OC_REST_DISCOVER, response, OC_FORMAT_CBOR);
-            break;
-    }
     if (response && response->payload && (response->payload->type == PAYLOAD_TYPE_DISCOVERY))
     {
         OCDiscoveryPayload *payload = (OCDiscoveryPayload *) response->payload;
@@ -259,6 +253,22 @@ static OCStackApplicationResult DiscoverCB(void *context, OCDoHandle,
             payload = payload->next;
         }
     }
+}
+
+static OCStackApplicationResult DiscoverCB(void *context, OCDoHandle,
+        OCClientResponse *response)
+{
+    uint16_t format = (uint16_t)(uintptr_t)context;
+    switch (format)
+    {
+        case COAP_MEDIATYPE_APPLICATION_VND_OCF_CBOR:
+            LogResponse(OC_REST_DISCOVER, response, OC_FORMAT_VND_OCF_CBOR);
+            break;
+        case COAP_MEDIATYPE_APPLICATION_CBOR:
+            LogResponse(OC_REST_DISCOVER, response, OC_FORMAT_CBOR);
+            break;
+    }
+    AddResources(response);
     return OC_STACK_KEEP_TRANSACTION;
 }
 
@@ -314,6 +324,458 @@ static void usage()
               << "  observe INDEX [QUERY PARAM]" << std::endl;
 }
 
+/*
+ * Load mode: the resources found by discovery are sent a mix of GET, POST and
+ * OBSERVE requests, either at a fixed rate or with a fixed number of requests
+ * outstanding, and the latencies are reported at the end of the run.
+ */
+enum LoadKind
+{
+    LOAD_GET,
+    LOAD_POST,
+    LOAD_OBSERVE,
+    LOAD_KINDS
+};
+static const char *LoadKindText[] = { "GET", "POST", "OBSERVE" };
+
+struct LoadOptions
+{
+    std::string rt;
+    unsigned mix[LOAD_KINDS];
+    unsigned rate;
+    unsigned concurrency;
+    unsigned duration;
+    unsigned discover;
+    unsigned timeout;
+    std::string post;
+    uint32_t seed;
+    LoadOptions() : rate(0), concurrency(1), duration(10), discover(3), timeout(5000), seed(1)
+    {
+        mix[LOAD_GET] = 80;
+        mix[LOAD_POST] = 15;
+        mix[LOAD_OBSERVE] = 5;
+    }
+};
+static LoadOptions g_load;
+
+struct LoadStats
+{
+    uint64_t sent;
+    uint64_t errors;
+    uint64_t timeouts;
+    std::vector<uint32_t> latency_us;
+    LoadStats() : sent(0), errors(0), timeouts(0) {}
+};
+static LoadStats g_loadStats[LOAD_KINDS];
+static std::vector<uint32_t> g_notifyLag_us;
+static uint64_t g_notifications = 0;
+static uint64_t g_cancels = 0;
+static uint64_t g_missed = 0;
+
+struct LoadTarget
+{
+    size_t resource;
+    OCRepPayload *last;
+    OCDoHandle observe;
+    /* When the earliest POST not yet followed by a notification was sent. */
+    uint64_t post_us;
+};
+static std::vector<LoadTarget> g_targets;
+
+struct LoadRequest
+{
+    LoadKind kind;
+    size_t target;
+    OCDoHandle handle;
+    uint64_t sent_us;
+    bool answered;
+};
+/* The requests not yet answered; they count against the concurrency. */
+static std::set<LoadRequest *> g_inflight;
+static std::mt19937 g_random;
+
+static uint64_t NowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void LoadDeleteCB(void *context)
+{
+    LoadRequest *request = (LoadRequest *) context;
+    g_inflight.erase(request);
+    LoadTarget &target = g_targets[request->target];
+    if ((request->kind == LOAD_OBSERVE) && (target.observe == request->handle))
+    {
+        target.observe = NULL;
+    }
+    delete request;
+}
+
+/* Returns false when the response is an error. */
+static bool Answer(LoadRequest *request, OCClientResponse *response)
+{
+    bool ok = response && (response->result <= OC_STACK_RESOURCE_CHANGED);
+    if (request->answered)
+    {
+        return ok;
+    }
+    request->answered = true;
+    g_inflight.erase(request);
+    LoadStats &stats = g_loadStats[request->kind];
+    if (ok)
+    {
+        stats.latency_us.push_back(NowUs() - request->sent_us);
+    }
+    else
+    {
+        ++stats.errors;
+    }
+    return ok;
+}
+
+static void KeepRepresentation(LoadTarget &target, OCClientResponse *response)
+{
+    if (g_load.post.empty() && response->payload &&
+            (response->payload->type == PAYLOAD_TYPE_REPRESENTATION))
+    {
+        OCRepPayloadDestroy(target.last);
+        target.last = OCRepPayloadClone((OCRepPayload *) response->payload);
+    }
+}
+
+static OCStackApplicationResult LoadCB(void *context, OCDoHandle, OCClientResponse *response)
+{
+    LoadRequest *request = (LoadRequest *) context;
+    if (Answer(request, response) && (request->kind == LOAD_GET))
+    {
+        KeepRepresentation(g_targets[request->target], response);
+    }
+    return OC_STACK_DELETE_TRANSACTION;
+}
+
+static OCStackApplicationResult LoadObserveCB(void *context, OCDoHandle, OCClientResponse *response)
+{
+    LoadRequest *request = (LoadRequest *) context;
+    LoadTarget &target = g_targets[request->target];
+    bool is_registration = !request->answered;
+    if (!Answer(request, response) || !response->payload)
+    {
+        return OC_STACK_DELETE_TRANSACTION;
+    }
+    KeepRepresentation(target, response);
+    if (!is_registration)
+    {
+        ++g_notifications;
+        if (target.post_us)
+        {
+            g_notifyLag_us.push_back(NowUs() - target.post_us);
+            target.post_us = 0;
+        }
+    }
+    return OC_STACK_KEEP_TRANSACTION;
+}
+
+static OCRepPayload *CreatePostPayload(LoadTarget &target)
+{
+    if (g_load.post.empty())
+    {
+        return target.last ? OCRepPayloadClone(target.last) : NULL;
+    }
+    uint8_t buffer[32768];
+    size_t size = ConvertJSONToCBOR(g_load.post.c_str(), buffer, sizeof(buffer));
+    if (!size)
+    {
+        return NULL;
+    }
+    OCRepPayload *payload = NULL;
+    if (OCParsePayload((OCPayload **) &payload, OC_FORMAT_CBOR, PAYLOAD_TYPE_REPRESENTATION,
+            buffer, size) != OC_STACK_OK)
+    {
+        OCRepPayloadDestroy(payload);
+        return NULL;
+    }
+    return payload;
+}
+
+static LoadKind PickKind()
+{
+    unsigned total = g_load.mix[LOAD_GET] + g_load.mix[LOAD_POST] + g_load.mix[LOAD_OBSERVE];
+    unsigned n = std::uniform_int_distribution<unsigned>(0, total - 1)(g_random);
+    if (n < g_load.mix[LOAD_GET])
+    {
+        return LOAD_GET;
+    }
+    if (n < g_load.mix[LOAD_GET] + g_load.mix[LOAD_POST])
+    {
+        return LOAD_POST;
+    }
+    return LOAD_OBSERVE;
+}
+
+static void Issue()
+{
+    size_t t = std::uniform_int_distribution<size_t>(0, g_targets.size() - 1)(g_random);
+    LoadTarget &target = g_targets[t];
+    Resource &resource = g_resources[target.resource];
+    LoadKind kind = PickKind();
+    OCPayload *payload = NULL;
+    if (kind == LOAD_POST)
+    {
+        payload = (OCPayload *) CreatePostPayload(target);
+        if (!payload)
+        {
+            // Nothing to post back before the first representation
+            kind = LOAD_GET;
+        }
+    }
+    else if ((kind == LOAD_OBSERVE) && target.observe)
+    {
+        // Observations are toggled, so registrations keep coming
+        OCCancel(target.observe, OC_HIGH_QOS, NULL, 0);
+        target.observe = NULL;
+        ++g_cancels;
+        return;
+    }
+    LoadRequest *request = new LoadRequest();
+    request->kind = kind;
+    request->target = t;
+    request->handle = NULL;
+    request->answered = false;
+    OCCallbackData cbData;
+    cbData.cb = (kind == LOAD_OBSERVE) ? LoadObserveCB : LoadCB;
+    cbData.context = request;
+    cbData.cd = LoadDeleteCB;
+    static const OCMethod methods[] = { OC_REST_GET, OC_REST_POST, OC_REST_OBSERVE };
+    request->sent_us = NowUs();
+    OCStackResult result = OCDoResource(&request->handle, methods[kind], resource.uri.c_str(),
+            &resource.devAddr, payload, CT_DEFAULT, OC_HIGH_QOS, &cbData, NULL, 0);
+    OCPayloadDestroy(payload);
+    ++g_loadStats[kind].sent;
+    if (result != OC_STACK_OK)
+    {
+        // The request is left to LoadDeleteCB, which the stack calls on some failures
+        ++g_loadStats[kind].errors;
+        return;
+    }
+    g_inflight.insert(request);
+    if (kind == LOAD_OBSERVE)
+    {
+        target.observe = request->handle;
+    }
+    else if ((kind == LOAD_POST) && !target.post_us)
+    {
+        target.post_us = request->sent_us;
+    }
+}
+
+static void ExpireRequests(uint64_t now_us)
+{
+    std::vector<LoadRequest *> expired;
+    for (LoadRequest *request : g_inflight)
+    {
+        if (now_us - request->sent_us > g_load.timeout * 1000ull)
+        {
+            expired.push_back(request);
+        }
+    }
+    for (LoadRequest *request : expired)
+    {
+        ++g_loadStats[request->kind].timeouts;
+        request->answered = true;
+        g_inflight.erase(request);
+        OCCancel(request->handle, OC_HIGH_QOS, NULL, 0);
+    }
+}
+
+static uint32_t Percentile(std::vector<uint32_t> &values, double p)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+    size_t n = (size_t) (p * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + n, values.end());
+    return values[n];
+}
+
+static void LoadReport(double secs)
+{
+    uint64_t answered = 0;
+    for (int kind = 0; kind < LOAD_KINDS; ++kind)
+    {
+        answered += g_loadStats[kind].latency_us.size();
+    }
+    printf("resources=%zu secs=%.1f requests/s=%.0f missed=%llu\n", g_targets.size(), secs,
+           answered / secs, (unsigned long long) g_missed);
+    printf("%-8s %9s %7s %8s %9s %9s %9s %9s\n", "kind", "sent", "err%", "timeouts", "p50_us", "p90_us",
+           "p99_us", "p999_us");
+    for (int kind = 0; kind < LOAD_KINDS; ++kind)
+    {
+        LoadStats &stats = g_loadStats[kind];
+        printf("%-8s %9llu %7.2f %8llu %9u %9u %9u %9u\n", LoadKindText[kind],
+               (unsigned long long) stats.sent,
+               stats.sent ? (100.0 * (stats.errors + stats.timeouts) / stats.sent) : 0.0,
+               (unsigned long long) stats.timeouts,
+               Percentile(stats.latency_us, 0.50), Percentile(stats.latency_us, 0.90),
+               Percentile(stats.latency_us, 0.99), Percentile(stats.latency_us, 0.999));
+    }
+    printf("notifications=%llu cancels=%llu lag_us p50=%u p90=%u p99=%u p999=%u\n",
+           (unsigned long long) g_notifications, (unsigned long long) g_cancels,
+           Percentile(g_notifyLag_us, 0.50), Percentile(g_notifyLag_us, 0.90),
+           Percentile(g_notifyLag_us, 0.99), Percentile(g_notifyLag_us, 0.999));
+    fflush(stdout);
+}
+
+static bool IsLoadTarget(const Resource &resource)
+{
+    if (resource.di == OCGetServerInstanceIDString())
+    {
+        return false;
+    }
+    if (g_load.rt.empty() && !resource.uri.compare(0, 5, "/oic/"))
+    {
+        return false;
+    }
+    for (const LoadTarget &target : g_targets)
+    {
+        const Resource &r = g_resources[target.resource];
+        if ((r.di == resource.di) && (r.uri == resource.uri))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool Process()
+{
+    if (OCProcess() != OC_STACK_OK)
+    {
+        std::cerr << "OCStack process error" << std::endl;
+        return false;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+    return true;
+}
+
+static OCStackApplicationResult LoadDiscoverCB(void *, OCDoHandle, OCClientResponse *response)
+{
+    AddResources(response);
+    return OC_STACK_KEEP_TRANSACTION;
+}
+
+static int RunLoad()
+{
+    std::string uri = "/oic/res";
+    if (!g_load.rt.empty())
+    {
+        uri += "?rt=" + g_load.rt;
+    }
+    OCCallbackData cbData;
+    cbData.cb = LoadDiscoverCB;
+    cbData.context = NULL;
+    cbData.cd = NULL;
+    OCDoHandle discoverHandle;
+    OCStackResult result = OCDoResource(&discoverHandle, OC_REST_DISCOVER, uri.c_str(), NULL, 0,
+            CT_DEFAULT, OC_HIGH_QOS, &cbData, NULL, 0);
+    if (result != OC_STACK_OK)
+    {
+        std::cerr << "find " << uri << " - " << result << std::endl;
+        return EXIT_FAILURE;
+    }
+    uint64_t end_us = NowUs() + g_load.discover * 1000000ull;
+    while (NowUs() < end_us)
+    {
+        if (!Process())
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    OCCancel(discoverHandle, OC_HIGH_QOS, NULL, 0);
+    for (size_t i = 0; i < g_resources.size(); ++i)
+    {
+        if (IsLoadTarget(g_resources[i]))
+        {
+            LoadTarget target = { i, NULL, NULL, 0 };
+            g_targets.push_back(target);
+        }
+    }
+    if (g_targets.empty())
+    {
+        std::cerr << "No resources found" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    g_random.seed(g_load.seed);
+    uint64_t start_us = NowUs();
+    uint64_t next_us = start_us;
+    end_us = start_us + g_load.duration * 1000000ull;
+    uint64_t now_us;
+    while ((now_us = NowUs()) < end_us)
+    {
+        if (g_load.rate)
+        {
+            // Open loop: a slot that finds the concurrency used up is missed, not delayed
+            while (next_us <= now_us)
+            {
+                if (g_inflight.size() < g_load.concurrency)
+                {
+                    Issue();
+                }
+                else
+                {
+                    ++g_missed;
+                }
+                next_us += std::max(1000000u / g_load.rate, 1u);
+            }
+        }
+        else
+        {
+            while (g_inflight.size() < g_load.concurrency)
+            {
+                Issue();
+            }
+        }
+        ExpireRequests(now_us);
+        if (!Process())
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    double secs = (NowUs() - start_us) / 1e6;
+    // Requests still in flight at the end are left out of the report
+    for (LoadTarget &target : g_targets)
+    {
+        if (target.observe)
+        {
+            OCCancel(target.observe, OC_HIGH_QOS, NULL, 0);
+        }
+        OCRepPayloadDestroy(target.last);
+        target.last = NULL;
+    }
+    LoadReport(secs);
+    return EXIT_SUCCESS;
+}
+
+static void LoadUsage(const char *name)
+{
+    printf("Usage: %s [--load [options]]\n", name);
+    printf("Without --load, commands are read from stdin; enter an empty line for help.\n");
+    printf("  --load             send requests to the discovered resources and report the latencies\n");
+    printf("  --rt TYPE          only load resources of this resource type (default all but /oic/*)\n");
+    printf("  --mix G:P:O        weights of GET, POST and OBSERVE requests; an OBSERVE request\n");
+    printf("                     cancels an existing observation (default %u:%u:%u)\n", g_load.mix[LOAD_GET],
+           g_load.mix[LOAD_POST], g_load.mix[LOAD_OBSERVE]);
+    printf("  --rate N           send N requests per second (default as fast as --concurrency allows)\n");
+    printf("  --concurrency N    requests outstanding at most (default %u)\n", g_load.concurrency);
+    printf("  --duration SECS    length of the run (default %u)\n", g_load.duration);
+    printf("  --discover SECS    time spent finding resources (default %u)\n", g_load.discover);
+    printf("  --timeout MS       give up on a response after MS milliseconds (default %u)\n", g_load.timeout);
+    printf("  --post JSON        body of POST requests (default the last representation received)\n");
+    printf("  --seed N           random seed (default %u)\n", g_load.seed);
+}
+
 static FILE *PSOpenCB(const char *suffix, const char *mode)
 {
     std::string path = std::string("occlient_") + suffix;
@@ -334,10 +796,66 @@ static void ClosePinDisplayCB()
 }
 #endif
 
-int main(int, char **)
+int main(int argc, char **argv)
 {
     std::cout.setf(std::ios::boolalpha);
 
+    bool load = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--load"))
+        {
+            load = true;
+        }
+        else if (!strcmp(argv[i], "--rt") && (i < (argc - 1)))
+        {
+            g_load.rt = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--mix") && (i < (argc - 1)))
+        {
+            if ((sscanf(argv[++i], "%u:%u:%u", &g_load.mix[LOAD_GET], &g_load.mix[LOAD_POST],
+                    &g_load.mix[LOAD_OBSERVE]) != 3) ||
+                    (g_load.mix[LOAD_GET] + g_load.mix[LOAD_POST] + g_load.mix[LOAD_OBSERVE] == 0))
+            {
+                LoadUsage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (!strcmp(argv[i], "--rate") && (i < (argc - 1)))
+        {
+            g_load.rate = std::min(strtoul(argv[++i], NULL, 10), 1000000ul);
+        }
+        else if (!strcmp(argv[i], "--concurrency") && (i < (argc - 1)))
+        {
+            g_load.concurrency = std::max(strtoul(argv[++i], NULL, 10), 1ul);
+        }
+        else if (!strcmp(argv[i], "--duration") && (i < (argc - 1)))
+        {
+            g_load.duration = strtoul(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--discover") && (i < (argc - 1)))
+        {
+            g_load.discover = strtoul(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--timeout") && (i < (argc - 1)))
+        {
+            g_load.timeout = strtoul(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--post") && (i < (argc - 1)))
+        {
+            g_load.post = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--seed") && (i < (argc - 1)))
+        {
+            g_load.seed = strtoul(argv[++i], NULL, 10);
+        }
+        else
+        {
+            LoadUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
     OCPersistentStorage ps = { PSOpenCB, fread, fwrite, fclose, unlink };
     if (OCRegisterPersistentStorageHandler(&ps) != OC_STACK_OK)
     {
@@ -384,6 +902,15 @@ int main(int, char **)
         std::cerr << "OCSetPropertyValue error" << std::endl;
         return EXIT_FAILURE;
     }
+    if (load)
+    {
+        int ret = RunLoad();
+        if (OCStop() != OC_STACK_OK)
+        {
+            std::cerr << "OCStack stop error" << std::endl;
+        }
+        return ret;
+    }
 
     for (;;)
     {
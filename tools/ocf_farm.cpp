@@ -0,0 +1,496 @@
+#include "introspection.h"
+#include "log.h"
+
+#include "ocpayload.h"
+#include "ocstack.h"
+#include "oic_malloc.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <set>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * Hosts a farm of OCF servers on the local host for discovery benchmarks.
+ * IoTivity keeps one device per stack, so each device is a forked process
+ * with its own persistent storage.  Every device has the same shape: a number
+ * of resources cycling through the given resource types, optionally linked
+ * from a collection, with or without an introspection document, on the
+ * selected endpoints.  Replies from the device's resources can be delayed.
+ *
+ * Each device prints one line once it is discoverable:
+ *   started di=<di> t=<steady clock ms>
+ */
+
+static size_t kDevices = 10;
+static size_t kResources = 4;
+static std::vector<std::string> kTypes;
+static bool kCollection = false;
+static bool kIntrospection = true;
+static uint32_t kLatencyMs = 0;
+static uint32_t kJitterMs = 0;
+static uint32_t kSeed = 1;
+static int kFlags = OC_DEFAULT_FLAGS;
+static int kAdapters = OC_ADAPTER_IP;
+static const char *kPersistentStoragePrefix = "OCFFarm_";
+static volatile sig_atomic_t kQuitFlag = false;
+
+static const size_t MAX_DEVICES = 4096;
+
+struct Resource
+{
+  std::string uri;
+  std::string type;
+  OCResourceHandle handle;
+  int64_t value;
+};
+
+struct Pending
+{
+  OCRequestHandle request;
+  Resource *resource;
+  uint64_t due_ms;
+};
+
+static std::vector<Resource> kDeviceResources;
+static std::vector<Pending> kPending;
+static std::mt19937 kRandom;
+static size_t kIndex = 0;
+
+static uint64_t NowMs()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void SigIntCB(int signal)
+{
+  (void) signal;
+  kQuitFlag = true;
+}
+
+static FILE *PSOpenCB(const char *suffix, const char *mode)
+{
+  std::string path = kPersistentStoragePrefix + std::to_string(kIndex) + "_" + suffix;
+  return fopen(path.c_str(), mode);
+}
+
+static OCRepPayload *Representation(Resource *resource)
+{
+  OCRepPayload *payload = OCRepPayloadCreate();
+  if (!payload)
+  {
+    LOG(LOG_ERR, "Failed to create payload");
+    return NULL;
+  }
+  OCRepPayloadSetUri(payload, resource->uri.c_str());
+  OCRepPayloadAddResourceType(payload, resource->type.c_str());
+  OCRepPayloadAddInterface(payload, OC_RSRVD_INTERFACE_DEFAULT);
+  OCRepPayloadAddInterface(payload, OC_RSRVD_INTERFACE_READ_WRITE);
+  if (resource->type == "oic.r.switch.binary")
+  {
+    OCRepPayloadSetPropBool(payload, "value", resource->value & 1);
+  }
+  else if (resource->type == "oic.r.temperature")
+  {
+    OCRepPayloadSetPropDouble(payload, "temperature", 20.0 + resource->value);
+    OCRepPayloadSetPropString(payload, "units", "C");
+  }
+  else
+  {
+    OCRepPayloadSetPropInt(payload, "value", resource->value);
+  }
+  return payload;
+}
+
+static OCStackResult Respond(OCRequestHandle request, Resource *resource)
+{
+  OCEntityHandlerResponse response;
+  memset(&response, 0, sizeof(response));
+  response.requestHandle = request;
+  response.resourceHandle = resource->handle;
+  response.ehResult = OC_EH_OK;
+  response.payload = reinterpret_cast<OCPayload *>(Representation(resource));
+  OCStackResult result = OCDoResponse(&response);
+  if (result != OC_STACK_OK)
+  {
+    LOG(LOG_ERR, "OCDoResponse() - %d", result);
+  }
+  OCPayloadDestroy(response.payload);
+  return result;
+}
+
+static OCEntityHandlerResult EntityHandlerCB(OCEntityHandlerFlag flag, OCEntityHandlerRequest *request,
+                                             void *context)
+{
+  Resource *resource = reinterpret_cast<Resource *>(context);
+  if (!(flag & OC_REQUEST_FLAG))
+  {
+    return OC_EH_OK;
+  }
+  switch (request->method)
+  {
+    case OC_REST_GET:
+      break;
+    case OC_REST_POST:
+      ++resource->value;
+      OCNotifyAllObservers(resource->handle, OC_NA_QOS);
+      break;
+    default:
+      return OC_EH_METHOD_NOT_ALLOWED;
+  }
+  if (kLatencyMs || kJitterMs)
+  {
+    Pending pending;
+    pending.request = request->requestHandle;
+    pending.resource = resource;
+    pending.due_ms = NowMs() + kLatencyMs + (kJitterMs ? kRandom() % (kJitterMs + 1) : 0);
+    kPending.push_back(pending);
+    return OC_EH_SLOW;
+  }
+  return (Respond(request->requestHandle, resource) == OC_STACK_OK) ? OC_EH_OK : OC_EH_ERROR;
+}
+
+static void RespondDue()
+{
+  uint64_t now = NowMs();
+  for (std::vector<Pending>::iterator it = kPending.begin(); it != kPending.end(); )
+  {
+    if (it->due_ms <= now)
+    {
+      Respond(it->request, it->resource);
+      it = kPending.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
+static bool CreateResources()
+{
+  kDeviceResources.resize(kResources);
+  for (size_t i = 0; i < kResources; ++i)
+  {
+    Resource &resource = kDeviceResources[i];
+    resource.uri = "/farm/" + std::to_string(i);
+    resource.type = kTypes[i % kTypes.size()];
+    resource.value = i;
+    OCStackResult result = OCCreateResource(&resource.handle, resource.type.c_str(), OC_RSRVD_INTERFACE_DEFAULT,
+                                            resource.uri.c_str(), EntityHandlerCB, &resource,
+                                            OC_DISCOVERABLE | OC_OBSERVABLE);
+    if (result == OC_STACK_OK)
+    {
+      result = OCBindResourceInterfaceToResource(resource.handle, OC_RSRVD_INTERFACE_READ_WRITE);
+    }
+    if (result != OC_STACK_OK)
+    {
+      fprintf(stderr, "OCCreateResource(%s) - %d\n", resource.uri.c_str(), result);
+      return false;
+    }
+  }
+  if (kCollection)
+  {
+    OCResourceHandle collection;
+    OCStackResult result = OCCreateResource(&collection, OC_RSRVD_RESOURCE_TYPE_COLLECTION, OC_RSRVD_INTERFACE_LL,
+                                            "/farm/col", NULL, NULL, OC_DISCOVERABLE);
+    for (size_t i = 0; (result == OC_STACK_OK) && (i < kResources); ++i)
+    {
+      result = OCBindResource(collection, kDeviceResources[i].handle);
+    }
+    if (result != OC_STACK_OK)
+    {
+      fprintf(stderr, "OCCreateResource(/farm/col) - %d\n", result);
+      return false;
+    }
+  }
+  return true;
+}
+
+// The document is built the same way the bridge builds one for a device without introspection.
+static OCRepPayload *IntrospectionDocument()
+{
+  OCRepPayload *document = OCRepPayloadCreate();
+  OCRepPayload *info = OCRepPayloadCreate();
+  OCRepPayload *paths = OCRepPayloadCreate();
+  OCRepPayload *definitions = OCRepPayloadCreate();
+  std::set<std::string> defined;
+  if (!document || !info || !paths || !definitions)
+  {
+    LOG(LOG_ERR, "Failed to create payload");
+    goto error;
+  }
+  for (size_t i = 0; i < kResources; ++i)
+  {
+    Resource &resource = kDeviceResources[i];
+    std::vector<std::string> rts(1, resource.type);
+    std::vector<std::string> ifs;
+    ifs.push_back(OC_RSRVD_INTERFACE_DEFAULT);
+    ifs.push_back(OC_RSRVD_INTERFACE_READ_WRITE);
+    if (defined.insert(resource.type).second)
+    {
+      OCRepPayload *representation = Representation(&resource);
+      OCRepPayload *definition = IntrospectDefinition(representation, resource.type, ifs);
+      OCRepPayloadDestroy(representation);
+      if (!definition || !OCRepPayloadSetPropObjectAsOwner(definitions, resource.type.c_str(), definition))
+      {
+        OCRepPayloadDestroy(definition);
+        goto error;
+      }
+    }
+    OCRepPayload *path = IntrospectPath(rts, ifs);
+    if (!path || !OCRepPayloadSetPropObjectAsOwner(paths, resource.uri.c_str(), path))
+    {
+      OCRepPayloadDestroy(path);
+      goto error;
+    }
+  }
+  if (!OCRepPayloadSetPropString(info, "title", "OCFFarm") ||
+      !OCRepPayloadSetPropString(info, "version", "1") ||
+      !OCRepPayloadSetPropString(document, "swagger", "2.0") ||
+      !OCRepPayloadSetPropObjectAsOwner(document, "info", info))
+  {
+    goto error;
+  }
+  info = NULL;
+  if (!OCRepPayloadSetPropObjectAsOwner(document, "paths", paths))
+  {
+    goto error;
+  }
+  paths = NULL;
+  if (!OCRepPayloadSetPropObjectAsOwner(document, "definitions", definitions))
+  {
+    goto error;
+  }
+  return document;
+
+error:
+  OCRepPayloadDestroy(definitions);
+  OCRepPayloadDestroy(paths);
+  OCRepPayloadDestroy(info);
+  OCRepPayloadDestroy(document);
+  return NULL;
+}
+
+static bool SetIntrospectionData()
+{
+  OCPersistentStorage *persistent_storage_handler = OCGetPersistentStorageHandler();
+  if (!kIntrospection)
+  {
+    persistent_storage_handler->unlink(OC_INTROSPECTION_FILE_NAME);
+    return true;
+  }
+  bool success = false;
+  uint8_t *out = NULL;
+  size_t size = 0;
+  FILE *file = NULL;
+  OCRepPayload *document = IntrospectionDocument();
+  OCStackResult result = OCConvertPayload(reinterpret_cast<OCPayload *>(document), OC_FORMAT_CBOR, &out, &size);
+  if (result != OC_STACK_OK)
+  {
+    fprintf(stderr, "OCConvertPayload - %d\n", result);
+    goto exit;
+  }
+  file = persistent_storage_handler->open(OC_INTROSPECTION_FILE_NAME, "wb");
+  if (!file)
+  {
+    perror(OC_INTROSPECTION_FILE_NAME);
+    goto exit;
+  }
+  success = (persistent_storage_handler->write(out, 1, size, file) == size);
+exit:
+  if (file)
+  {
+    persistent_storage_handler->close(file);
+  }
+  OICFree(out);
+  OCRepPayloadDestroy(document);
+  return success;
+}
+
+static int RunDevice(size_t index)
+{
+  kIndex = index;
+  kRandom.seed(kSeed + index);
+  signal(SIGINT, SigIntCB);
+  signal(SIGTERM, SigIntCB);
+
+  OCPersistentStorage ps_handler = { PSOpenCB, fread, fwrite, fclose, unlink };
+  std::string name = "OCFFarm " + std::to_string(index);
+  OCStackResult result = OCRegisterPersistentStorageHandler(&ps_handler);
+  if (result != OC_STACK_OK)
+  {
+    fprintf(stderr, "OCRegisterPersistentStorageHandler - %d\n", result);
+    return EXIT_FAILURE;
+  }
+  result = OCInit2(OC_SERVER, (OCTransportFlags) kFlags, (OCTransportFlags) kFlags,
+                   (OCTransportAdapter) kAdapters);
+  if (result != OC_STACK_OK)
+  {
+    fprintf(stderr, "OCInit2 - %d\n", result);
+    return EXIT_FAILURE;
+  }
+  result = OCSetPropertyValue(PAYLOAD_TYPE_DEVICE, OC_RSRVD_DEVICE_NAME, name.c_str());
+  if (result != OC_STACK_OK)
+  {
+    fprintf(stderr, "OCSetPropertyValue - %d\n", result);
+  }
+  if (!CreateResources() || !SetIntrospectionData())
+  {
+    OCStop();
+    return EXIT_FAILURE;
+  }
+  printf("started di=%s t=%llu\n", OCGetServerInstanceIDString(), (unsigned long long) NowMs());
+  fflush(stdout);
+
+  while (!kQuitFlag)
+  {
+    result = OCProcess();
+    if (result != OC_STACK_OK)
+    {
+      fprintf(stderr, "OCProcess - %d\n", result);
+      break;
+    }
+    RespondDue();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  OCStop();
+  return EXIT_SUCCESS;
+}
+
+static void Usage(const char *name)
+{
+  printf("Usage: %s [options]\n", name);
+  printf("  --devices N        number of OCF devices, at most %zu (default %zu)\n", MAX_DEVICES, kDevices);
+  printf("  --resources N      resources per device (default %zu)\n", kResources);
+  printf("  --types RT[,RT]    resource types assigned in turn (default oic.r.switch.binary,\n");
+  printf("                     oic.r.light.brightness,oic.r.temperature)\n");
+  printf("  --collection       link the resources from a collection at /farm/col\n");
+  printf("  --no-introspection serve no introspection document\n");
+  printf("  --ipv4 | --ipv6    restrict the IP endpoints to one family (default both)\n");
+  printf("  --tcp              also listen on TCP endpoints\n");
+  printf("  --latency MS       delay every reply by MS milliseconds\n");
+  printf("  --jitter MS        add up to MS milliseconds to each delay\n");
+  printf("  --seed N           random seed (default %u)\n", kSeed);
+  printf("  --ps PREFIX        persistent storage prefix (default %s)\n", kPersistentStoragePrefix);
+}
+
+int main(int argc, char **argv)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "--devices") && (i < (argc - 1)))
+    {
+      kDevices = std::min((size_t) strtoul(argv[++i], NULL, 10), MAX_DEVICES);
+    }
+    else if (!strcmp(argv[i], "--resources") && (i < (argc - 1)))
+    {
+      kResources = strtoul(argv[++i], NULL, 10);
+    }
+    else if (!strcmp(argv[i], "--types") && (i < (argc - 1)))
+    {
+      std::string types = argv[++i];
+      for (size_t begin = 0, end; begin <= types.size(); begin = end + 1)
+      {
+        end = types.find(',', begin);
+        if (end == std::string::npos)
+        {
+          end = types.size();
+        }
+        if (end > begin)
+        {
+          kTypes.push_back(types.substr(begin, end - begin));
+        }
+      }
+    }
+    else if (!strcmp(argv[i], "--collection"))
+    {
+      kCollection = true;
+    }
+    else if (!strcmp(argv[i], "--no-introspection"))
+    {
+      kIntrospection = false;
+    }
+    else if (!strcmp(argv[i], "--ipv4"))
+    {
+      kFlags = (kFlags & ~OC_IP_USE_V6) | OC_IP_USE_V4;
+    }
+    else if (!strcmp(argv[i], "--ipv6"))
+    {
+      kFlags = (kFlags & ~OC_IP_USE_V4) | OC_IP_USE_V6;
+    }
+    else if (!strcmp(argv[i], "--tcp"))
+    {
+      kAdapters |= OC_ADAPTER_TCP;
+    }
+    else if (!strcmp(argv[i], "--latency") && (i < (argc - 1)))
+    {
+      kLatencyMs = strtoul(argv[++i], NULL, 10);
+    }
+    else if (!strcmp(argv[i], "--jitter") && (i < (argc - 1)))
+    {
+      kJitterMs = strtoul(argv[++i], NULL, 10);
+    }
+    else if (!strcmp(argv[i], "--seed") && (i < (argc - 1)))
+    {
+      kSeed = strtoul(argv[++i], NULL, 10);
+    }
+    else if (!strcmp(argv[i], "--ps") && (i < (argc - 1)))
+    {
+      kPersistentStoragePrefix = argv[++i];
+    }
+    else
+    {
+      Usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (kTypes.empty())
+  {
+    kTypes.push_back("oic.r.switch.binary");
+    kTypes.push_back("oic.r.light.brightness");
+    kTypes.push_back("oic.r.temperature");
+  }
+
+  signal(SIGINT, SigIntCB);
+  signal(SIGTERM, SigIntCB);
+  std::vector<pid_t> children;
+  for (size_t i = 0; (i < kDevices) && !kQuitFlag; ++i)
+  {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+      return RunDevice(i);
+    }
+    else if (pid < 0)
+    {
+      perror("fork");
+      break;
+    }
+    children.push_back(pid);
+  }
+
+  while (!kQuitFlag && !children.empty())
+  {
+    pause();
+  }
+  for (size_t i = 0; i < children.size(); ++i)
+  {
+    kill(children[i], SIGTERM);
+  }
+  for (size_t i = 0; i < children.size(); ++i)
+  {
+    waitpid(children[i], NULL, 0);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+#include "bridge.h"
+#include "discovery_schedule.h"
+#include "han_event.h"
+#include "oic_malloc.h"
+#include "oic_string.h"
+#include "unit_test.h"
+#include <string.h>
+
+class BridgeTest : public HFOCSetUp
+{
+  protected:
+    Bridge *bridge_;
+    virtual void SetUp()
+    {
+      HFOCSetUp::SetUp();
+      bridge_ = new Bridge("/hf", Bridge::OC);
+    }
+    virtual void TearDown()
+    {
+      delete bridge_;
+      HFOCSetUp::TearDown();
+    }
+    /* One discovery round in which payload is the only response. */
+    time_t Discover(OCDiscoveryPayload *payload)
+    {
+      DiscoverySchedule *schedule = bridge_->discovery_schedule_;
+      schedule->Start(time(NULL));
+      OCClientResponse response;
+      memset(&response, 0, sizeof(response));
+      response.result = OC_STACK_OK;
+      response.payload = (OCPayload *) payload;
+      Bridge::DiscoverCB(bridge_, bridge_->discover_handle_, &response);
+      return schedule->GetInterval();
+    }
+    /* Acts on a device table page as Process() does; returns the page to ask for next. */
+    uint16_t DeviceTable(HanEvent &event)
+    {
+      std::unique_lock<std::mutex> lock(bridge_->mutex_);
+      bridge_->next_page_index_ = 0;
+      bridge_->DeviceTable(event, lock);
+      return bridge_->next_page_index_;
+    }
+};
+
+static OCResourcePayload *AddResource(OCDiscoveryPayload *payload, const char *uri, const char *rt)
+{
+  OCResourcePayload *resource = (OCResourcePayload *) OICCalloc(1, sizeof(OCResourcePayload));
+  resource->uri = OICStrdup(uri);
+  OCResourcePayloadAddStringLL(&resource->types, rt);
+  OCResourcePayloadAddStringLL(&resource->interfaces, OC_RSRVD_INTERFACE_DEFAULT);
+  resource->bitmap = OC_DISCOVERABLE | OC_OBSERVABLE;
+  OCDiscoveryPayloadAddNewResource(payload, resource);
+  return resource;
+}
+
+TEST_F(BridgeTest, BacksOffForStableDevice)
+{
+  // A device with nothing to translate is decided on its first response
+  OCDiscoveryPayload *payload = OCDiscoveryPayloadCreate();
+  payload->sid = OICStrdup("1b2c3d4e-5f60-7182-93a4-b5c6d7e8f901");
+  AddResource(payload, "/oic/sec/doxm", "oic.r.doxm");
+
+  // The first response is a new device; the rounds after it are not changes
+  time_t intervals[] = { 5, 5, 10, 20, 40, 60 };
+  for (time_t interval : intervals)
+  {
+    EXPECT_EQ(interval, Discover(payload));
+  }
+
+  // A change is seen in the round it arrives, so only the next round is sooner
+  AddResource(payload, "/oic/sec/pstat", "oic.r.pstat");
+  EXPECT_EQ(60, Discover(payload));
+  EXPECT_EQ(5, Discover(payload));
+  EXPECT_EQ(10, Discover(payload));
+
+  OCDiscoveryPayloadDestroy(payload);
+}
+
+TEST_F(BridgeTest, BacksOffWhileDeviceIsDiscovered)
+{
+  bridge_->SetSecureMode(false);
+  OCDiscoveryPayload *payload = OCDiscoveryPayloadCreate();
+  payload->sid = OICStrdup("1b2c3d4e-5f60-7182-93a4-b5c6d7e8f901");
+  AddResource(payload, OC_RSRVD_DEVICE_URI, OC_RSRVD_RESOURCE_TYPE_DEVICE);
+
+  // No response to the follow-up requests arrives, so the device is never decided
+  time_t intervals[] = { 5, 5, 10, 20, 40, 60 };
+  for (time_t interval : intervals)
+  {
+    EXPECT_EQ(interval, Discover(payload));
+  }
+
+  // Changes are left to the discovery in progress
+  AddResource(payload, "/light", "x.org.example.light");
+  EXPECT_EQ(60, Discover(payload));
+  EXPECT_EQ(60, Discover(payload));
+
+  OCDiscoveryPayloadDestroy(payload);
+}
+
+static size_t s_execs;
+static void CountExec(const char *piid, uint16_t sender, bool secure_mode, bool is_virtual)
+{
+  ++s_execs;
+}
+static Bridge::SeenState NotSeen(const char *piid)
+{
+  return Bridge::NOT_SEEN;
+}
+
+TEST_F(BridgeTest, FullDeviceTablePageAsksForNext)
+{
+  bridge_->SetProcessCB(CountExec, NULL, NotSeen);
+  s_execs = 0;
+  HanEvent event;
+  memset(&event, 0, sizeof(event));
+  event.type = HanEvent::DEVICE_TABLE;
+  event.dev_index = 10;
+  event.no_of_devices = HanEvent::MAX_DEVICES;
+  for (uint8_t i = 0; i < event.no_of_devices; ++i)
+  {
+    event.dev_ids[i] = event.dev_index + i + 1;
+    event.dev_ipuis[i][4] = i + 1;
+  }
+
+  // The next page is left for the Process thread to ask for
+  EXPECT_EQ(15, DeviceTable(event));
+  EXPECT_EQ((size_t) HanEvent::MAX_DEVICES, s_execs);
+
+  event.dev_index = 15;
+  event.no_of_devices = 2;
+  EXPECT_EQ(0, DeviceTable(event));
+}
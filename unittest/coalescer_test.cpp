@@ -0,0 +1,62 @@
+#include "coalescer.h"
+#include <gtest/gtest.h>
+
+static int a, b;
+
+TEST(CoalescerTest, PassesQuietChanges)
+{
+  Coalescer coalescer(100);
+  EXPECT_TRUE(coalescer.Changed(&a, 1000));
+  EXPECT_TRUE(coalescer.Changed(&a, 1100));
+  EXPECT_TRUE(coalescer.Changed(&b, 1100));
+  EXPECT_TRUE(coalescer.Changed(&a, 1500));
+
+  std::vector<Coalescer::Key> keys;
+  coalescer.Due(2000, keys);
+  EXPECT_TRUE(keys.empty());
+  EXPECT_EQ(2u, coalescer.Size());
+}
+
+TEST(CoalescerTest, HoldsChangesInsideWindow)
+{
+  Coalescer coalescer(100);
+  EXPECT_TRUE(coalescer.Changed(&a, 1000));
+  EXPECT_FALSE(coalescer.Changed(&a, 1010));
+  EXPECT_FALSE(coalescer.Changed(&a, 1050));
+  EXPECT_TRUE(coalescer.Changed(&b, 1050));
+
+  std::vector<Coalescer::Key> keys;
+  coalescer.Due(1099, keys);
+  EXPECT_TRUE(keys.empty());
+  coalescer.Due(1100, keys);
+  ASSERT_EQ(1u, keys.size());
+  EXPECT_EQ(&a, keys[0]);
+
+  // The window restarts from the release
+  keys.clear();
+  EXPECT_FALSE(coalescer.Changed(&a, 1150));
+  coalescer.Due(1199, keys);
+  EXPECT_TRUE(keys.empty());
+  coalescer.Due(1200, keys);
+  ASSERT_EQ(1u, keys.size());
+  keys.clear();
+  coalescer.Due(1400, keys);
+  EXPECT_TRUE(keys.empty());
+}
+
+TEST(CoalescerTest, ReleasesHeldChangeBeforeNewOne)
+{
+  Coalescer coalescer(100);
+  EXPECT_TRUE(coalescer.Changed(&a, 1000));
+  EXPECT_FALSE(coalescer.Changed(&a, 1050));
+  // The held change has not been released yet, so this one replaces it
+  EXPECT_FALSE(coalescer.Changed(&a, 1200));
+
+  std::vector<Coalescer::Key> keys;
+  coalescer.Due(1200, keys);
+  ASSERT_EQ(1u, keys.size());
+
+  coalescer.Remove(&a);
+  EXPECT_EQ(0u, coalescer.Size());
+  EXPECT_TRUE(coalescer.Changed(&a, 1210));
+}
@@ -0,0 +1,56 @@
+#include "discovery_schedule.h"
+#include <gtest/gtest.h>
+
+TEST(DiscoveryScheduleTest, BacksOffWhenStable)
+{
+  DiscoverySchedule schedule;
+  time_t now = 1000;
+  EXPECT_TRUE(schedule.IsDue(now));
+  EXPECT_EQ(1u, schedule.Start(now));
+  EXPECT_EQ(DiscoverySchedule::MIN_INTERVAL_SECS, schedule.GetInterval());
+
+  time_t intervals[] = { 10, 20, 40, 60, 60 };
+  for (time_t interval : intervals)
+  {
+    now += schedule.GetInterval();
+    EXPECT_FALSE(schedule.IsDue(now - 1));
+    EXPECT_TRUE(schedule.IsDue(now));
+    schedule.Start(now);
+    EXPECT_EQ(interval, schedule.GetInterval());
+  }
+  EXPECT_EQ(6u, schedule.GetRound());
+}
+
+TEST(DiscoveryScheduleTest, BurstsAfterChange)
+{
+  DiscoverySchedule schedule;
+  time_t now = 1000;
+  for (int i = 0; i < 5; ++i)
+  {
+    schedule.Start(now);
+    now += schedule.GetInterval();
+  }
+  EXPECT_EQ(60, schedule.GetInterval());
+
+  now -= 50;
+  schedule.Changed(now);
+  EXPECT_FALSE(schedule.IsDue(now + DiscoverySchedule::MIN_INTERVAL_SECS - 1));
+  EXPECT_TRUE(schedule.IsDue(now + DiscoverySchedule::MIN_INTERVAL_SECS));
+  now += DiscoverySchedule::MIN_INTERVAL_SECS;
+  schedule.Start(now);
+  EXPECT_EQ(DiscoverySchedule::MIN_INTERVAL_SECS, schedule.GetInterval());
+}
+
+TEST(DiscoveryScheduleTest, CountsPerMinute)
+{
+  DiscoverySchedule schedule;
+  schedule.Count(DiscoverySchedule::RESPONSE, 600);
+  schedule.Count(DiscoverySchedule::RESPONSE, 610);
+  schedule.Count(DiscoverySchedule::NOTIFICATION, 619);
+  EXPECT_EQ(0u, schedule.PerMinute(DiscoverySchedule::RESPONSE));
+  schedule.Count(DiscoverySchedule::RESPONSE, 660);
+  EXPECT_EQ(2u, schedule.PerMinute(DiscoverySchedule::RESPONSE));
+  EXPECT_EQ(1u, schedule.PerMinute(DiscoverySchedule::NOTIFICATION));
+  schedule.Count(DiscoverySchedule::RESPONSE, 900);
+  EXPECT_EQ(0u, schedule.PerMinute(DiscoverySchedule::RESPONSE));
+}
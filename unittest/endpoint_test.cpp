@@ -0,0 +1,117 @@
+#include "resource.h"
+#include "ocpayload.h"
+#include <gtest/gtest.h>
+#include <string.h>
+
+TEST(EndpointTest, IPv4)
+{
+  OCDevAddr addr;
+  ASSERT_TRUE(ParseEndpoint("coap://192.168.1.100:5683", &addr));
+  EXPECT_EQ(OC_ADAPTER_IP, addr.adapter);
+  EXPECT_EQ(OC_IP_USE_V4, addr.flags);
+  EXPECT_STREQ("192.168.1.100", addr.addr);
+  EXPECT_EQ(5683, addr.port);
+
+  ASSERT_TRUE(ParseEndpoint("coaps+tcp://10.0.0.7:43210", &addr));
+  EXPECT_EQ(OC_ADAPTER_TCP, addr.adapter);
+  EXPECT_EQ(OC_IP_USE_V4 | OC_FLAG_SECURE, addr.flags);
+  EXPECT_EQ(43210, addr.port);
+}
+
+TEST(EndpointTest, IPv6ScopeId)
+{
+  OCDevAddr addr;
+  ASSERT_TRUE(ParseEndpoint("coaps://[fe80::b82e:3bff:fe56:9a6c%25eth0]:50364", &addr));
+  EXPECT_EQ(OC_ADAPTER_IP, addr.adapter);
+  EXPECT_EQ(OC_IP_USE_V6 | OC_FLAG_SECURE, addr.flags);
+  EXPECT_STREQ("fe80::b82e:3bff:fe56:9a6c%eth0", addr.addr);
+  EXPECT_EQ(50364, addr.port);
+
+  ASSERT_TRUE(ParseEndpoint("coap+tcp://[2001:db8::42]", &addr));
+  EXPECT_STREQ("2001:db8::42", addr.addr);
+  EXPECT_EQ(0, addr.port);
+}
+
+TEST(EndpointTest, Invalid)
+{
+  OCDevAddr addr;
+  EXPECT_FALSE(ParseEndpoint("", &addr));
+  EXPECT_FALSE(ParseEndpoint("coap:192.168.1.1:5683", &addr));
+  EXPECT_FALSE(ParseEndpoint("http://192.168.1.1:80", &addr));
+  EXPECT_FALSE(ParseEndpoint("coap://:5683", &addr));
+  EXPECT_FALSE(ParseEndpoint("coap://[fe80::1:5683", &addr));
+  EXPECT_FALSE(ParseEndpoint("coap://192.168.1.1:65536", &addr));
+  EXPECT_FALSE(ParseEndpoint("coap://192.168.1.1:", &addr));
+  EXPECT_FALSE(ParseEndpoint("coap://192.168.1.1:56x", &addr));
+  EXPECT_FALSE(ParseEndpoint("coap://[0123456789:0123456789:0123456789:0123456789:0123456789:0123456789:0123456789]:1", &addr));
+}
+
+TEST(EndpointTest, DiscoveredEndpoints)
+{
+  OCDevAddr origin;
+  ASSERT_TRUE(ParseEndpoint("coap://192.168.1.100:5683", &origin));
+  OCEndpointPayload http, coaps;
+  memset(&http, 0, sizeof(http));
+  http.tps = (char *) "http";
+  http.addr = (char *) "192.168.1.100";
+  http.family = OC_IP_USE_V4;
+  http.port = 80;
+  memset(&coaps, 0, sizeof(coaps));
+  coaps.tps = (char *) "coaps";
+  coaps.addr = (char *) "fe80::1%25eth0";
+  coaps.family = (OCTransportFlags) (OC_IP_USE_V6 | OC_FLAG_SECURE);
+  coaps.port = 5684;
+  OCResourcePayload payload;
+  memset(&payload, 0, sizeof(payload));
+  payload.uri = (char *) "/light";
+  payload.eps = &http;
+  http.next = &coaps;
+
+  Resource resource(origin, "di", &payload);
+  ASSERT_EQ(1u, resource.addrs().size());
+  const OCDevAddr &addr = resource.addrs()[0];
+  EXPECT_EQ(OC_ADAPTER_IP, addr.adapter);
+  EXPECT_EQ(OC_IP_USE_V6 | OC_FLAG_SECURE, addr.flags);
+  EXPECT_STREQ("fe80::1%eth0", addr.addr);
+  EXPECT_EQ(5684, addr.port);
+  EXPECT_STREQ("di", addr.remoteId);
+
+  // With no usable endpoint the resource is reached where it was discovered
+  http.next = NULL;
+  Resource fallback(origin, "di", &payload);
+  ASSERT_EQ(1u, fallback.addrs().size());
+  EXPECT_STREQ("192.168.1.100", fallback.addrs()[0].addr);
+  EXPECT_EQ(5683, fallback.addrs()[0].port);
+}
+
+TEST(EndpointTest, LinkSkipsUnknownEndpoints)
+{
+  OCRepPayload *link = OCRepPayloadCreate();
+  OCRepPayloadSetPropString(link, OC_RSRVD_HREF, "/light");
+  const char *endpoints[] = { "http://192.168.1.100:80", "coap://192.168.1.100:5683" };
+  const OCRepPayload *eps[2];
+  for (size_t i = 0; i < 2; ++i)
+  {
+    OCRepPayload *ep = OCRepPayloadCreate();
+    OCRepPayloadSetPropString(ep, OC_RSRVD_ENDPOINT, endpoints[i]);
+    eps[i] = ep;
+  }
+  size_t dim[MAX_REP_ARRAY_DEPTH] = { 2, 0, 0 };
+  OCRepPayloadSetPropObjectArray(link, OC_RSRVD_ENDPOINTS, eps, dim);
+  for (size_t i = 0; i < 2; ++i)
+  {
+    OCRepPayloadDestroy((OCRepPayload *) eps[i]);
+  }
+
+  OCResourcePayload *resource = ParseLink(link);
+  ASSERT_TRUE(resource != NULL);
+  EXPECT_STREQ("/light", resource->uri);
+  ASSERT_TRUE(resource->eps != NULL);
+  EXPECT_STREQ("coap", resource->eps->tps);
+  EXPECT_STREQ("192.168.1.100", resource->eps->addr);
+  EXPECT_EQ(5683, resource->eps->port);
+  EXPECT_TRUE(resource->eps->next == NULL);
+
+  OCDiscoveryResourceDestroy(resource);
+  OCRepPayloadDestroy(link);
+}
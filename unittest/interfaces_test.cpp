@@ -0,0 +1,52 @@
+#include "interfaces.h"
+#include "octypes.h"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <thread>
+
+TEST(InterfacesTest, ClassifyKnownTypes)
+{
+  EXPECT_EQ(RT_DO_NOT_TRANSLATE, ClassifyResourceType("oic.d.bridge"));
+  EXPECT_EQ(RT_DO_NOT_TRANSLATE, ClassifyResourceType(OC_RSRVD_RESOURCE_TYPE_RES));
+  EXPECT_EQ(RT_DO_NOT_TRANSLATE, ClassifyResourceType("oic.r.securemode"));
+  EXPECT_EQ(RT_DEEP_TRANSLATE, ClassifyResourceType(OC_RSRVD_RESOURCE_TYPE_DEVICE));
+  EXPECT_EQ(RT_DEEP_TRANSLATE, ClassifyResourceType("oic.wk.con.p"));
+  EXPECT_EQ(RT_TRANSLATE, ClassifyResourceType("oic.r.switch.binary"));
+  EXPECT_EQ(RT_TRANSLATE, ClassifyResourceType(""));
+  EXPECT_EQ(RT_TRANSLATE, ClassifyResourceType("oic.r.acl3"));
+  EXPECT_FALSE(TranslateResourceType("oic.r.doxm"));
+  EXPECT_TRUE(TranslateResourceType("oic.wk.p"));
+}
+
+TEST(InterfacesTest, RegisterType)
+{
+  EXPECT_FALSE(RegisterResourceType("oic.r.doxm", RT_TRANSLATE));
+  EXPECT_EQ(RT_DO_NOT_TRANSLATE, ClassifyResourceType("oic.r.doxm"));
+
+  EXPECT_TRUE(RegisterResourceType("x.org.hanfun.test", RT_DO_NOT_TRANSLATE));
+  EXPECT_FALSE(TranslateResourceType("x.org.hanfun.test"));
+  UnregisterResourceType("x.org.hanfun.test");
+  EXPECT_TRUE(TranslateResourceType("x.org.hanfun.test"));
+}
+
+TEST(InterfacesTest, RegisterChurnWhileClassifying)
+{
+  std::atomic<bool> done(false);
+  std::thread reader([&done]()
+  {
+    while (!done)
+    {
+      EXPECT_EQ(RT_DO_NOT_TRANSLATE, ClassifyResourceType("oic.r.doxm"));
+      ClassifyResourceType("x.org.hanfun.churn");
+    }
+  });
+  for (int i = 0; i < 10000; ++i)
+  {
+    EXPECT_TRUE(RegisterResourceType("x.org.hanfun.churn", RT_DO_NOT_TRANSLATE));
+    EXPECT_FALSE(TranslateResourceType("x.org.hanfun.churn"));
+    UnregisterResourceType("x.org.hanfun.churn");
+  }
+  done = true;
+  reader.join();
+  EXPECT_TRUE(TranslateResourceType("x.org.hanfun.churn"));
+}
@@ -0,0 +1,68 @@
+#include "metrics.h"
+#include <gtest/gtest.h>
+
+TEST(HistogramTest, IndexesLogLinearBuckets)
+{
+  for (uint64_t v = 0; v < Histogram::SUB_BUCKETS; ++v)
+  {
+    EXPECT_EQ(v, Histogram::Index(v));
+  }
+  EXPECT_EQ(8u, Histogram::Index(8));
+  EXPECT_EQ(8u, Histogram::Index(9));
+  EXPECT_EQ(9u, Histogram::Index(10));
+  EXPECT_EQ(Histogram::BUCKETS - 1, Histogram::Index(UINT64_MAX));
+}
+
+TEST(HistogramTest, BucketsCoverEveryValue)
+{
+  for (uint64_t v = 0; v < 100000; ++v)
+  {
+    size_t i = Histogram::Index(v);
+    ASSERT_LE(v, Histogram::UpperBound(i));
+    if (i > 0)
+    {
+      ASSERT_GT(v, Histogram::UpperBound(i - 1));
+    }
+  }
+  EXPECT_EQ((1ull << Histogram::MAX_BITS) - 1, Histogram::UpperBound(Histogram::BUCKETS - 1));
+}
+
+TEST(HistogramTest, ReportsQuantiles)
+{
+  Histogram histogram;
+  EXPECT_EQ(0u, histogram.GetQuantile(0.5));
+  for (uint64_t v = 1; v <= 100; ++v)
+  {
+    histogram.Observe(v);
+  }
+  EXPECT_EQ(100u, histogram.GetCount());
+  EXPECT_EQ(5050u, histogram.GetSum());
+  uint64_t p50 = histogram.GetQuantile(0.5);
+  EXPECT_GE(p50, 50u);
+  EXPECT_LE(p50, 50u + 50u / Histogram::SUB_BUCKETS);
+  uint64_t p99 = histogram.GetQuantile(0.99);
+  EXPECT_GE(p99, 99u);
+  EXPECT_LE(p99, 99u + 99u / Histogram::SUB_BUCKETS);
+}
+
+TEST(MetricsTest, WritesPrometheusText)
+{
+  Metrics::han_messages_in.Add(3);
+  Metrics::onboarding_ms.Observe(10);
+  std::string out;
+  Metrics::WritePrometheus(out);
+  EXPECT_NE(std::string::npos, out.find("# TYPE hanfun_bridge_han_messages_in_total counter\n"));
+  EXPECT_NE(std::string::npos, out.find("\nhanfun_bridge_han_messages_in_total 3\n"));
+  EXPECT_NE(std::string::npos, out.find("\nhanfun_bridge_onboarding_milliseconds_bucket{le=\"11\"} 1\n"));
+  EXPECT_NE(std::string::npos, out.find("\nhanfun_bridge_onboarding_milliseconds_bucket{le=\"+Inf\"} 1\n"));
+  EXPECT_NE(std::string::npos, out.find("\nhanfun_bridge_onboarding_milliseconds_count 1\n"));
+}
+
+TEST(MetricsTest, CountsOverflowOnlyInInf)
+{
+  Metrics::device_table_sync_ms.Observe(1ull << 40);
+  std::string out;
+  Metrics::WritePrometheus(out);
+  EXPECT_EQ(std::string::npos, out.find("hanfun_bridge_device_table_sync_milliseconds_bucket{le=\"4294967295\"}"));
+  EXPECT_NE(std::string::npos, out.find("\nhanfun_bridge_device_table_sync_milliseconds_bucket{le=\"+Inf\"} 1\n"));
+}
@@ -0,0 +1,76 @@
+#include "observable_resource.h"
+#include "ocpayload.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+class TestResource : public ObservableResource
+{
+  public:
+    int notifications_;
+    TestResource() : notifications_(0) {}
+    void Request(OCEntityHandlerFlag flag, OCObserveAction action, OCObservationId id)
+    {
+      OCEntityHandlerRequest request;
+      memset(&request, 0, sizeof(request));
+      request.obsInfo.action = action;
+      request.obsInfo.obsId = id;
+      Observe(flag, &request);
+    }
+    void Change()
+    {
+      Notify(NULL);
+    }
+
+  protected:
+    virtual OCRepPayload *CreateNotification(OCResourceHandle handle, PayloadArena &arena)
+    {
+      (void) handle;
+      (void) arena;
+      ++notifications_;
+      return OCRepPayloadCreate();
+    }
+};
+
+TEST(ObservableResourceTest, TracksObservers)
+{
+  TestResource resource;
+  OCEntityHandlerFlag observe = (OCEntityHandlerFlag) (OC_REQUEST_FLAG | OC_OBSERVE_FLAG);
+  resource.Request(observe, OC_OBSERVE_REGISTER, 1);
+  resource.Request(observe, OC_OBSERVE_REGISTER, 2);
+  resource.Request(observe, OC_OBSERVE_REGISTER, 1);
+  EXPECT_EQ(2u, resource.GetObserverCount());
+  resource.Request(OC_REQUEST_FLAG, OC_OBSERVE_DEREGISTER, 1);
+  EXPECT_EQ(2u, resource.GetObserverCount());
+  resource.Request(observe, OC_OBSERVE_DEREGISTER, 1);
+  EXPECT_EQ(1u, resource.GetObserverCount());
+}
+
+TEST(ObservableResourceTest, SkipsPayloadWithoutObservers)
+{
+  TestResource resource;
+  resource.Change();
+  EXPECT_EQ(0, resource.notifications_);
+}
+
+TEST(ObservableResourceTest, CoalescesChangesInsideWindow)
+{
+  TestResource resource;
+  resource.SetNotifyWindow(50);
+  OCEntityHandlerFlag observe = (OCEntityHandlerFlag) (OC_REQUEST_FLAG | OC_OBSERVE_FLAG);
+  resource.Request(observe, OC_OBSERVE_REGISTER, 1);
+  resource.Request(observe, OC_OBSERVE_REGISTER, 2);
+
+  // One payload for both observers
+  resource.Change();
+  EXPECT_EQ(1, resource.notifications_);
+  resource.Change();
+  resource.Change();
+  resource.Flush();
+  EXPECT_EQ(1, resource.notifications_);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  resource.Flush();
+  EXPECT_EQ(2, resource.notifications_);
+  resource.Flush();
+  EXPECT_EQ(2, resource.notifications_);
+}
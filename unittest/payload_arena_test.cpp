@@ -0,0 +1,84 @@
+#include "ocpayload.h"
+#include "oic_malloc.h"
+#include "payload_arena.h"
+#include <gtest/gtest.h>
+
+TEST(PayloadArenaTest, Strdup)
+{
+  PayloadArena arena;
+  const char *str = "oic.r.securemode";
+  char *dup = arena.Strdup(str);
+  ASSERT_TRUE(dup != NULL);
+  EXPECT_STREQ(str, dup);
+  EXPECT_TRUE(arena.Owns(dup));
+  EXPECT_FALSE(arena.Owns(str));
+  EXPECT_TRUE(arena.Strdup(NULL) == NULL);
+}
+
+TEST(PayloadArenaTest, GrowsPastInlineBlock)
+{
+  PayloadArena arena;
+  for (int i = 0; i < 1000; ++i)
+  {
+    char *dup = arena.Strdup("a string long enough to fill the inline block");
+    ASSERT_TRUE(dup != NULL);
+    EXPECT_TRUE(arena.Owns(dup));
+  }
+  EXPECT_TRUE(arena.Allocate(64 * 1024) != NULL);
+}
+
+TEST(PayloadArenaTest, Destroy)
+{
+  PayloadArena arena;
+  OCRepPayload *payload = OCRepPayloadCreate();
+  ASSERT_TRUE(payload != NULL);
+  const char *rts[] = { "oic.r.a", "oic.r.b" };
+  EXPECT_TRUE(arena.SetStringArray(payload, OC_RSRVD_RESOURCE_TYPE, rts, 2));
+  /* Replacing an arena-owned value must not free it. */
+  EXPECT_TRUE(arena.SetStringArray(payload, OC_RSRVD_RESOURCE_TYPE, rts, 1));
+  EXPECT_TRUE(OCRepPayloadSetPropStringAsOwner(payload, "arena", arena.Strdup("value")));
+  EXPECT_TRUE(OCRepPayloadSetPropString(payload, "heap", "value"));
+  OCRepPayload *child = OCRepPayloadCreate();
+  ASSERT_TRUE(child != NULL);
+  EXPECT_TRUE(OCRepPayloadSetPropStringAsOwner(child, "arena", arena.Strdup("value")));
+  EXPECT_TRUE(OCRepPayloadSetPropObjectAsOwner(payload, "child", child));
+  arena.Destroy(payload);
+}
+
+TEST(PayloadArenaTest, EmptyArray)
+{
+  PayloadArena arena;
+  /* Fills the inline block, so an empty allocation cannot point at its end. */
+  ASSERT_TRUE(arena.Allocate(512) != NULL);
+  EXPECT_TRUE(arena.Owns(arena.Allocate(0)));
+  OCRepPayload *payload = OCRepPayloadCreate();
+  ASSERT_TRUE(payload != NULL);
+  EXPECT_TRUE(arena.SetStringArray(payload, OC_RSRVD_RESOURCE_TYPE, NULL, 0));
+  arena.Destroy(payload);
+  EXPECT_FALSE(arena.SetStringArray(NULL, OC_RSRVD_RESOURCE_TYPE, NULL, 0));
+}
+
+TEST(PayloadArenaTest, ObjectArray)
+{
+  PayloadArena arena;
+  OCRepPayload *payload = OCRepPayloadCreate();
+  ASSERT_TRUE(payload != NULL);
+  const char *rts[] = { "oic.r.a", "oic.r.b" };
+  OCRepPayload **links = (OCRepPayload **) arena.Allocate(2 * sizeof(OCRepPayload *));
+  ASSERT_TRUE(links != NULL);
+  for (size_t i = 0; i < 2; ++i)
+  {
+    links[i] = arena.CreatePayload();
+    ASSERT_TRUE(links[i] != NULL);
+    EXPECT_TRUE(arena.AddString(links[i], OC_RSRVD_HREF, "/a"));
+    EXPECT_TRUE(arena.AddStringArray(links[i], OC_RSRVD_RESOURCE_TYPE, rts, 2));
+  }
+  EXPECT_FALSE(arena.AddString(payload, OC_RSRVD_HREF, "/a"));
+  EXPECT_TRUE(arena.SetObjectArray(payload, OC_RSRVD_LINKS, links, 2));
+  char *href = NULL;
+  EXPECT_TRUE(OCRepPayloadGetPropString(links[1], OC_RSRVD_HREF, &href));
+  EXPECT_STREQ("/a", href);
+  OICFree(href);
+  /* The links, their values and the array all belong to the arena. */
+  arena.Destroy(payload);
+}
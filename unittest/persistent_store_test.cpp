@@ -0,0 +1,171 @@
+#include "persistent_store.h"
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+class PersistentStoreTest : public ::testing::Test
+{
+  protected:
+    const char *path_ = "PersistentStoreTest.store";
+    virtual void SetUp()
+    {
+      unlink(path_);
+    }
+    virtual void TearDown()
+    {
+      unlink(path_);
+      unlink((std::string(path_) + ".tmp").c_str());
+    }
+};
+
+TEST_F(PersistentStoreTest, PutGetRemove)
+{
+  {
+    PersistentStore store;
+    ASSERT_TRUE(store.Open(path_));
+    std::string value;
+    EXPECT_FALSE(store.Get("svr", value));
+    EXPECT_TRUE(store.Put("svr", "one", 3));
+    EXPECT_TRUE(store.Put("introspection", "", 0));
+    EXPECT_TRUE(store.Put("svr", "two", 3));
+    EXPECT_TRUE(store.Get("svr", value));
+    EXPECT_EQ("two", value);
+    EXPECT_TRUE(store.Remove("introspection"));
+    EXPECT_FALSE(store.Remove("introspection"));
+  }
+  PersistentStore store;
+  ASSERT_TRUE(store.Open(path_));
+  std::string value;
+  EXPECT_TRUE(store.Get("svr", value));
+  EXPECT_EQ("two", value);
+  EXPECT_FALSE(store.Get("introspection", value));
+}
+
+TEST_F(PersistentStoreTest, DropsTornRecord)
+{
+  size_t size;
+  {
+    PersistentStore store;
+    ASSERT_TRUE(store.Open(path_));
+    EXPECT_TRUE(store.Put("svr", "value", 5));
+    size = store.GetFileBytes();
+  }
+  // A record cut short by a crash
+  int fd = open(path_, O_WRONLY | O_APPEND);
+  ASSERT_GE(fd, 0);
+  const char torn[] = "HSFR\x01\x02\x03";
+  ASSERT_EQ((ssize_t) sizeof(torn), write(fd, torn, sizeof(torn)));
+  close(fd);
+
+  PersistentStore store;
+  ASSERT_TRUE(store.Open(path_));
+  std::string value;
+  EXPECT_TRUE(store.Get("svr", value));
+  EXPECT_EQ("value", value);
+  EXPECT_EQ(size, store.GetFileBytes());
+  EXPECT_TRUE(store.Put("svr", "next", 4));
+  EXPECT_TRUE(store.Get("svr", value));
+  EXPECT_EQ("next", value);
+}
+
+TEST_F(PersistentStoreTest, RewritesTornHeader)
+{
+  // A header cut short by a crash
+  int fd = open(path_, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(5, write(fd, "HFSTO", 5));
+  close(fd);
+
+  PersistentStore store;
+  ASSERT_TRUE(store.Open(path_));
+  EXPECT_EQ(16u, store.GetFileBytes());
+  EXPECT_TRUE(store.Put("svr", "value", 5));
+  std::string value;
+  EXPECT_TRUE(store.Get("svr", value));
+  EXPECT_EQ("value", value);
+}
+
+TEST_F(PersistentStoreTest, RewritesZeroedHeader)
+{
+  // A header whose blocks were allocated but never written before a crash
+  int fd = open(path_, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(0, ftruncate(fd, 16));
+  close(fd);
+
+  PersistentStore store;
+  ASSERT_TRUE(store.Open(path_));
+  EXPECT_EQ(16u, store.GetFileBytes());
+  EXPECT_TRUE(store.Put("svr", "value", 5));
+  std::string value;
+  EXPECT_TRUE(store.Get("svr", value));
+  EXPECT_EQ("value", value);
+}
+
+TEST_F(PersistentStoreTest, RefusesOtherFiles)
+{
+  int fd = open(path_, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  ASSERT_GE(fd, 0);
+  const char other[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 };
+  ASSERT_EQ((ssize_t) sizeof(other), write(fd, other, sizeof(other)));
+  close(fd);
+
+  PersistentStore store;
+  EXPECT_FALSE(store.Open(path_));
+}
+
+TEST_F(PersistentStoreTest, CompactsAcrossStores)
+{
+  PersistentStore a;
+  PersistentStore b;
+  ASSERT_TRUE(a.Open(path_));
+  ASSERT_TRUE(b.Open(path_));
+  std::string big(1000, 'x');
+  for (int i = 0; i < 100; ++i)
+  {
+    EXPECT_TRUE(a.Put("svr", big.data(), big.size()));
+  }
+  EXPECT_TRUE(a.Put("rd", "rd", 2));
+  size_t before = b.GetFileBytes();
+  EXPECT_TRUE(b.Compact());
+  EXPECT_LT(b.GetFileBytes(), before);
+  EXPECT_EQ(b.GetLiveBytes() + 16, b.GetFileBytes());
+
+  // a still has the file that was replaced
+  EXPECT_TRUE(a.Put("svr", "small", 5));
+  std::string value;
+  EXPECT_TRUE(b.Get("svr", value));
+  EXPECT_EQ("small", value);
+  EXPECT_TRUE(b.Get("rd", value));
+  EXPECT_EQ("rd", value);
+}
+
+TEST_F(PersistentStoreTest, Streams)
+{
+  PersistentStore store;
+  ASSERT_TRUE(store.Open(path_));
+  EXPECT_TRUE(store.OpenStream("svr", "rb") == NULL);
+
+  FILE *file = store.OpenStream("svr", "wb");
+  ASSERT_TRUE(file != NULL);
+  EXPECT_EQ(6u, fwrite("abcdef", 1, 6, file));
+  std::string value;
+  EXPECT_FALSE(store.Get("svr", value));
+  EXPECT_EQ(0, fclose(file));
+  EXPECT_TRUE(store.Get("svr", value));
+  EXPECT_EQ("abcdef", value);
+
+  file = store.OpenStream("svr", "ab");
+  ASSERT_TRUE(file != NULL);
+  EXPECT_EQ(2u, fwrite("gh", 1, 2, file));
+  EXPECT_EQ(0, fclose(file));
+
+  file = store.OpenStream("svr", "rb");
+  ASSERT_TRUE(file != NULL);
+  char buf[16];
+  EXPECT_EQ(0, fseek(file, 2, SEEK_SET));
+  EXPECT_EQ(6u, fread(buf, 1, sizeof(buf), file));
+  EXPECT_EQ("cdefgh", std::string(buf, 6));
+  EXPECT_EQ(0, fclose(file));
+}
@@ -0,0 +1,97 @@
+#include "presence.h"
+#include <gtest/gtest.h>
+
+TEST(PresenceTableTest, ExpireOnlyLapsed)
+{
+  PresenceTable table;
+  EXPECT_TRUE(table.Add(new OCPresence("a", 5), 100));
+  EXPECT_TRUE(table.Add(new OCPresence("b", 5), 110));
+  EXPECT_FALSE(table.Contains("c"));
+  EXPECT_EQ(115, table.NextDeadline());
+
+  std::vector<std::string> expired;
+  table.Expire(115, expired);
+  EXPECT_TRUE(expired.empty());
+  table.Expire(116, expired);
+  ASSERT_EQ(1u, expired.size());
+  EXPECT_EQ("a", expired[0]);
+  EXPECT_FALSE(table.Contains("a"));
+  EXPECT_TRUE(table.Contains("b"));
+}
+
+TEST(PresenceTableTest, SeenPushesDeadline)
+{
+  PresenceTable table;
+  ASSERT_TRUE(table.Add(new OCPresence("a", 5), 100));
+  EXPECT_TRUE(table.Seen("a", 120));
+  EXPECT_FALSE(table.Seen("b", 120));
+  EXPECT_EQ(135, table.NextDeadline());
+
+  std::vector<std::string> expired;
+  table.Expire(130, expired);
+  EXPECT_TRUE(expired.empty());
+}
+
+TEST(PresenceTableTest, DuplicateAndRemove)
+{
+  PresenceTable table;
+  ASSERT_TRUE(table.Add(new OCPresence("a", 5), 100));
+  OCPresence *duplicate = new OCPresence("a", 5);
+  EXPECT_FALSE(table.Add(duplicate, 100));
+  delete duplicate;
+  EXPECT_TRUE(table.Remove("a"));
+  EXPECT_FALSE(table.Remove("a"));
+  EXPECT_EQ(0u, table.Size());
+  EXPECT_EQ(Presence::NEVER, table.NextDeadline());
+}
+
+TEST(PresenceTableTest, ManyDevices)
+{
+  PresenceTable table;
+  for (int i = 0; i < 10000; ++i)
+  {
+    ASSERT_TRUE(table.Add(new OCPresence(std::to_string(i).c_str(), 5), 100 + (i % 10)));
+  }
+  std::vector<std::string> expired;
+  table.Expire(115, expired);
+  EXPECT_TRUE(expired.empty());
+  for (int i = 0; i < 10000; i += 2)
+  {
+    table.Seen(std::to_string(i), 200);
+  }
+  table.Expire(200, expired);
+  EXPECT_EQ(5000u, expired.size());
+  EXPECT_EQ(5000u, table.Size());
+}
+
+TEST(HFPresenceTest, LearnsReportingInterval)
+{
+  HFPresence presence(1, 60);
+  EXPECT_EQ(180, presence.GetTimeout());
+  time_t now = 1000;
+  presence.Seen(now);
+  for (int i = 0; i < 64; ++i)
+  {
+    now += 300;
+    presence.Seen(now);
+  }
+  EXPECT_GT(presence.GetTimeout(), 800);
+  for (int i = 0; i < 64; ++i)
+  {
+    now += 1;
+    presence.Seen(now);
+  }
+  EXPECT_EQ(HFPresence::MIN_TIMEOUT_SECS, presence.GetTimeout());
+}
+
+TEST(HFPresenceTest, ExpiresWhenSilent)
+{
+  PresenceTable table;
+  ASSERT_TRUE(table.Add(new HFPresence(1, 60), 1000));
+  std::vector<std::string> expired;
+  table.Expire(1180, expired);
+  EXPECT_TRUE(expired.empty());
+  table.Expire(1181, expired);
+  ASSERT_EQ(1u, expired.size());
+  EXPECT_EQ("1", expired[0]);
+}
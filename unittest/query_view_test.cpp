@@ -0,0 +1,50 @@
+#include "resource.h"
+#include <gtest/gtest.h>
+
+TEST(QueryViewTest, Empty)
+{
+  QueryView null(NULL);
+  EXPECT_EQ(0u, null.Size());
+  EXPECT_TRUE(null.GetInterface().IsNull());
+  QueryView empty("");
+  EXPECT_EQ(0u, empty.Size());
+  EXPECT_TRUE(empty.GetResourceType().IsNull());
+}
+
+TEST(QueryViewTest, InterfaceAndResourceType)
+{
+  QueryView query("if=oic.if.baseline&rt=oic.r.switch.binary;x=1");
+  ASSERT_EQ(3u, query.Size());
+  EXPECT_TRUE(query.GetInterface() == "oic.if.baseline");
+  EXPECT_FALSE(query.GetInterface() == "oic.if.baseline2");
+  EXPECT_FALSE(query.GetInterface() == "oic.if.base");
+  EXPECT_TRUE(query.GetResourceType() == "oic.r.switch.binary");
+  EXPECT_TRUE(query.Find("x") == "1");
+  EXPECT_TRUE(query.Find("y").IsNull());
+  EXPECT_EQ("x", query[2].key.ToString());
+}
+
+TEST(QueryViewTest, MissingValues)
+{
+  QueryView query("if&rt=&=v");
+  ASSERT_EQ(3u, query.Size());
+  EXPECT_FALSE(query.GetInterface().IsNull());
+  EXPECT_TRUE(query.GetInterface() == "");
+  EXPECT_TRUE(query.GetResourceType() == "");
+  EXPECT_TRUE(query.Find("") == "v");
+}
+
+TEST(QueryViewTest, LastParameterWins)
+{
+  QueryView query("if=a&if=b");
+  EXPECT_TRUE(query.GetInterface() == "b");
+  EXPECT_TRUE(query.Find("if") == "b");
+}
+
+TEST(QueryViewTest, Truncated)
+{
+  QueryView query("a=1&b=2&c=3&d=4&e=5&f=6&g=7&h=8&i=9&if=oic.if.ll");
+  EXPECT_EQ(QueryView::MAX_PARAMS, query.Size());
+  EXPECT_TRUE(query.IsTruncated());
+  EXPECT_TRUE(query.GetInterface() == "oic.if.ll");
+}
@@ -12,7 +12,7 @@ class SecureMode : public HFOCSetUp
     virtual void SetUp()
     {
       HFOCSetUp::SetUp();
-      secure_mode_ = new SecureModeResource(mutex_, true);
+      secure_mode_ = new SecureModeResource(true);
       EXPECT_EQ(OC_STACK_OK, secure_mode_->Create());
     }
     virtual void TearDown()
@@ -31,7 +31,6 @@ class SecureMode : public HFOCSetUp
     }
   
   private:
-    std::mutex mutex_;
     SecureModeResource *secure_mode_;
 };
 
@@ -73,7 +72,7 @@ TEST_F(SecureMode, GetBaseLine)
 
   ResourceCallback get_cb;
   EXPECT_EQ(OC_STACK_OK, OCDoResource(NULL, OC_REST_GET, "/securemode?if=oic.if.baseline",
-    &context->resource->addrs_[0], 0, CT_DEFAULT, OC_HIGH_QOS, get_cb, NULL, 0));
+    &context->resource->addrs()[0], 0, CT_DEFAULT, OC_HIGH_QOS, get_cb, NULL, 0));
   EXPECT_EQ(OC_STACK_OK, get_cb.Wait(1000));
 
   EXPECT_EQ(OC_STACK_OK, get_cb.response_->result);
@@ -100,7 +99,7 @@ TEST_F(SecureMode, GetRW)
 
   ResourceCallback get_cb;
   EXPECT_EQ(OC_STACK_OK, OCDoResource(NULL, OC_REST_GET, "/securemode?if=oic.if.rw",
-    &context->resource->addrs_[0], 0, CT_DEFAULT, OC_HIGH_QOS, get_cb, NULL, 0));
+    &context->resource->addrs()[0], 0, CT_DEFAULT, OC_HIGH_QOS, get_cb, NULL, 0));
   EXPECT_EQ(OC_STACK_OK, get_cb.Wait(1000));
 
   EXPECT_EQ(OC_STACK_OK, get_cb.response_->result);
@@ -118,7 +117,7 @@ TEST_F(SecureMode, Get)
 
   ResourceCallback get_cb;
   EXPECT_EQ(OC_STACK_OK, OCDoResource(NULL, OC_REST_GET, OC_RSRVD_SECURE_MODE_URI,
-    &context->resource->addrs_[0], 0, CT_DEFAULT, OC_HIGH_QOS, get_cb, NULL, 0));
+    &context->resource->addrs()[0], 0, CT_DEFAULT, OC_HIGH_QOS, get_cb, NULL, 0));
   EXPECT_EQ(OC_STACK_OK, get_cb.Wait(1000));
 
   EXPECT_EQ(OC_STACK_OK, get_cb.response_->result);
@@ -144,7 +143,7 @@ TEST_F(SecureMode, PostBaseline)
   DiscoverContext *context = DiscoverResource();
 
   ResourceCallback post_cb;
-  Post("/securemode?if=oic.if.baseline", &context->resource->addrs_[0], &post_cb);
+  Post("/securemode?if=oic.if.baseline", &context->resource->addrs()[0], &post_cb);
 
   EXPECT_EQ(OC_STACK_RESOURCE_CHANGED, post_cb.response_->result);
   EXPECT_TRUE(post_cb.response_->payload != NULL);
@@ -160,7 +159,7 @@ TEST_F(SecureMode, PostRW)
   DiscoverContext *context = DiscoverResource();
 
   ResourceCallback post_cb;
-  Post("/securemode?if=oic.if.rw", &context->resource->addrs_[0], &post_cb);
+  Post("/securemode?if=oic.if.rw", &context->resource->addrs()[0], &post_cb);
 
   EXPECT_EQ(OC_STACK_RESOURCE_CHANGED, post_cb.response_->result);
   EXPECT_TRUE(post_cb.response_->payload != NULL);
@@ -176,7 +175,7 @@ TEST_F(SecureMode, Post)
   DiscoverContext *context = DiscoverResource();
 
   ResourceCallback post_cb;
-  Post(OC_RSRVD_SECURE_MODE_URI, &context->resource->addrs_[0], &post_cb);
+  Post(OC_RSRVD_SECURE_MODE_URI, &context->resource->addrs()[0], &post_cb);
 
   EXPECT_EQ(OC_STACK_RESOURCE_CHANGED, post_cb.response_->result);
   EXPECT_TRUE(post_cb.response_->payload != NULL);
@@ -193,12 +192,12 @@ TEST_F(SecureMode, Observe)
 
   ObserveCallback observe_cb;
   EXPECT_EQ(OC_STACK_OK, OCDoResource(NULL, OC_REST_OBSERVE, OC_RSRVD_SECURE_MODE_URI,
-    &context->resource->addrs_[0], 0, CT_DEFAULT, OC_HIGH_QOS, observe_cb, NULL, 0));
+    &context->resource->addrs()[0], 0, CT_DEFAULT, OC_HIGH_QOS, observe_cb, NULL, 0));
   EXPECT_EQ(OC_STACK_OK, observe_cb.Wait(1000));
 
   observe_cb.Reset();
   ResourceCallback post_cb;
-  Post(OC_RSRVD_SECURE_MODE_URI, &context->resource->addrs_[0], &post_cb);
+  Post(OC_RSRVD_SECURE_MODE_URI, &context->resource->addrs()[0], &post_cb);
   EXPECT_EQ(OC_STACK_OK, observe_cb.Wait(1000));
 
   EXPECT_EQ(OC_STACK_OK, observe_cb.response_->result);
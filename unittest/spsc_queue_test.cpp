@@ -0,0 +1,55 @@
+#include "spsc_queue.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+TEST(SpscQueueTest, FillsAndDrains)
+{
+  SpscQueue<int, 4> queue;
+  int value;
+  EXPECT_FALSE(queue.Pop(value));
+  for (int round = 0; round < 3; ++round)
+  {
+    for (int i = 0; i < 4; ++i)
+    {
+      EXPECT_TRUE(queue.Push(round * 10 + i));
+    }
+    EXPECT_FALSE(queue.Push(-1));
+    for (int i = 0; i < 4; ++i)
+    {
+      ASSERT_TRUE(queue.Pop(value));
+      EXPECT_EQ(round * 10 + i, value);
+    }
+    EXPECT_FALSE(queue.Pop(value));
+  }
+}
+
+TEST(SpscQueueTest, KeepsOrderAcrossThreads)
+{
+  static const int COUNT = 1000000;
+  SpscQueue<int, 64> queue;
+  std::thread producer([&queue]()
+  {
+    for (int i = 0; i < COUNT; ++i)
+    {
+      while (!queue.Push(i))
+      {
+        std::this_thread::yield();
+      }
+    }
+  });
+  int expected = 0;
+  while (expected < COUNT)
+  {
+    int value;
+    if (queue.Pop(value))
+    {
+      ASSERT_EQ(expected, value);
+      ++expected;
+    }
+    else
+    {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+}
@@ -0,0 +1,65 @@
+#include "symbol.h"
+#include <gtest/gtest.h>
+#include <stdio.h>
+
+TEST(SymbolsTest, InternIsStable)
+{
+  Symbol a = Symbols::Intern("oic.r.switch.binary");
+  Symbol b = Symbols::Intern("oic.if.a");
+  EXPECT_NE(Symbols::NONE, a);
+  EXPECT_NE(a, b);
+  EXPECT_EQ(a, Symbols::Intern("oic.r.switch.binary"));
+  EXPECT_EQ(a, Symbols::Find("oic.r.switch.binary"));
+  EXPECT_EQ(Symbols::NONE, Symbols::Find("oic.r.symbol.test.missing"));
+  EXPECT_STREQ("oic.r.switch.binary", Symbols::Name(a));
+  EXPECT_STREQ("", Symbols::Name(Symbols::NONE));
+}
+
+TEST(SymbolsTest, NamesSurviveGrowth)
+{
+  const char *name = Symbols::Name(Symbols::Intern("oic.if.baseline"));
+  char str[32];
+  for (int i = 0; i < 1000; ++i)
+  {
+    snprintf(str, sizeof(str), "x.test.%d", i);
+    Symbols::Intern(str);
+  }
+  EXPECT_EQ(name, Symbols::Name(Symbols::Find("oic.if.baseline")));
+  EXPECT_STREQ("oic.if.baseline", name);
+  std::vector<std::string> names = Names({ Symbols::Find("oic.if.baseline"), Symbols::Find("x.test.7") });
+  ASSERT_EQ(2u, names.size());
+  EXPECT_EQ("x.test.7", names[1]);
+}
+
+TEST(SymbolsTest, DropsReleasedNames)
+{
+  size_t size = Symbols::Size();
+  Symbol a = Symbols::Intern("x.test.released");
+  EXPECT_EQ(a, Symbols::Intern("x.test.released"));
+  EXPECT_EQ(size + 1, Symbols::Size());
+  Symbols::Release(a);
+  EXPECT_EQ(a, Symbols::Find("x.test.released"));
+  Symbols::Release(a);
+  EXPECT_EQ(Symbols::NONE, Symbols::Find("x.test.released"));
+  EXPECT_STREQ("", Symbols::Name(a));
+  EXPECT_EQ(size, Symbols::Size());
+
+  // The slot is reused rather than the table growing
+  Symbol b = Symbols::Intern("x.test.reused");
+  EXPECT_EQ(a, b);
+  EXPECT_STREQ("x.test.reused", Symbols::Name(b));
+  Symbols::Release(b);
+}
+
+TEST(SymbolsTest, RandomNamesDoNotFillTable)
+{
+  char str[32];
+  for (int i = 0; i < 2 * Symbols::NONE; ++i)
+  {
+    snprintf(str, sizeof(str), "x.random.%d", i);
+    Symbol symbol = Symbols::Intern(str);
+    ASSERT_NE(Symbols::NONE, symbol);
+    Symbols::Release(symbol);
+  }
+  EXPECT_NE(Symbols::NONE, Symbols::Intern("oic.r.switch.binary"));
+}
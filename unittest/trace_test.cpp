@@ -0,0 +1,82 @@
+#include "trace.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+static size_t Count(const std::string &str, const std::string &what)
+{
+  size_t n = 0;
+  for (size_t pos = str.find(what); pos != std::string::npos; pos = str.find(what, pos + 1))
+  {
+    ++n;
+  }
+  return n;
+}
+
+class TraceTest : public testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+      Trace::Clear();
+    }
+    virtual void TearDown()
+    {
+      Trace::Enable(false);
+      Trace::Clear();
+    }
+};
+
+TEST_F(TraceTest, RecordsNothingWhenDisabled)
+{
+  TRACE_BEGIN("onboard", "di", NULL);
+  std::string out;
+  Trace::WriteChromeJson(out);
+  EXPECT_EQ(0u, Count(out, "\"ph\""));
+}
+
+TEST_F(TraceTest, WritesChromeTraceEvents)
+{
+  Trace::Enable(true);
+  TRACE_BEGIN("onboard", "di", "10.0.0.1");
+  TRACE_INSTANT("retry", "di", "result=\"4\"");
+  TRACE_END("onboard", "di", NULL);
+  std::string out;
+  Trace::WriteChromeJson(out);
+  EXPECT_EQ(0u, out.find("{\"traceEvents\":["));
+  EXPECT_EQ(1u, Count(out, "\"name\":\"onboard\",\"cat\":\"device\",\"ph\":\"b\",\"id\":\"di\""));
+  EXPECT_EQ(1u, Count(out, "\"ph\":\"n\""));
+  EXPECT_EQ(1u, Count(out, "\"ph\":\"e\""));
+  EXPECT_EQ(1u, Count(out, "\"args\":{\"arg\":\"result=\\\"4\\\"\"}"));
+}
+
+TEST_F(TraceTest, KeepsTheLatestEventsOfEachThread)
+{
+  Trace::Enable(true);
+  std::thread thread([]()
+  {
+    for (size_t i = 0; i < Trace::RING_SIZE + 10; ++i)
+    {
+      TRACE_INSTANT("callback", "di", NULL);
+    }
+  });
+  thread.join();
+  TRACE_INSTANT("callback", "di", NULL);
+  std::string out;
+  Trace::WriteChromeJson(out);
+  EXPECT_EQ(Trace::RING_SIZE + 1, Count(out, "\"ph\":\"n\""));
+}
+
+TEST_F(TraceTest, ScopesTheRequestId)
+{
+  EXPECT_EQ(NULL, Trace::CurrentId());
+  {
+    Trace::IdScope outer("a");
+    EXPECT_STREQ("a", Trace::CurrentId());
+    {
+      Trace::IdScope inner("b");
+      EXPECT_STREQ("b", Trace::CurrentId());
+    }
+    EXPECT_STREQ("a", Trace::CurrentId());
+  }
+  EXPECT_EQ(NULL, Trace::CurrentId());
+}